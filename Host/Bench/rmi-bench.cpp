@@ -0,0 +1,124 @@
+/* SPDX-License-Identifier: GPL-2.0-only
+ * Microbenchmarks for the RMI hot paths
+ *
+ * Copyright (c) 2023 Avery Black
+ */
+
+#include <chrono>
+#include <random>
+#include <vector>
+#include "F12.hpp"
+
+/*
+ * F12 object decode: the per-object switch into an array of structs it
+ * used to be, against F12::unpackObjects filling one array per field.
+ * Both decode the same random frames of MAX_FINGERS objects, and have to
+ * agree before anything is timed.
+ */
+
+struct AosObject {
+    rmi_2d_sensor_object_type type;
+    UInt16 x;
+    UInt16 y;
+    UInt8 z;
+    UInt8 wx;
+    UInt8 wy;
+};
+
+static void unpackAos(const UInt8 *data, size_t count, AosObject *objs) {
+    for (size_t i = 0; i < count; i++) {
+        AosObject *obj = &objs[i];
+
+        switch (data[0]) {
+            case RMI_F12_OBJECT_FINGER:
+                obj->type = RMI_2D_OBJECT_FINGER;
+                break;
+            case RMI_F12_OBJECT_STYLUS:
+                obj->type = RMI_2D_OBJECT_STYLUS;
+                break;
+            default:
+                obj->type = RMI_2D_OBJECT_NONE;
+        }
+
+        obj->x = (data[2] << 8) | data[1];
+        obj->y = (data[4] << 8) | data[3];
+        obj->z = data[5];
+        obj->wx = data[6];
+        obj->wy = data[7];
+
+        data += F12_DATA1_BYTES_PER_OBJ;
+    }
+}
+
+static UInt64 checksum(const AosObject *objs, size_t count) {
+    UInt64 sum = 0;
+    for (size_t i = 0; i < count; i++)
+        sum += objs[i].type + objs[i].x + objs[i].y + objs[i].z + objs[i].wx + objs[i].wy;
+    return sum;
+}
+
+static UInt64 checksum(const RMI2DSensorReport &report, size_t count) {
+    UInt64 sum = 0;
+    for (size_t i = 0; i < count; i++)
+        sum += report.type[i] + report.x[i] + report.y[i] + report.z[i] + report.wx[i] + report.wy[i];
+    return sum;
+}
+
+template <typename Fn>
+static double timeNs(size_t iterations, Fn fn) {
+    auto start = std::chrono::steady_clock::now();
+    for (size_t i = 0; i < iterations; i++)
+        fn(i);
+    auto end = std::chrono::steady_clock::now();
+    return std::chrono::duration<double, std::nano>(end - start).count() / iterations;
+}
+
+int main(int argc, char **argv) {
+    const size_t frameSize = MAX_FINGERS * F12_DATA1_BYTES_PER_OBJ;
+    size_t frames = 4096, iterations = 10000000;
+    std::vector<UInt8> data;
+    std::mt19937 rng(1);
+    AosObject objs[MAX_FINGERS];
+    RMI2DSensorReport report {};
+    volatile UInt64 sink = 0;
+    double aosNs, soaNs;
+
+    if (argc > 1)
+        iterations = strtoull(argv[1], nullptr, 0);
+    if (!iterations) {
+        fprintf(stderr, "usage: %s [iterations]\n", argv[0]);
+        return 1;
+    }
+
+    // Mostly fingers, with some of every other object type a frame can hold
+    data.resize(frames * frameSize);
+    for (size_t i = 0; i < data.size(); i++)
+        data[i] = (i % F12_DATA1_BYTES_PER_OBJ) ? rng() : (rng() % 4 ? RMI_F12_OBJECT_FINGER : rng() % 14);
+
+    for (size_t i = 0; i < frames; i++) {
+        unpackAos(&data[i * frameSize], MAX_FINGERS, objs);
+        F12::unpackObjects(&data[i * frameSize], MAX_FINGERS, report);
+        for (size_t j = 0; j < MAX_FINGERS; j++) {
+            if (objs[j].type != report.type[j] || objs[j].x != report.x[j] || objs[j].y != report.y[j] ||
+                objs[j].z != report.z[j] || objs[j].wx != report.wx[j] || objs[j].wy != report.wy[j]) {
+                fprintf(stderr, "frame %zu object %zu decodes differently\n", i, j);
+                return 1;
+            }
+        }
+    }
+
+    aosNs = timeNs(iterations, [&](size_t i) {
+        unpackAos(&data[(i % frames) * frameSize], MAX_FINGERS, objs);
+        sink += checksum(objs, MAX_FINGERS);
+    });
+
+    soaNs = timeNs(iterations, [&](size_t i) {
+        F12::unpackObjects(&data[(i % frames) * frameSize], MAX_FINGERS, report);
+        sink += checksum(report, MAX_FINGERS);
+    });
+
+    printf("F12 decode, %d objects per frame, %zu frames\n", MAX_FINGERS, iterations);
+    printf("  array of structs  %.2f ns/frame\n", aosNs);
+    printf("  struct of arrays  %.2f ns/frame (%.2fx)\n", soaNs, aosNs / soaNs);
+    return 0;
+}
@@ -0,0 +1,387 @@
+/* SPDX-License-Identifier: GPL-2.0-only
+ * Host implementation of the IOKit and libkern shims
+ */
+
+#include <IOKit/IOService.h>
+#include <algorithm>
+
+uint64_t (*gHostUptimeHook)(void) = nullptr;
+void (*gHostCommandSleepHook)(void) = nullptr;
+thread_local unsigned gHostNoAllocDepth = 0;
+static OSBoolean sTrue(true), sFalse(false);
+OSBoolean *const kOSBooleanTrue = &sTrue;
+OSBoolean *const kOSBooleanFalse = &sFalse;
+const IORegistryPlane *gIOServicePlane = reinterpret_cast<const IORegistryPlane *>(&gIOServicePlane);
+const IORegistryPlane *gIODTPlane = reinterpret_cast<const IORegistryPlane *>(&gIODTPlane);
+
+IORegistryEntry *IORegistryEntry::fromPath(const char *path, const IORegistryPlane *plane) {
+    static IORegistryEntry *options = nullptr;
+    if (strcmp(path, "/options") != 0)
+        return nullptr;
+    if (!options) {
+        options = new IORegistryEntry;
+        options->init();
+    }
+    options->retain();
+    return options;
+}
+
+OSDefineMetaClassAndStructors(IORegistryEntry, OSObject)
+OSDefineMetaClassAndStructors(IOService, IORegistryEntry)
+OSDefineMetaClassAndStructors(IOEventSource, OSObject)
+OSDefineMetaClassAndStructors(IOWorkLoop, OSObject)
+OSDefineMetaClassAndStructors(IOCommandGate, IOEventSource)
+OSDefineMetaClassAndStructors(IOTimerEventSource, IOEventSource)
+OSDefineMetaClassAndStructors(IOInterruptEventSource, IOEventSource)
+
+// MARK: IORegistryEntry
+
+bool IORegistryEntry::init(OSDictionary *dict) {
+    properties = dict ? OSDictionary::withDictionary(dict) : OSDictionary::withCapacity(8);
+    return properties != nullptr;
+}
+
+void IORegistryEntry::free() {
+    OSSafeReleaseNULL(properties);
+    OSObject::free();
+}
+
+bool IORegistryEntry::setProperty(const char *key, OSObject *obj) {
+    hostCheckAllocation();
+    std::lock_guard<std::recursive_mutex> lock(propertyLock);
+    if (!properties) properties = OSDictionary::withCapacity(8);
+    return properties->setObject(key, obj);
+}
+
+bool IORegistryEntry::setProperty(const char *key, const char *str) {
+    OSString *s = OSString::withCString(str);
+    bool ret = setProperty(key, s);
+    s->release();
+    return ret;
+}
+
+bool IORegistryEntry::setProperty(const char *key, bool b) {
+    return setProperty(key, b ? kOSBooleanTrue : kOSBooleanFalse);
+}
+
+bool IORegistryEntry::setProperty(const char *key, unsigned long long n, unsigned int bits) {
+    OSNumber *num = OSNumber::withNumber(n, bits);
+    bool ret = setProperty(key, num);
+    num->release();
+    return ret;
+}
+
+bool IORegistryEntry::setProperty(const char *key, void *bytes, unsigned int length) {
+    OSData *data = OSData::withBytes(bytes, length);
+    bool ret = setProperty(key, data);
+    data->release();
+    return ret;
+}
+
+OSObject *IORegistryEntry::getProperty(const char *key) const {
+    std::lock_guard<std::recursive_mutex> lock(propertyLock);
+    return properties ? properties->getObject(key) : nullptr;
+}
+
+void IORegistryEntry::removeProperty(const char *key) {
+    std::lock_guard<std::recursive_mutex> lock(propertyLock);
+    if (properties) properties->removeObject(key);
+}
+
+OSDictionary *IORegistryEntry::dictionaryWithProperties() const {
+    std::lock_guard<std::recursive_mutex> lock(propertyLock);
+    return OSDictionary::withDictionary(properties);
+}
+
+IORegistryEntry *IORegistryEntry::getParentEntry(const IORegistryPlane *) const {
+    return parent;
+}
+
+const char *IORegistryEntry::getName(const IORegistryPlane *) const {
+    return getClassName();
+}
+
+// MARK: IOService
+
+bool IOService::init(OSDictionary *dict) {
+    clients = OSArray::withCapacity(4);
+    openClients = OSSet::withCapacity(2);
+    return IORegistryEntry::init(dict);
+}
+
+void IOService::free() {
+    OSSafeReleaseNULL(clients);
+    OSSafeReleaseNULL(openClients);
+    OSSafeReleaseNULL(ownWorkLoop);
+    IORegistryEntry::free();
+}
+
+const char *IOService::getName(const IORegistryPlane *plane) const {
+    OSString *name = OSDynamicCast(OSString, getProperty("IOName"));
+    return name ? name->getCStringNoCopy() : getClassName();
+}
+
+bool IOService::attach(IOService *prov) {
+    if (!prov) return false;
+    if (!prov->clients) prov->clients = OSArray::withCapacity(4);
+    provider = prov;
+    parent = prov;
+    prov->retain();
+    prov->clients->setObject(this);
+    return true;
+}
+
+void IOService::detach(IOService *prov) {
+    if (!prov || provider != prov) return;
+    for (unsigned int i = 0; prov->clients && i < prov->clients->getCount(); i++) {
+        if (prov->clients->getObject(i) == this) {
+            prov->clients->removeObject(i);
+            break;
+        }
+    }
+    provider = nullptr;
+    parent = nullptr;
+    prov->release();
+}
+
+bool IOService::terminate(IOOptionBits options) {
+    if (provider) {
+        willTerminate(provider, options);
+        stop(provider);
+        detach(provider);
+    }
+    return true;
+}
+
+bool IOService::open(IOService *forClient, IOOptionBits options, void *arg) {
+    return handleOpen(forClient, options, arg);
+}
+
+void IOService::close(IOService *forClient, IOOptionBits options) {
+    if (handleIsOpen(forClient))
+        handleClose(forClient, options);
+}
+
+bool IOService::isOpen(const IOService *forClient) const {
+    return handleIsOpen(forClient);
+}
+
+bool IOService::handleOpen(IOService *forClient, IOOptionBits, void *) {
+    if (!openClients) openClients = OSSet::withCapacity(2);
+    if (openClients->getCount() && !openClients->containsObject(forClient))
+        return false;
+    openClients->setObject(forClient);
+    return true;
+}
+
+void IOService::handleClose(IOService *forClient, IOOptionBits) {
+    if (openClients) openClients->removeObject(forClient);
+}
+
+bool IOService::handleIsOpen(const IOService *forClient) const {
+    if (!openClients) return false;
+    if (!forClient) return openClients->getCount() != 0;
+    return openClients->containsObject(forClient);
+}
+
+IOReturn IOService::messageClient(UInt32 type, OSObject *client, void *argument, size_t) {
+    IOService *service = OSDynamicCast(IOService, client);
+    if (!service) return kIOReturnBadArgument;
+    return service->message(type, this, argument);
+}
+
+IOReturn IOService::messageClients(UInt32 type, void *argument, size_t argSize) {
+    for (unsigned int i = 0; clients && i < clients->getCount(); i++)
+        messageClient(type, clients->getObject(i), argument, argSize);
+    return kIOReturnSuccess;
+}
+
+OSIterator *IOService::getClientIterator() const {
+    OSArray *snapshot = OSArray::withCapacity(clients ? clients->getCount() : 0);
+    for (unsigned int i = 0; clients && i < clients->getCount(); i++)
+        snapshot->setObject(clients->getObject(i));
+    OSCollectionIterator *iter = OSCollectionIterator::withCollection(snapshot);
+    snapshot->release();
+    return iter;
+}
+
+IOWorkLoop *IOService::getWorkLoop() const {
+    if (provider) return provider->getWorkLoop();
+    if (!ownWorkLoop) ownWorkLoop = IOWorkLoop::workLoop();
+    return ownWorkLoop;
+}
+
+const char *IOService::stringFromReturn(IOReturn rtn) {
+    static char buf[32];
+    snprintf(buf, sizeof(buf), "0x%x", rtn);
+    return buf;
+}
+
+// MARK: Event sources
+
+bool IOEventSource::init(OSObject *owner, Action action) {
+    this->owner = owner;
+    this->action = action;
+    return OSObject::init();
+}
+
+IOWorkLoop *IOWorkLoop::workLoop() {
+    IOWorkLoop *wl = new IOWorkLoop;
+    if (!wl->init()) { wl->release(); return nullptr; }
+    return wl;
+}
+
+bool IOWorkLoop::init() {
+    sources = OSArray::withCapacity(4);
+    return OSObject::init();
+}
+
+void IOWorkLoop::free() {
+    OSSafeReleaseNULL(sources);
+    OSObject::free();
+}
+
+IOReturn IOWorkLoop::addEventSource(IOEventSource *src) {
+    if (!src) return kIOReturnBadArgument;
+    src->setWorkLoop(this);
+    sources->setObject(src);
+    return kIOReturnSuccess;
+}
+
+IOReturn IOWorkLoop::removeEventSource(IOEventSource *src) {
+    for (unsigned int i = 0; sources && i < sources->getCount(); i++) {
+        if (sources->getObject(i) == src) {
+            src->setWorkLoop(nullptr);
+            sources->removeObject(i);
+            return kIOReturnSuccess;
+        }
+    }
+    return kIOReturnNotFound;
+}
+
+IOCommandGate *IOCommandGate::commandGate(OSObject *owner, Action action) {
+    IOCommandGate *gate = new IOCommandGate;
+    if (!gate->init(owner, (IOEventSource::Action) action)) { gate->release(); return nullptr; }
+    return gate;
+}
+
+IOReturn IOCommandGate::runAction(Action act, void *arg0, void *arg1, void *arg2, void *arg3) {
+    if (!act) act = (Action) action;
+    if (!act) return kIOReturnBadArgument;
+    if (workLoop) {
+        std::lock_guard<std::recursive_mutex> lock(workLoop->gateLock);
+        return act(owner, arg0, arg1, arg2, arg3);
+    }
+    return act(owner, arg0, arg1, arg2, arg3);
+}
+
+IOReturn IOCommandGate::attemptAction(Action act, void *arg0, void *arg1, void *arg2, void *arg3) {
+    return runAction(act, arg0, arg1, arg2, arg3);
+}
+
+IOReturn IOCommandGate::commandSleep(void *event, UInt32 interruptible) {
+    return commandSleep(event, 0, interruptible);
+}
+
+IOReturn IOCommandGate::commandSleep(void *event, AbsoluteTime, UInt32) {
+    void *previous = sleepEvent;
+    bool awakened;
+
+    sleepEvent = event;
+    woken = false;
+    if (gHostCommandSleepHook)
+        gHostCommandSleepHook();
+
+    awakened = woken;
+    sleepEvent = previous;
+    woken = false;
+    return awakened ? THREAD_AWAKENED : THREAD_TIMED_OUT;
+}
+
+void IOCommandGate::commandWakeup(void *event, bool) {
+    if (sleepEvent != nullptr && event == sleepEvent)
+        woken = true;
+}
+
+static std::vector<IOTimerEventSource *> &hostTimers() {
+    static std::vector<IOTimerEventSource *> timers;
+    return timers;
+}
+
+IOTimerEventSource *IOTimerEventSource::timerEventSource(OSObject *owner, Action action) {
+    IOTimerEventSource *timer = new IOTimerEventSource;
+    if (!timer->init(owner, (IOEventSource::Action) action)) { timer->release(); return nullptr; }
+    hostTimers().push_back(timer);
+    return timer;
+}
+
+void IOTimerEventSource::free() {
+    auto &timers = hostTimers();
+    timers.erase(std::remove(timers.begin(), timers.end(), this), timers.end());
+    IOEventSource::free();
+}
+
+IOReturn IOTimerEventSource::wakeAtTime(AbsoluteTime abstime) {
+    deadline = abstime;
+    armed = true;
+    return kIOReturnSuccess;
+}
+
+IOReturn IOTimerEventSource::setTimeout(UInt32 interval, UInt32 scaleFactor) {
+    return wakeAtTime(hostMonotonicNs() + (UInt64) interval * scaleFactor);
+}
+
+IOReturn IOTimerEventSource::setTimeoutMS(UInt32 ms) {
+    return setTimeout(ms, kMillisecondScale);
+}
+
+IOReturn IOTimerEventSource::setTimeoutUS(UInt32 us) {
+    return setTimeout(us, kMicrosecondScale);
+}
+
+void IOTimerEventSource::cancelTimeout() {
+    armed = false;
+}
+
+bool IOTimerEventSource::nextDeadline(AbsoluteTime *next) {
+    bool found = false;
+    for (IOTimerEventSource *timer : hostTimers()) {
+        if (!timer->armed || !timer->enabled) continue;
+        if (!found || timer->deadline < *next) *next = timer->deadline;
+        found = true;
+    }
+    return found;
+}
+
+bool IOTimerEventSource::runExpired(AbsoluteTime now) {
+    bool fired = false;
+    for (;;) {
+        IOTimerEventSource *due = nullptr;
+        for (IOTimerEventSource *timer : hostTimers()) {
+            if (timer->armed && timer->enabled && timer->deadline <= now &&
+                (!due || timer->deadline < due->deadline))
+                due = timer;
+        }
+        if (!due) return fired;
+        due->armed = false;
+        fired = true;
+        /*
+         * Kernel timer actions are member functions cast with OSMemberFunctionCast.
+         * Pass the sender twice so handlers declared (owner, sender) see a valid pointer
+         */
+        typedef void (*HostAction)(OSObject *, IOTimerEventSource *, IOTimerEventSource *);
+        due->retain();
+        ((HostAction) due->action)(due->owner, due, due);
+        due->release();
+    }
+}
+
+IOInterruptEventSource *IOInterruptEventSource::interruptEventSource(OSObject *owner, IOInterruptEventAction action, IOService *provider, int intIndex) {
+    return nullptr;
+}
+
+void IOInterruptEventSource::interruptOccurred(void *, IOService *, int) {
+    typedef void (*HostAction)(OSObject *, IOInterruptEventSource *, int);
+    if (enabled && action)
+        ((HostAction) action)(owner, this, 1);
+}
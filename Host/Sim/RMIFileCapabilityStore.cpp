@@ -0,0 +1,38 @@
+/* SPDX-License-Identifier: GPL-2.0-only
+ * Capability cache store for the host build
+ *
+ * Copyright (c) 2023 Avery Black
+ */
+
+#include <stdio.h>
+#include <vector>
+#include "RMIFileCapabilityStore.hpp"
+
+std::string RMIFileCapabilityStore::pathFor(const char *key) const {
+    return directory + "/" + key;
+}
+
+OSData *RMIFileCapabilityStore::load(const char *key) {
+    std::vector<UInt8> bytes;
+    UInt8 buf[256];
+    size_t count;
+
+    FILE *file = fopen(pathFor(key).c_str(), "rb");
+    if (file == nullptr)
+        return nullptr;
+
+    while ((count = fread(buf, 1, sizeof(buf), file)) > 0)
+        bytes.insert(bytes.end(), buf, buf + count);
+
+    fclose(file);
+    return OSData::withBytes(bytes.data(), (unsigned int) bytes.size());
+}
+
+bool RMIFileCapabilityStore::save(const char *key, OSData *blob) {
+    FILE *file = fopen(pathFor(key).c_str(), "wb");
+    if (file == nullptr)
+        return false;
+
+    bool ret = fwrite(blob->getBytesNoCopy(), 1, blob->getLength(), file) == blob->getLength();
+    return fclose(file) == 0 && ret;
+}
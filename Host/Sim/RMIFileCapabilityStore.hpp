@@ -0,0 +1,29 @@
+/* SPDX-License-Identifier: GPL-2.0-only
+ * Capability cache store for the host build
+ *
+ * Copyright (c) 2023 Avery Black
+ */
+
+#ifndef RMIFileCapabilityStore_hpp
+#define RMIFileCapabilityStore_hpp
+
+#include <string>
+#include "RMICapabilityCache.hpp"
+
+/*
+ * Keeps each blob in its own file in a directory, in place of NVRAM
+ */
+class RMIFileCapabilityStore : public RMICapabilityStore {
+public:
+    explicit RMIFileCapabilityStore(const char *directory) : directory(directory) {}
+
+    OSData *load(const char *key) override;
+    bool save(const char *key, OSData *blob) override;
+
+    std::string pathFor(const char *key) const;
+
+private:
+    std::string directory;
+};
+
+#endif /* RMIFileCapabilityStore_hpp */
@@ -0,0 +1,64 @@
+/* SPDX-License-Identifier: GPL-2.0-only
+ * Stand-in for VoodooInput in the host build
+ *
+ * Copyright (c) 2023 Avery Black
+ */
+
+#include "RMISimInput.hpp"
+
+OSDefineMetaClassAndStructors(RMISimInput, IOService)
+#define super IOService
+
+bool RMISimInput::init(OSDictionary *dictionary) {
+    if (!super::init(dictionary))
+        return false;
+
+    // RMIBus only lets VoodooInput open it
+    setProperty(VOODOO_INPUT_IDENTIFIER, kOSBooleanTrue);
+    return true;
+}
+
+IOReturn RMISimInput::message(UInt32 type, IOService *provider, void *argument) {
+    switch (type) {
+        case kIOMessageVoodooInputMessage: {
+            const VoodooInputEvent *event = reinterpret_cast<const VoodooInputEvent *>(argument);
+            if (event == nullptr)
+                return kIOReturnBadArgument;
+
+            stats.multitouchEvents++;
+            stats.contacts += event->contact_count;
+            lastEvent = *event;
+
+            if (verbose) {
+                for (int i = 0; i < event->contact_count && i < VOODOO_INPUT_MAX_TRANSDUCERS; i++) {
+                    const VoodooInputTransducer &transducer = event->transducers[i];
+                    if (!transducer.isTransducerActive)
+                        continue;
+
+                    IOLog("Input - Touch %u: (%u, %u) pressure %u width %u type %d%s\n", transducer.secondaryId,
+                          transducer.currentCoordinates.x, transducer.currentCoordinates.y,
+                          transducer.currentCoordinates.pressure, transducer.currentCoordinates.width,
+                          transducer.fingerType,
+                          transducer.isPhysicalButtonDown ? " [button]" : "");
+                }
+            }
+            break;
+        }
+        case kIOMessageVoodooTrackpointMessage: {
+            const TrackpointReport *report = reinterpret_cast<const TrackpointReport *>(argument);
+            stats.trackpointEvents++;
+
+            if (verbose && report != nullptr)
+                IOLog("Input - Trackpoint dx: %d dy: %d buttons: 0x%x\n",
+                      report->dx, report->dy, report->buttons);
+            break;
+        }
+        case kIOMessageVoodooTrackpointRelativePointer:
+            stats.relativeEvents++;
+            break;
+        default:
+            return super::message(type, provider, argument);
+    }
+
+    return kIOReturnSuccess;
+}
@@ -0,0 +1,40 @@
+/* SPDX-License-Identifier: GPL-2.0-only
+ * Stand-in for VoodooInput in the host build
+ *
+ * Copyright (c) 2023 Avery Black
+ */
+
+#ifndef RMISimInput_hpp
+#define RMISimInput_hpp
+
+#include <IOKit/IOService.h>
+#include "VoodooInputMultitouch/VoodooInputMessages.h"
+
+struct RmiSimInputStats {
+    UInt64 multitouchEvents;
+    UInt64 contacts;
+    UInt64 trackpointEvents;
+    UInt64 relativeEvents;
+};
+
+/*
+ * Opens the bus like VoodooInput does and counts the packets it is sent
+ */
+class RMISimInput : public IOService {
+    OSDeclareDefaultStructors(RMISimInput);
+
+public:
+    bool init(OSDictionary *dictionary = nullptr) override;
+    IOReturn message(UInt32 type, IOService *provider, void *argument = 0) override;
+
+    inline void setVerbose(bool verbose) { this->verbose = verbose; }
+    inline const RmiSimInputStats &getStats() const { return stats; }
+    inline const VoodooInputEvent &getLastEvent() const { return lastEvent; }
+
+private:
+    RmiSimInputStats stats {};
+    VoodooInputEvent lastEvent {};
+    bool verbose {false};
+};
+
+#endif /* RMISimInput_hpp */
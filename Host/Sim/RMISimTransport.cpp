@@ -0,0 +1,593 @@
+/* SPDX-License-Identifier: GPL-2.0-only
+ * Simulated RMI4 device for the host build
+ *
+ * Copyright (c) 2023 Avery Black
+ */
+
+#include <ctype.h>
+#include "RMISimTransport.hpp"
+#include "RMILogging.h"
+
+#define RMI_SIM_MAX_DELIVERIES  64
+#define RMI_SIM_LINE_LENGTH     512
+#define RMI_SIM_F01_CMD_RESET   0x01
+#define PS2_RET_ACK             0xfa
+
+OSDefineMetaClassAndStructors(RMISimTransport, RMITransport)
+#define super RMITransport
+
+bool RMISimTransport::init(OSDictionary *dictionary) {
+    if (!super::init(dictionary))
+        return false;
+
+    regs = reinterpret_cast<UInt8 *>(IOMallocZero(RMI_SIM_REGISTER_SPACE));
+    initialRegs = reinterpret_cast<UInt8 *>(IOMallocZero(RMI_SIM_REGISTER_SPACE));
+    return regs != nullptr && initialRegs != nullptr;
+}
+
+void RMISimTransport::free() {
+    if (regs != nullptr) {
+        IOFree(regs, RMI_SIM_REGISTER_SPACE);
+        regs = nullptr;
+    }
+
+    if (initialRegs != nullptr) {
+        IOFree(initialRegs, RMI_SIM_REGISTER_SPACE);
+        initialRegs = nullptr;
+    }
+
+    super::free();
+}
+
+// MARK: Bus interface
+
+int RMISimTransport::readBlock(UInt16 rmiaddr, UInt8 *databuff, size_t len) {
+    if (rmiaddr + len > RMI_SIM_REGISTER_SPACE)
+        return -1;
+
+    if (blockSize) {
+        size_t blocks = (len + blockSize - 1) / blockSize;
+        stats.reads += blocks;
+        stats.unprepared += blocks;
+    } else {
+        stats.reads++;
+    }
+    stats.readBytes += len;
+
+    return readRegisters(rmiaddr, databuff, len);
+}
+
+int RMISimTransport::prepareRead(UInt16 rmiaddr, size_t len) {
+    if (!blockSize || len == 0 || rmiaddr + len > RMI_SIM_REGISTER_SPACE)
+        return -1;
+
+    for (int handle = 0; handle < RMI_PREPARED_READS_MAX; handle++) {
+        if (prepared[handle].len == 0) {
+            prepared[handle].addr = rmiaddr;
+            prepared[handle].len = len;
+            return handle;
+        }
+    }
+
+    return -1;
+}
+
+int RMISimTransport::readPrepared(int handle, UInt8 *databuff, size_t len) {
+    if (handle < 0 || handle >= RMI_PREPARED_READS_MAX || prepared[handle].len == 0)
+        return -1;
+
+    const RmiReadRange &read = prepared[handle];
+    // Whole blocks, like RMISMBus
+    size_t blocks = (min(len, read.len) + blockSize - 1) / blockSize;
+    size_t bytes = min(blocks * blockSize, read.len);
+
+    stats.reads += blocks;
+    stats.readBytes += bytes;
+    return readRegisters(read.addr, databuff, bytes);
+}
+
+void RMISimTransport::releaseRead(int handle) {
+    if (handle >= 0 && handle < RMI_PREPARED_READS_MAX)
+        prepared[handle].len = 0;
+}
+
+int RMISimTransport::readRegisters(UInt16 rmiaddr, UInt8 *databuff, size_t len) {
+    size_t copied = 0;
+
+    auto stream = streamOffsets.find(rmiaddr);
+    if (stream != streamOffsets.end()) {
+        if (stream->second + len > RMI_SIM_REGISTER_SPACE)
+            return -1;
+        rmiaddr = stream->second;
+    }
+
+    auto packet = packets.find(rmiaddr);
+    if (packet != packets.end()) {
+        copied = min((int) len, (int) packet->second.size());
+        memcpy(databuff, packet->second.data(), copied);
+        // Anything past the packet comes from the registers after it
+        if (copied < len)
+            memcpy(databuff + copied, &regs[rmiaddr + 1], len - copied);
+    } else {
+        memcpy(databuff, &regs[rmiaddr], len);
+    }
+
+    // Interrupt status clears on read
+    if (f01 != nullptr) {
+        UInt16 status = irqStatusAddr();
+        if (rmiaddr < status + irqRegisterCount() && rmiaddr + len > status)
+            memset(&regs[status], 0, irqRegisterCount());
+    }
+
+    if (f03 != nullptr)
+        consumePs2OutputBuffers(rmiaddr, len);
+
+    return 0;
+}
+
+int RMISimTransport::blockWrite(UInt16 rmiaddr, UInt8 *buf, size_t len) {
+    if (rmiaddr + len > RMI_SIM_REGISTER_SPACE || len == 0)
+        return -1;
+
+    stats.writes++;
+    stats.writeBytes += len;
+
+    auto packet = packets.find(rmiaddr);
+    if (packet != packets.end()) {
+        if (packet->second.size() < len)
+            packet->second.resize(len);
+        memcpy(packet->second.data(), buf, len);
+    } else {
+        memcpy(&regs[rmiaddr], buf, len);
+    }
+
+    if (f03 != nullptr && rmiaddr == functionBase(*f03, f03->dataBase))
+        ps2Write(buf[0]);
+
+    if (f01 != nullptr && rmiaddr == functionBase(*f01, f01->cmdBase) &&
+        (buf[0] & RMI_SIM_F01_CMD_RESET))
+        reset();
+
+    return 0;
+}
+
+int RMISimTransport::reset() {
+    memcpy(regs, initialRegs, RMI_SIM_REGISTER_SPACE);
+    packets = initialPackets;
+    ps2Output.clear();
+    ps2Bursts.clear();
+    ps2ParamsLeft = 0;
+    return 0;
+}
+
+// MARK: Device side
+
+void RMISimTransport::setRegisters(UInt16 addr, const UInt8 *buf, size_t len) {
+    if (addr + len > RMI_SIM_REGISTER_SPACE)
+        return;
+
+    memcpy(&regs[addr], buf, len);
+}
+
+void RMISimTransport::setPacket(UInt16 addr, const UInt8 *buf, size_t len) {
+    packets[addr].assign(buf, buf + len);
+}
+
+void RMISimTransport::raiseIrq(UInt32 mask) {
+    if (f01 == nullptr)
+        return;
+
+    UInt16 status = irqStatusAddr();
+    for (int i = 0; i < irqRegisterCount(); i++)
+        regs[status + i] |= (mask >> (i * 8)) & 0xFF;
+}
+
+int RMISimTransport::deliverInterrupts() {
+    int count = 0;
+
+    if (f03 != nullptr)
+        releasePs2Burst();
+
+    // Bus only opens the transport once it's ready for interrupts
+    while (bus != nullptr && pendingIrqs() && count < RMI_SIM_MAX_DELIVERIES) {
+        stats.interrupts++;
+        count++;
+        messageClient(kIOMessageVoodooSMBusHostNotify, bus);
+    }
+
+    if (count == RMI_SIM_MAX_DELIVERIES)
+        IOLogError("Sim - Interrupt 0x%x is never cleared", pendingIrqs());
+
+    return count;
+}
+
+UInt32 RMISimTransport::getIrqMask(UInt8 function) const {
+    const RmiSimFunction *func = findFunction(function);
+    return func ? func->irqMask : 0;
+}
+
+const RmiSimFunction *RMISimTransport::findFunction(UInt8 function) const {
+    for (int i = 0; i < functionCount; i++) {
+        if (functions[i].function == function)
+            return &functions[i];
+    }
+
+    return nullptr;
+}
+
+UInt16 RMISimTransport::functionBase(const RmiSimFunction &func, UInt8 base) const {
+    return func.page * 0x100 + base;
+}
+
+UInt16 RMISimTransport::irqStatusAddr() const {
+    return functionBase(*f01, f01->dataBase) + 1;
+}
+
+UInt16 RMISimTransport::irqEnableAddr() const {
+    return functionBase(*f01, f01->ctrlBase) + 1;
+}
+
+UInt8 RMISimTransport::irqRegisterCount() const {
+    return (irqCount + 7) / 8;
+}
+
+UInt32 RMISimTransport::pendingIrqs() const {
+    UInt32 pending = 0;
+
+    if (f01 == nullptr)
+        return 0;
+
+    for (int i = 0; i < irqRegisterCount(); i++)
+        pending |= (regs[irqStatusAddr() + i] & regs[irqEnableAddr() + i]) << (i * 8);
+
+    return pending;
+}
+
+// MARK: PS/2 device behind F03
+
+void RMISimTransport::ps2Write(UInt8 byte) {
+    ps2Bursts.push_back({PS2_RET_ACK});
+
+    if (ps2ParamsLeft > 0) {
+        if (--ps2ParamsLeft == 0)
+            queuePs2Reply(ps2Replies[ps2Command]);
+    } else {
+        ps2Command = byte;
+        auto reply = ps2Replies.find(byte);
+        if (reply != ps2Replies.end()) {
+            ps2ParamsLeft = reply->second.params;
+            if (ps2ParamsLeft == 0)
+                queuePs2Reply(reply->second);
+        }
+    }
+}
+
+void RMISimTransport::queuePs2Reply(const RmiSimPs2Reply &reply) {
+    if (!reply.reply.empty())
+        ps2Bursts.push_back(reply.reply);
+}
+
+void RMISimTransport::sendPs2Bytes(const UInt8 *buf, size_t len) {
+    if (f03 == nullptr || len == 0)
+        return;
+
+    ps2Bursts.emplace_back(buf, buf + len);
+}
+
+/*
+ * A real device answers after the driver went back to sleep, so only one
+ * burst is put on the output buffers per delivery. Handing F03 the ACK
+ * and the reply at once makes it miss the wakeup for the reply.
+ */
+void RMISimTransport::releasePs2Burst() {
+    UInt16 ob = functionBase(*f03, f03->dataBase) + RMI_SIM_F03_OB_OFFSET;
+
+    if (!ps2Output.empty() || ps2Bursts.empty())
+        return;
+
+    for (int i = 0; i < f03QueueLength; i++, ob += RMI_SIM_F03_OB_SIZE) {
+        if (regs[ob] & RMI_SIM_F03_OB_FULL)
+            return;
+    }
+
+    ps2Output.assign(ps2Bursts.front().begin(), ps2Bursts.front().end());
+    ps2Bursts.pop_front();
+    fillPs2OutputBuffers();
+}
+
+void RMISimTransport::fillPs2OutputBuffers() {
+    UInt16 ob = functionBase(*f03, f03->dataBase) + RMI_SIM_F03_OB_OFFSET;
+    bool full = false;
+
+    for (int i = 0; i < f03QueueLength; i++, ob += RMI_SIM_F03_OB_SIZE) {
+        if (!(regs[ob] & RMI_SIM_F03_OB_FULL) && !ps2Output.empty()) {
+            regs[ob] = RMI_SIM_F03_OB_FULL;
+            regs[ob + 1] = ps2Output.front();
+            ps2Output.pop_front();
+        }
+
+        full |= regs[ob] & RMI_SIM_F03_OB_FULL;
+    }
+
+    if (full)
+        raiseIrq(f03->irqMask);
+}
+
+void RMISimTransport::consumePs2OutputBuffers(UInt16 addr, size_t len) {
+    UInt16 ob = functionBase(*f03, f03->dataBase) + RMI_SIM_F03_OB_OFFSET;
+    bool consumed = false;
+
+    for (int i = 0; i < f03QueueLength; i++, ob += RMI_SIM_F03_OB_SIZE) {
+        if (ob >= addr && ob < addr + len && (regs[ob] & RMI_SIM_F03_OB_FULL)) {
+            regs[ob] = 0;
+            consumed = true;
+        }
+    }
+
+    if (consumed)
+        fillPs2OutputBuffers();
+}
+
+// MARK: Profiles
+
+/*
+ * Profiles are line based, '#' starts a comment. Register contents are
+ * hex bytes, everything else is a C style number.
+ *
+ *   name <part>
+ *   pdt F<fn> page=<n> qry=<n> cmd=<n> ctrl=<n> data=<n> irqs=<n> [version=<n>]
+ *   reg <addr> <bytes...>
+ *   packet <addr> <bytes...>
+ *   stream <addr> <register sizes...>
+ *   ps2 <command> params=<n> [reply bytes...]
+ *
+ * A stream lays out consecutive packet registers back to back in the flat
+ * map from addr, so both a read of all of them and a read starting at one
+ * of them work. Sizes are hex like register contents.
+ *
+ * PDT entries are laid out in the order given, and IRQ bits are assigned
+ * in the same order the bus scans them. Addresses can be plain numbers or
+ * relative to a function already in the PDT, like F01.qry+17.
+ */
+bool RMISimTransport::loadProfile(const char *path) {
+    char line[RMI_SIM_LINE_LENGTH];
+    int lineNumber = 0;
+    bool ret = true;
+
+    FILE *file = fopen(path, "r");
+    if (file == nullptr) {
+        IOLogError("Sim - Could not open profile %s", path);
+        return false;
+    }
+
+    while (ret && fgets(line, sizeof(line), file) != nullptr) {
+        lineNumber++;
+        ret = parseLine(line, lineNumber);
+    }
+
+    fclose(file);
+    if (!ret)
+        return false;
+
+    if (f01 == nullptr) {
+        IOLogError("Sim - Profile %s has no F01", path);
+        return false;
+    }
+
+    if (f03 != nullptr) {
+        UInt16 qry = functionBase(*f03, f03->qryBase);
+        UInt8 deviceCount = regs[qry] & 0x07;
+        UInt8 bytesPerDevice = (regs[qry] >> 4) & 0x07;
+
+        f03QueueLength = (deviceCount * bytesPerDevice) ? regs[qry + 1] & 0x0F : 7;
+    }
+
+    memcpy(initialRegs, regs, RMI_SIM_REGISTER_SPACE);
+    initialPackets = packets;
+
+    IOLogInfo("Sim - Loaded %s: %d functions, %d IRQs", name, functionCount, irqCount);
+    return true;
+}
+
+bool RMISimTransport::parseLine(char *line, int lineNumber) {
+    std::vector<UInt8> bytes;
+    char *comment = strchr(line, '#');
+    char *directive, *args;
+    UInt16 addr;
+
+    if (comment != nullptr)
+        *comment = '\0';
+
+    directive = strtok_r(line, " \t\r\n", &args);
+    if (directive == nullptr)
+        return true;
+
+    if (!strcmp(directive, "name")) {
+        char *value = strtok_r(nullptr, " \t\r\n", &args);
+        if (value != nullptr)
+            snprintf(name, sizeof(name), "%s", value);
+        return true;
+    }
+
+    if (!strcmp(directive, "pdt")) {
+        if (addFunction(args))
+            return true;
+    } else if (!strcmp(directive, "ps2")) {
+        if (addPs2Reply(args))
+            return true;
+    } else if (!strcmp(directive, "stream")) {
+        char *target = strtok_r(nullptr, " \t\r\n", &args);
+
+        if (target != nullptr && resolveAddress(target, addr) && parseBytes(args, bytes) > 0 &&
+            addStream(addr, bytes))
+            return true;
+    } else if (!strcmp(directive, "reg") || !strcmp(directive, "packet")) {
+        char *target = strtok_r(nullptr, " \t\r\n", &args);
+
+        if (target != nullptr && resolveAddress(target, addr) && parseBytes(args, bytes) > 0) {
+            if (!strcmp(directive, "reg"))
+                setRegisters(addr, bytes.data(), bytes.size());
+            else
+                setPacket(addr, bytes.data(), bytes.size());
+            return true;
+        }
+    } else {
+        IOLogError("Sim - Unknown directive '%s'", directive);
+    }
+
+    IOLogError("Sim - Invalid profile line %d", lineNumber);
+    return false;
+}
+
+bool RMISimTransport::addStream(UInt16 addr, const std::vector<UInt8> &sizes) {
+    UInt16 offset = addr;
+
+    for (size_t i = 0; i < sizes.size(); i++) {
+        if (offset + sizes[i] > RMI_SIM_REGISTER_SPACE)
+            return false;
+
+        if (i > 0)
+            streamOffsets[addr + i] = offset;
+        offset += sizes[i];
+    }
+
+    return true;
+}
+
+bool RMISimTransport::addFunction(char *args) {
+    RmiSimFunction func {};
+    char *token, *value;
+    int irqs = 0;
+
+    token = strtok_r(nullptr, " \t\r\n", &args);
+    if (token == nullptr || toupper(token[0]) != 'F')
+        return false;
+
+    func.function = strtoul(token + 1, nullptr, 16);
+
+    while ((token = strtok_r(nullptr, " \t\r\n", &args)) != nullptr) {
+        value = strchr(token, '=');
+        if (value == nullptr)
+            return false;
+
+        *value++ = '\0';
+        UInt32 number = (UInt32) strtoul(value, nullptr, 0);
+
+        if (!strcmp(token, "page"))
+            func.page = number;
+        else if (!strcmp(token, "qry"))
+            func.qryBase = number;
+        else if (!strcmp(token, "cmd"))
+            func.cmdBase = number;
+        else if (!strcmp(token, "ctrl"))
+            func.ctrlBase = number;
+        else if (!strcmp(token, "data"))
+            func.dataBase = number;
+        else if (!strcmp(token, "irqs"))
+            irqs = number;
+        else if (!strcmp(token, "version"))
+            func.version = number;
+        else
+            return false;
+    }
+
+    if (functionCount >= RMI_SIM_MAX_FUNCTIONS || irqs > 7 || irqCount + irqs > 32)
+        return false;
+
+    int slot = 0;
+    for (int i = 0; i < functionCount; i++) {
+        if (functions[i].page == func.page)
+            slot++;
+        // Pages are scanned in order, so IRQ bits would not match
+        else if (functions[i].page > func.page)
+            return false;
+    }
+
+    func.interruptBits = irqs;
+    func.irqMask = ((1ULL << irqs) - 1) << irqCount;
+    irqCount += irqs;
+
+    UInt16 entry = func.page * 0x100 + RMI_SIM_PDT_START - slot * RMI_SIM_PDT_ENTRY_SIZE;
+    regs[entry] = func.qryBase;
+    regs[entry + 1] = func.cmdBase;
+    regs[entry + 2] = func.ctrlBase;
+    regs[entry + 3] = func.dataBase;
+    regs[entry + 4] = (func.interruptBits & 0x07) | ((func.version & 0x03) << 5);
+    regs[entry + 5] = func.function;
+
+    functions[functionCount] = func;
+    if (func.function == 0x01)
+        f01 = &functions[functionCount];
+    else if (func.function == 0x03)
+        f03 = &functions[functionCount];
+
+    functionCount++;
+    return true;
+}
+
+bool RMISimTransport::addPs2Reply(char *args) {
+    RmiSimPs2Reply reply {};
+    char *token = strtok_r(nullptr, " \t\r\n", &args);
+    char *params = strtok_r(nullptr, " \t\r\n", &args);
+
+    if (token == nullptr || params == nullptr || strncmp(params, "params=", 7))
+        return false;
+
+    reply.params = strtoul(params + 7, nullptr, 0);
+    if (parseBytes(args, reply.reply) < 0)
+        return false;
+
+    ps2Replies[strtoul(token, nullptr, 0)] = reply;
+    return true;
+}
+
+int RMISimTransport::parseBytes(char *args, std::vector<UInt8> &bytes) {
+    char *token, *end;
+
+    while ((token = strtok_r(nullptr, " \t\r\n", &args)) != nullptr) {
+        unsigned long byte = strtoul(token, &end, 16);
+        if (*end != '\0' || byte > 0xFF)
+            return -1;
+
+        bytes.push_back(byte);
+    }
+
+    return (int) bytes.size();
+}
+
+bool RMISimTransport::resolveAddress(const char *token, UInt16 &addr) const {
+    const RmiSimFunction *func;
+    char *end;
+    UInt8 base;
+
+    if (toupper(token[0]) != 'F' || strchr(token, '.') == nullptr) {
+        unsigned long value = strtoul(token, &end, 0);
+        addr = value;
+        return *end == '\0' && value < RMI_SIM_REGISTER_SPACE;
+    }
+
+    func = findFunction(strtoul(token + 1, &end, 16));
+    if (func == nullptr || *end != '.')
+        return false;
+
+    const char *field = end + 1;
+    size_t fieldLength = strcspn(field, "+");
+
+    if (fieldLength == 3 && !strncmp(field, "qry", 3))
+        base = func->qryBase;
+    else if (fieldLength == 3 && !strncmp(field, "cmd", 3))
+        base = func->cmdBase;
+    else if (fieldLength == 4 && !strncmp(field, "ctrl", 4))
+        base = func->ctrlBase;
+    else if (fieldLength == 4 && !strncmp(field, "data", 4))
+        base = func->dataBase;
+    else
+        return false;
+
+    addr = functionBase(*func, base);
+    end = const_cast<char *>(field + fieldLength);
+    if (*end == '+')
+        addr += strtoul(end + 1, &end, 0);
+
+    return *end == '\0';
+}
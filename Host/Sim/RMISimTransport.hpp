@@ -0,0 +1,169 @@
+/* SPDX-License-Identifier: GPL-2.0-only
+ * Simulated RMI4 device for the host build
+ *
+ * Copyright (c) 2023 Avery Black
+ */
+
+#ifndef RMISimTransport_hpp
+#define RMISimTransport_hpp
+
+#include <map>
+#include <vector>
+#include <deque>
+#include "RMITransport.hpp"
+
+#define RMI_SIM_REGISTER_SPACE  0x10000
+#define RMI_SIM_MAX_FUNCTIONS   16
+#define RMI_SIM_PDT_START       0xE9
+#define RMI_SIM_PDT_ENTRY_SIZE  6
+#define RMI_SIM_NAME_LENGTH     32
+
+// F03 output buffer layout, see F03.cpp
+#define RMI_SIM_F03_OB_OFFSET   2
+#define RMI_SIM_F03_OB_SIZE     2
+#define RMI_SIM_F03_OB_FULL     0x01
+
+/*
+ * Bus cost of everything the driver did. Reads and writes are single
+ * transactions no matter their length, unless a block size is set. Then
+ * reads are split into blocks like on SMBus, and unprepared counts the
+ * blocks that didn't come from a prepared read, which on SMBus each need
+ * a mapping table entry.
+ */
+struct RmiSimStats {
+    UInt64 reads;
+    UInt64 writes;
+    UInt64 readBytes;
+    UInt64 writeBytes;
+    UInt64 interrupts;
+    UInt64 unprepared;
+};
+
+/*
+ * A function as described by the profile's PDT
+ */
+struct RmiSimFunction {
+    UInt8 function;
+    UInt8 page;
+    UInt8 qryBase;
+    UInt8 cmdBase;
+    UInt8 ctrlBase;
+    UInt8 dataBase;
+    UInt8 interruptBits;
+    UInt8 version;
+    UInt32 irqMask;
+};
+
+/*
+ * Reply of the PS/2 device behind F03 to a command byte
+ */
+struct RmiSimPs2Reply {
+    UInt8 params;
+    std::vector<UInt8> reply;
+};
+
+/*
+ * RMI4 device backed by a 64 KiB register map, loaded from a profile of a
+ * concrete part. Packet registers (F12 descriptors/controls, F01 build ID)
+ * hold more bytes than their single address and are returned whole when a
+ * transfer starts at them, everything else is a flat byte map. Packet
+ * registers that are mostly read back to back (F12 data) are kept flat
+ * instead, with reads starting at one of them redirected to its bytes.
+ *
+ * Interrupts are raised by setting the F01 interrupt status bits, which
+ * clear on read like on hardware. They are only sent to the bus from
+ * deliverInterrupts(), so the caller decides when the "hardware" runs.
+ */
+class RMISimTransport : public RMITransport {
+    OSDeclareDefaultStructors(RMISimTransport);
+
+public:
+    bool init(OSDictionary *dictionary = nullptr) override;
+    void free() override;
+
+    int readBlock(UInt16 rmiaddr, UInt8 *databuff, size_t len) override;
+    int blockWrite(UInt16 rmiaddr, UInt8 *buf, size_t len) override;
+    int prepareRead(UInt16 rmiaddr, size_t len) override;
+    int readPrepared(int handle, UInt8 *databuff, size_t len) override;
+    void releaseRead(int handle) override;
+    size_t getPreparedReadBlockSize() override { return blockSize; }
+    int reset() override;
+
+    // Model a bus moving at most size bytes per read, with prepared reads
+    // read in whole blocks like RMISMBus. 0 (the default) for neither
+    inline void setBlockSize(size_t size) { blockSize = size; }
+
+    bool loadProfile(const char *path);
+
+    // Resolve "F12.data+3" style addresses, or plain numbers
+    bool resolveAddress(const char *token, UInt16 &addr) const;
+    UInt32 getIrqMask(UInt8 function) const;
+    inline const char *getProfileName() const { return name; }
+    inline bool hasPs2Pending() const { return !ps2Bursts.empty() || !ps2Output.empty(); }
+
+    // Device side updates, these don't count as bus traffic
+    void setRegisters(UInt16 addr, const UInt8 *buf, size_t len);
+    void setPacket(UInt16 addr, const UInt8 *buf, size_t len);
+    void sendPs2Bytes(const UInt8 *buf, size_t len);
+    void raiseIrq(UInt32 mask);
+
+    // Notify the bus until no enabled interrupt is pending, queued PS/2 bytes go
+    // out one burst per call. Returns the number of notifications
+    int deliverInterrupts();
+
+    inline const RmiSimStats &getStats() const { return stats; }
+    inline void resetStats() { memset(&stats, 0, sizeof(stats)); }
+
+    // Parse the remaining strtok_r tokens as hex bytes, returns the count or -1
+    static int parseBytes(char *args, std::vector<UInt8> &bytes);
+
+private:
+    char name[RMI_SIM_NAME_LENGTH] {};
+    UInt8 *regs {nullptr};
+    UInt8 *initialRegs {nullptr};
+    std::map<UInt16, std::vector<UInt8>> packets;
+    std::map<UInt16, std::vector<UInt8>> initialPackets;
+    // Packet register address to where its bytes are in the flat map
+    std::map<UInt16, UInt16> streamOffsets;
+
+    RmiSimFunction functions[RMI_SIM_MAX_FUNCTIONS] {};
+    int functionCount {0};
+    UInt8 irqCount {0};
+
+    const RmiSimFunction *f01 {nullptr};
+    const RmiSimFunction *f03 {nullptr};
+    UInt8 f03QueueLength {0};
+
+    std::map<UInt8, RmiSimPs2Reply> ps2Replies;
+    std::deque<std::vector<UInt8>> ps2Bursts;
+    std::deque<UInt8> ps2Output;
+    UInt8 ps2Command {0};
+    UInt8 ps2ParamsLeft {0};
+
+    RmiSimStats stats {};
+    size_t blockSize {0};
+    // Released reads have no length
+    RmiReadRange prepared[RMI_PREPARED_READS_MAX] {};
+
+    int readRegisters(UInt16 rmiaddr, UInt8 *databuff, size_t len);
+
+    bool addStream(UInt16 addr, const std::vector<UInt8> &sizes);
+    const RmiSimFunction *findFunction(UInt8 function) const;
+    UInt16 functionBase(const RmiSimFunction &func, UInt8 base) const;
+    UInt16 irqStatusAddr() const;
+    UInt16 irqEnableAddr() const;
+    UInt8 irqRegisterCount() const;
+    UInt32 pendingIrqs() const;
+
+    bool parseLine(char *line, int lineNumber);
+    bool addFunction(char *args);
+    bool addPs2Reply(char *args);
+
+    void ps2Write(UInt8 byte);
+    void queuePs2Reply(const RmiSimPs2Reply &reply);
+    void releasePs2Burst();
+    void fillPs2OutputBuffers();
+    void consumePs2OutputBuffers(UInt16 addr, size_t len);
+};
+
+#endif /* RMISimTransport_hpp */
@@ -0,0 +1,205 @@
+/* SPDX-License-Identifier: GPL-2.0-only
+ * Replays a recorded bus trace
+ *
+ * Copyright (c) 2023 Avery Black
+ */
+
+#include "RMITraceReplay.hpp"
+#include "RMILogging.h"
+
+OSDefineMetaClassAndStructors(RMITraceReplay, RMITransport)
+#define super RMITransport
+
+bool RMITraceReplay::init(OSDictionary *dictionary) {
+    if (!super::init(dictionary))
+        return false;
+
+    regs = reinterpret_cast<UInt8 *>(IOMallocZero(RMI_REPLAY_REGISTER_SPACE));
+    return regs != nullptr;
+}
+
+void RMITraceReplay::free() {
+    if (regs != nullptr) {
+        IOFree(regs, RMI_REPLAY_REGISTER_SPACE);
+        regs = nullptr;
+    }
+
+    super::free();
+}
+
+bool RMITraceReplay::loadTrace(const char *path) {
+    RmiTraceRecord rec;
+    UInt8 chunk[4096];
+    size_t offset, read;
+    UInt64 time = 0;
+
+    FILE *file = fopen(path, "rb");
+    if (file == nullptr) {
+        IOLogError("Replay - Could not open trace %s", path);
+        return false;
+    }
+
+    while ((read = fread(chunk, 1, sizeof(chunk), file)) > 0)
+        trace.insert(trace.end(), chunk, chunk + read);
+    fclose(file);
+
+    if (trace.size() < sizeof(header))
+        goto invalid;
+
+    memcpy(&header, trace.data(), sizeof(header));
+    if (header.magic != RMI_TRACE_MAGIC || header.version != RMI_TRACE_VERSION ||
+        header.headerSize < sizeof(header) || header.headerSize > trace.size())
+        goto invalid;
+
+    offset = header.headerSize;
+    while (offset + sizeof(rec) <= trace.size()) {
+        memcpy(&rec, trace.data() + offset, sizeof(rec));
+        offset += sizeof(rec);
+
+        if (offset + rec.length > trace.size())
+            goto invalid;
+
+        time += (UInt64) rec.delta * 1000;
+        records.push_back({static_cast<RmiTraceRecordType>(rec.type), rec.addr, rec.length,
+                           rec.result, time, offset});
+        offset += rec.length;
+    }
+
+    if (records.size() != header.recordCount)
+        goto invalid;
+
+    beginSegment(0);
+    IOLogInfo("Replay - Loaded %lu records from %s, %u dropped while recording",
+              records.size(), path, header.droppedCount);
+    return true;
+invalid:
+    IOLogError("Replay - %s is not a valid trace", path);
+    return false;
+}
+
+// MARK: Bus interface
+
+int RMITraceReplay::readBlock(UInt16 rmiaddr, UInt8 *databuff, size_t len) {
+    if (rmiaddr + len > RMI_REPLAY_REGISTER_SPACE)
+        return -1;
+
+    const RmiReplayRecord *record = expect(RMI_TRACE_READ, rmiaddr, len);
+    if (record != nullptr) {
+        memcpy(databuff, payloadOf(*record), len);
+        return record->result;
+    }
+
+    diverged("read", rmiaddr, len);
+    memcpy(databuff, &regs[rmiaddr], len);
+    return 0;
+}
+
+int RMITraceReplay::blockWrite(UInt16 rmiaddr, UInt8 *buf, size_t len) {
+    const RmiReplayRecord *record = expect(RMI_TRACE_WRITE, rmiaddr, len);
+    if (record != nullptr && !memcmp(payloadOf(*record), buf, len))
+        return record->result;
+
+    diverged("write", rmiaddr, len);
+    return 0;
+}
+
+int RMITraceReplay::reset() {
+    const RmiReplayRecord *record = expect(RMI_TRACE_RESET, 0, 0);
+    if (record != nullptr)
+        return record->result;
+
+    diverged("reset", 0, 0);
+    return 0;
+}
+
+// MARK: Interrupts
+
+bool RMITraceReplay::isEvent(const RmiReplayRecord &record) {
+    return record.type == RMI_TRACE_HOST_NOTIFY || record.type == RMI_TRACE_ATTENTION;
+}
+
+bool RMITraceReplay::nextEventTime(UInt64 &time) const {
+    for (size_t i = cursor; i < records.size(); i++) {
+        if (isEvent(records[i])) {
+            time = records[i].time;
+            return true;
+        }
+    }
+
+    return false;
+}
+
+bool RMITraceReplay::deliverNext() {
+    size_t event = cursor;
+    RmiAttention attention;
+
+    while (event < records.size() && !isEvent(records[event]))
+        event++;
+
+    if (event == records.size() || bus == nullptr)
+        return false;
+
+    // Whatever the driver didn't repeat since the last interrupt
+    stats.skipped += event - cursor;
+    stats.events++;
+    beginSegment(event + 1);
+
+    const RmiReplayRecord &record = records[event];
+    if (record.type == RMI_TRACE_HOST_NOTIFY) {
+        messageClient(kIOMessageVoodooSMBusHostNotify, bus);
+        return true;
+    }
+
+    if (record.length < sizeof(attention.irqStatus))
+        return true;
+
+    memcpy(&attention.irqStatus, payloadOf(record), sizeof(attention.irqStatus));
+    attention.data = payloadOf(record) + sizeof(attention.irqStatus);
+    attention.size = record.length - sizeof(attention.irqStatus);
+    messageClient(kIOMessageVoodooI2CLegacyHostNotify, bus, &attention);
+    return true;
+}
+
+// Fill the register image with what the device returned until the next interrupt
+void RMITraceReplay::beginSegment(size_t start) {
+    cursor = start;
+
+    for (segmentEnd = start; segmentEnd < records.size(); segmentEnd++) {
+        const RmiReplayRecord &record = records[segmentEnd];
+
+        if (isEvent(record))
+            break;
+
+        if (record.type == RMI_TRACE_READ && record.addr + record.length <= RMI_REPLAY_REGISTER_SPACE)
+            memcpy(&regs[record.addr], payloadOf(record), record.length);
+    }
+}
+
+/*
+ * The next matching transaction in this segment. Recorded transactions
+ * that were passed over are counted as skipped
+ */
+const RmiReplayRecord *RMITraceReplay::expect(RmiTraceRecordType type, UInt16 addr, size_t len) {
+    for (size_t i = cursor; i < segmentEnd; i++) {
+        const RmiReplayRecord &record = records[i];
+
+        if (record.type == type && record.addr == addr && record.length == len) {
+            stats.skipped += i - cursor;
+            stats.matched++;
+            cursor = i + 1;
+            return &record;
+        }
+    }
+
+    return nullptr;
+}
+
+void RMITraceReplay::diverged(const char *what, UInt16 addr, size_t len) {
+    stats.diverged++;
+
+    if (!reported) {
+        IOLogInfo("Replay - Driver diverged from the trace at record %lu: %s 0x%x (%lu bytes)",
+                  cursor, what, addr, len);
+        reported = true;
+    }
+}
@@ -0,0 +1,87 @@
+/* SPDX-License-Identifier: GPL-2.0-only
+ * Replays a recorded bus trace
+ *
+ * Copyright (c) 2023 Avery Black
+ */
+
+#ifndef RMITraceReplay_hpp
+#define RMITraceReplay_hpp
+
+#include <vector>
+#include "RMITransport.hpp"
+#include "RMITraceRecorder.hpp"
+
+#define RMI_REPLAY_REGISTER_SPACE   0x10000
+
+struct RmiReplayStats {
+    UInt64 events;
+    UInt64 matched;     // Transactions that came in the recorded order
+    UInt64 diverged;    // Transactions that didn't, served from the register image
+    UInt64 skipped;     // Recorded transactions the driver didn't repeat
+};
+
+struct RmiReplayRecord {
+    RmiTraceRecordType type;
+    UInt16 addr;
+    UInt16 length;
+    SInt32 result;
+    UInt64 time;        // ns since the start of the trace
+    size_t payload;     // Offset into the trace
+};
+
+/*
+ * Serves a trace recorded by RMITraceRecorder back to the bus. Between two
+ * interrupts, transactions that come in the recorded order get exactly the
+ * recorded bytes. Anything else is served from a register image built from
+ * the reads recorded for that interrupt, so the trace still plays when the
+ * driver reads differently than the one that recorded it. The stats tell
+ * how closely it followed.
+ */
+class RMITraceReplay : public RMITransport {
+    OSDeclareDefaultStructors(RMITraceReplay);
+
+public:
+    bool init(OSDictionary *dictionary = nullptr) override;
+    void free() override;
+
+    int readBlock(UInt16 rmiaddr, UInt8 *databuff, size_t len) override;
+    int blockWrite(UInt16 rmiaddr, UInt8 *buf, size_t len) override;
+    int reset() override;
+    // Functions choose their reads by this, so report what was recorded
+    size_t getPreparedReadBlockSize() override { return header.preparedBlockSize; }
+
+    bool loadTrace(const char *path);
+
+    // Time of the next interrupt, false once the trace is done
+    bool nextEventTime(UInt64 &time) const;
+    // Whether the driver did everything that was recorded before the next interrupt
+    inline bool isEventNext() const { return cursor < records.size() && isEvent(records[cursor]); }
+    // Send the next interrupt to the bus
+    bool deliverNext();
+
+    inline const RmiReplayStats &getStats() const { return stats; }
+    inline size_t getRecordCount() const { return records.size(); }
+    inline UInt32 getDroppedCount() const { return header.droppedCount; }
+
+private:
+    std::vector<UInt8> trace;
+    std::vector<RmiReplayRecord> records;
+    RmiTraceHeader header {};
+    size_t cursor {0};
+    size_t segmentEnd {0};
+    bool reported {false};
+
+    UInt8 *regs {nullptr};
+    RmiReplayStats stats {};
+
+    inline const UInt8 *payloadOf(const RmiReplayRecord &record) const {
+        return trace.data() + record.payload;
+    }
+
+    static bool isEvent(const RmiReplayRecord &record);
+    void beginSegment(size_t start);
+    const RmiReplayRecord *expect(RmiTraceRecordType type, UInt16 addr, size_t len);
+    void diverged(const char *what, UInt16 addr, size_t len);
+};
+
+#endif /* RMITraceReplay_hpp */
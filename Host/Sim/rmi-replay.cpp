@@ -0,0 +1,149 @@
+/* SPDX-License-Identifier: GPL-2.0-only
+ * Replays a recorded bus trace through RMIBus
+ *
+ * Copyright (c) 2023 Avery Black
+ */
+
+#include <algorithm>
+#include <chrono>
+#include <thread>
+#include <IOKit/IOTimerEventSource.h>
+#include "RMIBus.hpp"
+#include "RMITraceReplay.hpp"
+#include "RMISimInput.hpp"
+
+/*
+ * Interrupts are delivered on a virtual clock following the recorded
+ * timestamps, so the driver sees the same timing as when the trace was
+ * recorded. With -speed the run is also paced in real time, 1 being the
+ * recorded speed. By default it runs as fast as it can.
+ */
+
+static RMIVirtualClock replayClock;
+static RMITraceReplay *replay = nullptr;
+
+static UInt64 replayUptime() {
+    return replayClock.now();
+}
+
+static void advanceTo(UInt64 target) {
+    AbsoluteTime deadline;
+
+    while (IOTimerEventSource::nextDeadline(&deadline) && deadline <= target) {
+        replayClock.set(std::max(replayClock.now(), deadline));
+        IOTimerEventSource::runExpired(replayClock.now());
+    }
+
+    replayClock.set(std::max(replayClock.now(), target));
+}
+
+/*
+ * F03 sleeps until the reply to a PS/2 command, which is the next interrupt.
+ * If the recorded driver did more before that interrupt, its sleep timed out
+ */
+static void deliverOnSleep() {
+    UInt64 time;
+
+    if (replay->isEventNext() && replay->nextEventTime(time)) {
+        replayClock.set(std::max<UInt64>(replayClock.now(), NSEC_PER_SEC + time));
+        replay->deliverNext();
+    }
+}
+
+int main(int argc, char **argv) {
+    const char *tracePath = nullptr;
+    bool verbose = false;
+    double speed = 0;
+    RMIBus *bus = nullptr;
+    RMISimInput *input = nullptr;
+    UInt64 time, eventNs, maxNs = 0, totalNs = 0;
+    int ret = 1;
+
+    for (int i = 1; i < argc; i++) {
+        if (!strcmp(argv[i], "-v"))
+            verbose = true;
+        else if (!strcmp(argv[i], "-speed") && i + 1 < argc)
+            speed = atof(argv[++i]);
+        else
+            tracePath = argv[i];
+    }
+
+    if (tracePath == nullptr) {
+        fprintf(stderr, "usage: %s <trace> [-speed factor] [-v]\n", argv[0]);
+        return 1;
+    }
+
+    replayClock.set(NSEC_PER_SEC);
+    gHostUptimeHook = replayUptime;
+    gHostCommandSleepHook = deliverOnSleep;
+
+    replay = OSTypeAlloc(RMITraceReplay);
+    if (replay == nullptr || !replay->init() || !replay->loadTrace(tracePath))
+        goto exit;
+
+    bus = OSTypeAlloc(RMIBus);
+    if (bus == nullptr || !bus->init(nullptr) || !bus->attach(replay))
+        goto exit;
+
+    bus->setClock(&replayClock);
+
+    if (!bus->start(replay)) {
+        fprintf(stderr, "RMIBus failed to start from the trace\n");
+        bus->detach(replay);
+        goto exit;
+    }
+
+    input = OSTypeAlloc(RMISimInput);
+    if (input == nullptr || !input->init() || !input->attach(bus) || !bus->open(input))
+        goto stop;
+
+    input->setVerbose(verbose);
+
+    while (replay->nextEventTime(time)) {
+        UInt64 target = NSEC_PER_SEC + time;
+
+        if (speed > 0 && target > replayClock.now())
+            std::this_thread::sleep_for(std::chrono::nanoseconds((UInt64) ((target - replayClock.now()) / speed)));
+
+        auto start = std::chrono::steady_clock::now();
+        advanceTo(target);
+        replay->deliverNext();
+        eventNs = std::chrono::duration_cast<std::chrono::nanoseconds>(
+            std::chrono::steady_clock::now() - start).count();
+
+        totalNs += eventNs;
+        maxNs = std::max(maxNs, eventNs);
+    }
+
+    {
+        const RmiReplayStats &stats = replay->getStats();
+        const RmiSimInputStats &inputStats = input->getStats();
+        double traceSeconds = (replayClock.now() - NSEC_PER_SEC) / 1e9;
+
+        printf("events %llu over %.3f s of trace, replayed in %.3f ms (%.0f events/s)\n",
+               stats.events, traceSeconds, totalNs / 1e6,
+               totalNs ? stats.events * 1e9 / totalNs : 0.0);
+        printf("per event: mean %.2f us  max %.2f us\n",
+               stats.events ? totalNs / 1e3 / stats.events : 0.0, maxNs / 1e3);
+        printf("transactions: matched %llu  diverged %llu  skipped %llu\n",
+               stats.matched, stats.diverged, stats.skipped);
+        printf("input: multitouch %llu  contacts %llu  trackpoint %llu  relative %llu\n",
+               inputStats.multitouchEvents, inputStats.contacts,
+               inputStats.trackpointEvents, inputStats.relativeEvents);
+    }
+    ret = 0;
+
+stop:
+    if (input != nullptr) {
+        bus->close(input);
+        input->detach(bus);
+    }
+
+    replay->close(bus);
+    bus->terminate();
+exit:
+    OSSafeReleaseNULL(input);
+    OSSafeReleaseNULL(bus);
+    OSSafeReleaseNULL(replay);
+    return ret;
+}
@@ -0,0 +1,392 @@
+/* SPDX-License-Identifier: GPL-2.0-only
+ * Runs RMIBus against a simulated device
+ *
+ * Copyright (c) 2023 Avery Black
+ */
+
+#include <algorithm>
+#include <chrono>
+#include <string>
+#include <vector>
+#include <IOKit/IOTimerEventSource.h>
+#include "RMIBus.hpp"
+#include "RMIFileCapabilityStore.hpp"
+#include "RMISimTransport.hpp"
+#include "RMISimInput.hpp"
+
+// Time the bus gets to settle after start, F03 waits 100ms before PS/2 init
+#define RMI_SIM_SETTLE_MS   500
+// KiB, for -record
+#define RMI_SIM_TRACE_SIZE  4096
+// SMBus block reads, for -smbus
+#define RMI_SIM_SMBUS_BLOCK 32
+
+/*
+ * Script commands, one per line with '#' comments:
+ *
+ *   wait <ms>                      Advance the clock, running timers
+ *   reg <addr> <bytes...>          Update registers
+ *   packet <addr> <bytes...>       Update a packet register
+ *   irq <F12|mask> [...]           Raise interrupts and deliver them
+ *   ps2 <bytes...>                 Send bytes from the PS/2 device behind F03
+ *   repeat <n> ... end             Run the enclosed lines n times
+ *   stats <label>                  Print and reset the counters
+ *   config <key> <value>           Change a setting, like from userspace
+ *
+ * Time only moves on 'wait', so runs are deterministic.
+ */
+
+// Drives both the bus timestamps and timers
+static RMIVirtualClock simClock;
+static RMISimTransport *sim = nullptr;
+static RMISimInput *input = nullptr;
+static RMIBus *simBus = nullptr;
+static std::chrono::steady_clock::time_point phaseStart;
+
+static UInt64 simUptime() {
+    return simClock.now();
+}
+
+static void deliverAll() {
+    while (sim->deliverInterrupts() > 0);
+}
+
+static void advance(UInt64 ms) {
+    UInt64 target = simClock.now() + ms * NSEC_PER_MSEC;
+    AbsoluteTime deadline;
+
+    while (IOTimerEventSource::nextDeadline(&deadline) && deadline <= target) {
+        simClock.set(std::max(simClock.now(), deadline));
+        IOTimerEventSource::runExpired(simClock.now());
+        deliverAll();
+    }
+
+    simClock.set(target);
+    deliverAll();
+}
+
+static void printStats(const char *label) {
+    const RmiSimStats &stats = sim->getStats();
+    auto wall = std::chrono::duration_cast<std::chrono::microseconds>(
+        std::chrono::steady_clock::now() - phaseStart).count();
+
+    printf("%-16s reads %6llu  writes %6llu  read bytes %8llu  write bytes %6llu  interrupts %6llu  unprepared %6llu  wall %8lld us\n",
+           label, stats.reads, stats.writes, stats.readBytes, stats.writeBytes, stats.interrupts,
+           stats.unprepared, (long long) wall);
+
+    sim->resetStats();
+    phaseStart = std::chrono::steady_clock::now();
+}
+
+static bool raiseIrqs(char *args) {
+    UInt32 mask = 0;
+    char *token, *end;
+
+    while ((token = strtok_r(nullptr, " \t\r\n", &args)) != nullptr) {
+        if (toupper(token[0]) == 'F') {
+            UInt32 irq = sim->getIrqMask(strtoul(token + 1, &end, 16));
+            if (irq == 0 || *end != '\0')
+                return false;
+            mask |= irq;
+        } else {
+            mask |= strtoul(token, &end, 0);
+            if (*end != '\0')
+                return false;
+        }
+    }
+
+    if (mask == 0)
+        return false;
+
+    sim->raiseIrq(mask);
+    deliverAll();
+    return true;
+}
+
+// Sent through setProperties, as ioio would
+static bool setConfig(const char *key, UInt64 number) {
+    OSDictionary *request = OSDictionary::withCapacity(1);
+    OSNumber *value = OSNumber::withNumber(number, 64);
+
+    if (request == nullptr || value == nullptr) {
+        OSSafeReleaseNULL(request);
+        OSSafeReleaseNULL(value);
+        return false;
+    }
+
+    request->setObject(key, value);
+    simBus->setProperties(request);
+    OSSafeReleaseNULL(value);
+    OSSafeReleaseNULL(request);
+    return true;
+}
+
+static bool runLine(const std::string &text, size_t lineNumber) {
+    std::vector<char> line(text.begin(), text.end());
+    std::vector<UInt8> bytes;
+    char *directive, *args, *target;
+    UInt16 addr;
+
+    line.push_back('\0');
+    directive = strtok_r(line.data(), " \t\r\n", &args);
+
+    if (!strcmp(directive, "wait")) {
+        target = strtok_r(nullptr, " \t\r\n", &args);
+        if (target != nullptr) {
+            advance(strtoull(target, nullptr, 0));
+            return true;
+        }
+    } else if (!strcmp(directive, "reg") || !strcmp(directive, "packet")) {
+        target = strtok_r(nullptr, " \t\r\n", &args);
+        if (target != nullptr && sim->resolveAddress(target, addr) &&
+            RMISimTransport::parseBytes(args, bytes) > 0) {
+            if (!strcmp(directive, "reg"))
+                sim->setRegisters(addr, bytes.data(), bytes.size());
+            else
+                sim->setPacket(addr, bytes.data(), bytes.size());
+            return true;
+        }
+    } else if (!strcmp(directive, "irq")) {
+        if (raiseIrqs(args))
+            return true;
+    } else if (!strcmp(directive, "ps2")) {
+        if (RMISimTransport::parseBytes(args, bytes) > 0) {
+            sim->sendPs2Bytes(bytes.data(), bytes.size());
+            deliverAll();
+            return true;
+        }
+    } else if (!strcmp(directive, "config")) {
+        char *value;
+
+        target = strtok_r(nullptr, " \t\r\n", &args);
+        value = strtok_r(nullptr, " \t\r\n", &args);
+        if (target != nullptr && value != nullptr && setConfig(target, strtoull(value, nullptr, 0)))
+            return true;
+    } else if (!strcmp(directive, "stats")) {
+        target = strtok_r(nullptr, "\r\n", &args);
+        printStats(target != nullptr ? target : "");
+        return true;
+    } else {
+        fprintf(stderr, "Unknown command '%s'\n", directive);
+    }
+
+    fprintf(stderr, "Invalid script line %zu\n", lineNumber);
+    return false;
+}
+
+static bool isKeyword(const char *text, const char *keyword) {
+    size_t length = strlen(keyword);
+    return !strncmp(text, keyword, length) && (text[length] == '\0' || isspace(text[length]));
+}
+
+static const char *skipSpace(const std::string &line) {
+    return line.c_str() + strspn(line.c_str(), " \t");
+}
+
+// Index of the 'end' closing the repeat on line start, or lines.size()
+static size_t findBlockEnd(const std::vector<std::string> &lines, size_t start) {
+    int depth = 0;
+
+    for (size_t i = start + 1; i < lines.size(); i++) {
+        const char *text = skipSpace(lines[i]);
+
+        if (isKeyword(text, "repeat"))
+            depth++;
+        else if (isKeyword(text, "end") && depth-- == 0)
+            return i;
+    }
+
+    return lines.size();
+}
+
+// Runs lines [begin, end)
+static bool runScript(const std::vector<std::string> &lines, size_t begin, size_t end) {
+    for (size_t i = begin; i < end; i++) {
+        const char *text = skipSpace(lines[i]);
+
+        if (*text == '\0')
+            continue;
+
+        if (isKeyword(text, "repeat")) {
+            unsigned long count = strtoul(text + 6, nullptr, 0);
+            size_t blockEnd = findBlockEnd(lines, i);
+
+            if (blockEnd >= end) {
+                fprintf(stderr, "Missing 'end' for repeat on line %zu\n", i + 1);
+                return false;
+            }
+
+            for (unsigned long n = 0; n < count; n++) {
+                if (!runScript(lines, i + 1, blockEnd))
+                    return false;
+            }
+
+            i = blockEnd;
+            continue;
+        }
+
+        if (isKeyword(text, "end")) {
+            fprintf(stderr, "Unmatched 'end' on line %zu\n", i + 1);
+            return false;
+        }
+
+        if (!runLine(text, i + 1))
+            return false;
+    }
+
+    return true;
+}
+
+// Written through the bus like a trace from the kext would be
+static bool saveTrace(RMIBus *bus, const char *path) {
+    OSDictionary *request = OSDictionary::withCapacity(1);
+    OSData *trace;
+    FILE *file;
+    bool ret = false;
+
+    request->setObject(RMITraceSnapshot, kOSBooleanTrue);
+    bus->setProperties(request);
+    OSSafeReleaseNULL(request);
+
+    trace = OSDynamicCast(OSData, bus->getProperty(RMITraceKey));
+    if (trace == nullptr)
+        return false;
+
+    file = fopen(path, "wb");
+    if (file != nullptr) {
+        ret = fwrite(trace->getBytesNoCopy(), 1, trace->getLength(), file) == trace->getLength();
+        fclose(file);
+    }
+
+    if (!ret)
+        fprintf(stderr, "Could not write trace to %s\n", path);
+    return ret;
+}
+
+static bool loadScript(const char *path, std::vector<std::string> &lines) {
+    char buffer[512];
+    FILE *file = fopen(path, "r");
+
+    if (file == nullptr) {
+        fprintf(stderr, "Could not open script %s\n", path);
+        return false;
+    }
+
+    while (fgets(buffer, sizeof(buffer), file) != nullptr) {
+        char *comment = strchr(buffer, '#');
+        if (comment != nullptr)
+            *comment = '\0';
+        buffer[strcspn(buffer, "\r\n")] = '\0';
+        lines.emplace_back(buffer);
+    }
+
+    fclose(file);
+    return true;
+}
+
+int main(int argc, char **argv) {
+    std::vector<std::string> script;
+    const char *profilePath = nullptr;
+    const char *scriptPath = nullptr;
+    const char *tracePath = nullptr;
+    const char *cachePath = nullptr;
+    bool verbose = false;
+    bool smbus = false;
+    RMIBus *bus = nullptr;
+    int ret = 1;
+
+    for (int i = 1; i < argc; i++) {
+        if (!strcmp(argv[i], "-v"))
+            verbose = true;
+        else if (!strcmp(argv[i], "-smbus"))
+            smbus = true;
+        else if (!strcmp(argv[i], "-record") && i + 1 < argc)
+            tracePath = argv[++i];
+        else if (!strcmp(argv[i], "-capabilities") && i + 1 < argc)
+            cachePath = argv[++i];
+        else if (profilePath == nullptr)
+            profilePath = argv[i];
+        else if (scriptPath == nullptr)
+            scriptPath = argv[i];
+    }
+
+    if (profilePath == nullptr) {
+        fprintf(stderr, "usage: %s <profile> [script] [-record trace] [-capabilities dir] [-smbus] [-v]\n", argv[0]);
+        return 1;
+    }
+
+    if (scriptPath != nullptr && !loadScript(scriptPath, script))
+        return 1;
+
+    RMIFileCapabilityStore capabilityStore(cachePath != nullptr ? cachePath : ".");
+
+    simClock.set(NSEC_PER_SEC);
+    gHostUptimeHook = simUptime;
+    // F03 sleeps on the gate waiting for PS/2 replies, which only come from interrupts
+    gHostCommandSleepHook = [] { sim->deliverInterrupts(); };
+
+    sim = OSTypeAlloc(RMISimTransport);
+    if (sim == nullptr || !sim->init() || !sim->loadProfile(profilePath))
+        goto exit;
+
+    if (smbus)
+        sim->setBlockSize(RMI_SIM_SMBUS_BLOCK);
+
+    phaseStart = std::chrono::steady_clock::now();
+
+    bus = OSTypeAlloc(RMIBus);
+    if (bus == nullptr || !bus->init(nullptr) || !bus->attach(sim))
+        goto exit;
+
+    bus->setClock(&simClock);
+    simBus = bus;
+
+    if (cachePath != nullptr) {
+        bus->setProperty("Capability Cache", true);
+        bus->setCapabilityStore(&capabilityStore);
+    }
+
+    if (tracePath != nullptr)
+        bus->setProperty(RMITraceBufferSize, RMI_SIM_TRACE_SIZE, 32);
+
+    if (!bus->start(sim)) {
+        fprintf(stderr, "RMIBus failed to start on %s\n", sim->getProfileName());
+        bus->detach(sim);
+        goto exit;
+    }
+
+    input = OSTypeAlloc(RMISimInput);
+    if (input == nullptr || !input->init() || !input->attach(bus) || !bus->open(input))
+        goto stop;
+
+    input->setVerbose(verbose);
+    printStats("start");
+
+    advance(RMI_SIM_SETTLE_MS);
+    printStats("settle");
+
+    if (!runScript(script, 0, script.size()))
+        goto stop;
+
+    if (tracePath != nullptr && !saveTrace(bus, tracePath))
+        goto stop;
+
+    printf("%-16s multitouch %llu  contacts %llu  trackpoint %llu  relative %llu\n", "input",
+           input->getStats().multitouchEvents, input->getStats().contacts,
+           input->getStats().trackpointEvents, input->getStats().relativeEvents);
+    ret = 0;
+
+stop:
+    if (input != nullptr) {
+        bus->close(input);
+        input->detach(bus);
+    }
+
+    sim->close(bus);
+    bus->terminate();
+exit:
+    OSSafeReleaseNULL(input);
+    OSSafeReleaseNULL(bus);
+    OSSafeReleaseNULL(sim);
+    return ret;
+}
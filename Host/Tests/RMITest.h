@@ -0,0 +1,24 @@
+/* SPDX-License-Identifier: GPL-2.0-only
+ * Checks for the host tests
+ *
+ * Copyright (c) 2023 Avery Black
+ */
+
+#ifndef RMITest_h
+#define RMITest_h
+
+#include <stdio.h>
+
+// Failed checks so far, main returns it
+static int gTestFailures = 0;
+
+#define RMICheck(cond, fmt, ...) do { \
+    if (!(cond)) { \
+        fprintf(stderr, "%s:%d: %s: " fmt "\n", __FILE__, __LINE__, #cond, ##__VA_ARGS__); \
+        gTestFailures++; \
+    } \
+} while (0)
+
+#define RMITestResult() (gTestFailures ? (fprintf(stderr, "%d checks failed\n", gTestFailures), 1) : 0)
+
+#endif /* RMITest_h */
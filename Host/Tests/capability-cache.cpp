@@ -0,0 +1,126 @@
+/* SPDX-License-Identifier: GPL-2.0-only
+ * Capability cache against a file store
+ *
+ * Copyright (c) 2023 Avery Black
+ */
+
+#include <stdlib.h>
+#include <unistd.h>
+#include "RMIBus.hpp"
+#include "RMIFileCapabilityStore.hpp"
+#include "RMISimTransport.hpp"
+#include "RMITest.h"
+
+/*
+ * Starts the bus three times on the same profile: the first run saves
+ * the cache, the second has to serve every query from it, and the third
+ * runs on a device with another product ID, so the cache is rejected.
+ */
+
+struct CacheRun {
+    UInt64 reads;
+    bool valid;
+    UInt32 hits;
+    UInt32 misses;
+};
+
+static RMIVirtualClock testClock;
+
+static UInt64 testUptime() {
+    return testClock.now();
+}
+
+static UInt32 statNumber(OSDictionary *stats, const char *key) {
+    OSNumber *value = OSDynamicCast(OSNumber, stats->getObject(key));
+    return value != nullptr ? value->unsigned32BitValue() : 0;
+}
+
+// productId is written over the profile's before starting if set
+static bool runBus(const char *profile, RMICapabilityStore &store, CacheRun &run,
+                   const char *productId = nullptr) {
+    RMISimTransport *sim = OSTypeAlloc(RMISimTransport);
+    RMIBus *bus = nullptr;
+    OSDictionary *stats;
+    OSBoolean *valid;
+    UInt16 addr;
+    bool ret = false;
+
+    memset(&run, 0, sizeof(run));
+    if (sim == nullptr || !sim->init() || !sim->loadProfile(profile))
+        goto exit;
+
+    if (productId != nullptr) {
+        if (!sim->resolveAddress("F01.qry+11", addr))
+            goto exit;
+        sim->setRegisters(addr, reinterpret_cast<const UInt8 *>(productId), RMI_CAP_PRODUCT_ID_LENGTH);
+    }
+
+    bus = OSTypeAlloc(RMIBus);
+    if (bus == nullptr || !bus->init(nullptr) || !bus->attach(sim))
+        goto exit;
+
+    bus->setClock(&testClock);
+    bus->setProperty("Capability Cache", true);
+    bus->setCapabilityStore(&store);
+
+    if (!bus->start(sim)) {
+        bus->detach(sim);
+        goto exit;
+    }
+
+    run.reads = sim->getStats().reads;
+    stats = OSDynamicCast(OSDictionary, bus->getProperty("Capability Cache Stats"));
+    if (stats != nullptr) {
+        valid = OSDynamicCast(OSBoolean, stats->getObject("Valid"));
+        run.valid = valid != nullptr && valid->getValue();
+        run.hits = statNumber(stats, "Hits");
+        run.misses = statNumber(stats, "Misses");
+        ret = true;
+    }
+
+    sim->close(bus);
+    bus->terminate();
+exit:
+    OSSafeReleaseNULL(bus);
+    OSSafeReleaseNULL(sim);
+    return ret;
+}
+
+int main(int argc, char **argv) {
+    char directory[] = "/tmp/rmi-capabilities-XXXXXX";
+    CacheRun cold, warm, other;
+
+    if (argc < 2) {
+        fprintf(stderr, "usage: %s <profile>\n", argv[0]);
+        return 1;
+    }
+
+    if (mkdtemp(directory) == nullptr) {
+        perror("mkdtemp");
+        return 1;
+    }
+
+    testClock.set(NSEC_PER_SEC);
+    gHostUptimeHook = testUptime;
+
+    RMIFileCapabilityStore store(directory);
+    std::string blobPath = store.pathFor(RMICapabilityCacheKey);
+
+    RMICheck(runBus(argv[1], store, cold), "cold start failed");
+    RMICheck(!cold.valid && cold.hits == 0 && cold.misses > 0,
+             "valid %d hits %u misses %u", cold.valid, cold.hits, cold.misses);
+    RMICheck(access(blobPath.c_str(), R_OK) == 0, "no cache saved at %s", blobPath.c_str());
+
+    RMICheck(runBus(argv[1], store, warm), "warm start failed");
+    RMICheck(warm.valid && warm.hits == cold.misses && warm.misses == 0,
+             "valid %d hits %u misses %u", warm.valid, warm.hits, warm.misses);
+    RMICheck(warm.reads < cold.reads, "%llu reads cached, %llu uncached", warm.reads, cold.reads);
+
+    RMICheck(runBus(argv[1], store, other, "TM0000-000"), "start on another device failed");
+    RMICheck(!other.valid && other.hits == 0 && other.misses == cold.misses,
+             "valid %d hits %u misses %u", other.valid, other.hits, other.misses);
+
+    unlink(blobPath.c_str());
+    rmdir(directory);
+    return RMITestResult();
+}
@@ -0,0 +1,225 @@
+/* SPDX-License-Identifier: GPL-2.0-only
+ * F12 register descriptor parsing
+ *
+ * Copyright (c) 2023 Avery Black
+ */
+
+#include <errno.h>
+#include <stdlib.h>
+#include <sys/mman.h>
+#include <unistd.h>
+#include <vector>
+#include "F12.hpp"
+#include "RMIBus.hpp"
+#include "RMISimTransport.hpp"
+#include "RMITest.h"
+
+/*
+ * Hand built descriptors for each register size encoding: one byte,
+ * 0 then two bytes, and 0, 0, 0 then four bytes. Each is checked for
+ * reg_size, byte_offset, reg_index and packet_size, then cut short at
+ * every length to check the parse fails instead of reading past it.
+ * Last, the bus must refuse a device whose F12 data descriptor is
+ * truncated rather than start a trackpad without Data1.
+ */
+
+struct Descriptor {
+    rmi_register_descriptor rdesc;
+    rmi_register_desc_item items[RMI_REG_DESC_PRESENSE_BITS];
+};
+
+// The presence register holds the structure size, so it is built here.
+// A size of 0 can only be written in the long form
+static int parse(Descriptor &desc, const std::vector<UInt8> &presenceBits,
+                 const std::vector<UInt8> &structure, bool longSize = false) {
+    UInt8 presence[35] {};
+    UInt8 size = 0;
+
+    if (longSize || structure.empty() || structure.size() > 0xff) {
+        presence[size++] = 0;
+        presence[size++] = structure.size() & 0xff;
+        presence[size++] = structure.size() >> 8;
+    } else {
+        presence[size++] = (UInt8) structure.size();
+    }
+
+    for (UInt8 bits : presenceBits)
+        presence[size++] = bits;
+
+    memset(&desc, 0, sizeof(desc));
+    F12::rmi_parse_register_presence(&desc.rdesc, presence, size);
+    desc.rdesc.registers = desc.items;
+
+    RMICheck(desc.rdesc.struct_size == structure.size(), "struct size %lu", desc.rdesc.struct_size);
+
+    // The structure ends right at a guard page, reading past it crashes
+    static UInt8 *guarded = nullptr;
+    static size_t pageSize = 0;
+    if (guarded == nullptr) {
+        pageSize = sysconf(_SC_PAGESIZE);
+        guarded = reinterpret_cast<UInt8 *>(mmap(nullptr, pageSize * 2, PROT_READ | PROT_WRITE,
+                                                 MAP_PRIVATE | MAP_ANONYMOUS, -1, 0));
+        if (guarded == MAP_FAILED || mprotect(guarded + pageSize, pageSize, PROT_NONE)) {
+            perror("guard page");
+            exit(1);
+        }
+    }
+
+    UInt8 *buf = guarded + pageSize - structure.size();
+    memcpy(buf, structure.data(), structure.size());
+    return F12::rmi_parse_register_struct(&desc.rdesc, buf);
+}
+
+static void checkItem(const Descriptor &desc, UInt16 reg, unsigned long size, size_t offset) {
+    UInt8 index = desc.rdesc.reg_index[reg];
+
+    RMICheck(index != 0, "reg %u missing", reg);
+    if (index == 0)
+        return;
+
+    const rmi_register_desc_item &item = desc.items[index - 1];
+    RMICheck(item.reg == reg, "reg %u at index %u is %u", reg, index - 1, item.reg);
+    RMICheck(item.reg_size == size, "reg %u size %lu, expected %lu", reg, item.reg_size, size);
+    RMICheck(item.byte_offset == offset, "reg %u offset %zu, expected %zu", reg, item.byte_offset, offset);
+}
+
+// Every shorter structure has to fail
+static void checkTruncated(const std::vector<UInt8> &presenceBits, const std::vector<UInt8> &structure) {
+    Descriptor desc;
+
+    for (size_t len = 0; len < structure.size(); len++) {
+        std::vector<UInt8> cut(structure.begin(), structure.begin() + len);
+        RMICheck(parse(desc, presenceBits, cut) == -EIO, "%zu of %zu bytes parsed", len, structure.size());
+    }
+}
+
+static void testOneByte() {
+    Descriptor desc;
+    // Registers 0, 1 and 3. Register 3 has subpackets 0 and 7 over two bytes
+    std::vector<UInt8> bits = {0x0b};
+    std::vector<UInt8> structure = {
+        10, 0x01,
+        1, 0x00,
+        8, 0x81, 0x01,
+    };
+
+    RMICheck(parse(desc, bits, structure) == 0, "one byte sizes");
+    RMICheck(desc.rdesc.num_registers == 3, "%u registers", desc.rdesc.num_registers);
+    checkItem(desc, 0, 10, 0);
+    checkItem(desc, 1, 1, 10);
+    checkItem(desc, 3, 8, 11);
+    RMICheck(desc.rdesc.reg_index[2] == 0, "reg 2 present");
+    RMICheck(desc.rdesc.packet_size == 19, "packet size %zu", desc.rdesc.packet_size);
+    RMICheck(desc.items[2].num_subpackets == 2, "%u subpackets", desc.items[2].num_subpackets);
+    checkTruncated(bits, structure);
+}
+
+static void testTwoByte() {
+    Descriptor desc;
+    std::vector<UInt8> bits = {0x03};
+    std::vector<UInt8> structure = {
+        0, 0x34, 0x12, 0x01,
+        0, 0x00, 0x01, 0x00,
+    };
+
+    RMICheck(parse(desc, bits, structure) == 0, "two byte sizes");
+    checkItem(desc, 0, 0x1234, 0);
+    checkItem(desc, 1, 0x100, 0x1234);
+    RMICheck(desc.rdesc.packet_size == 0x1334, "packet size %zu", desc.rdesc.packet_size);
+    checkTruncated(bits, structure);
+}
+
+static void testFourByte() {
+    Descriptor desc;
+    std::vector<UInt8> bits = {0x01};
+    std::vector<UInt8> structure = {
+        0, 0, 0, 0x78, 0x56, 0x34, 0x12, 0x00,
+    };
+
+    RMICheck(parse(desc, bits, structure) == 0, "four byte sizes");
+    checkItem(desc, 0, 0x12345678, 0);
+    RMICheck(desc.rdesc.packet_size == 0x12345678, "packet size %zu", desc.rdesc.packet_size);
+    checkTruncated(bits, structure);
+}
+
+// All three in one descriptor, past the first presence byte, with a long structure size
+static void testMixed() {
+    Descriptor desc;
+    // Registers 2, 9 and 15
+    std::vector<UInt8> bits = {0x04, 0x82};
+    std::vector<UInt8> structure = {
+        40, 0x00,
+        0, 0x02, 0x01, 0x00,
+        0, 0, 0, 0x00, 0x00, 0x01, 0x00, 0x00,
+    };
+
+    RMICheck(parse(desc, bits, structure, true) == 0, "mixed sizes");
+    RMICheck(desc.rdesc.num_registers == 3, "%u registers", desc.rdesc.num_registers);
+    checkItem(desc, 2, 40, 0);
+    checkItem(desc, 9, 0x102, 40);
+    checkItem(desc, 15, 0x10000, 40 + 0x102);
+    RMICheck(desc.rdesc.packet_size == 40 + 0x102 + 0x10000, "packet size %zu", desc.rdesc.packet_size);
+    checkTruncated(bits, structure);
+}
+
+// The largest presence register with a one byte size has 272 bits, only
+// the first 256 fit in the map. Writes past it land in num_registers and
+// the padding after it, which nothing else writes
+static void testFullPresence() {
+    rmi_register_descriptor rdesc;
+    UInt8 presence[35];
+    UInt8 *padding = reinterpret_cast<UInt8 *>(&rdesc.num_registers) + sizeof(rdesc.num_registers);
+    size_t paddingLen = reinterpret_cast<UInt8 *>(&rdesc.registers) - padding;
+
+    memset(&rdesc, 0, sizeof(rdesc));
+    memset(padding, 0xa5, paddingLen);
+    memset(presence, 0xff, sizeof(presence));
+    presence[0] = 8;
+
+    F12::rmi_parse_register_presence(&rdesc, presence, sizeof(presence));
+    RMICheck(rdesc.struct_size == 8, "struct size %lu", rdesc.struct_size);
+
+    for (size_t i = 0; i < paddingLen; i++)
+        RMICheck(padding[i] == 0xa5, "byte %zu after num_registers written", i);
+    for (size_t i = 0; i < BITS_TO_LONGS(RMI_REG_DESC_PRESENSE_BITS); i++)
+        RMICheck(rdesc.presense_map[i] == ~0UL, "presence map word %zu is %lx", i, rdesc.presense_map[i]);
+}
+
+// The profile's data descriptor has Data1, Data2 and Data15 in 6 bytes
+static void testTruncatedAttach(const char *profile) {
+    static const UInt8 presence[] = {0x05, 0x06, 0x80};
+    RMISimTransport *sim = OSTypeAlloc(RMISimTransport);
+    RMIBus *bus = OSTypeAlloc(RMIBus);
+    UInt16 addr;
+
+    RMICheck(sim != nullptr && sim->init() && sim->loadProfile(profile), "loading %s", profile);
+    RMICheck(sim->resolveAddress("F12.qry+8", addr), "no F12 data descriptor");
+    sim->setPacket(addr, presence, sizeof(presence));
+
+    RMICheck(bus != nullptr && bus->init(nullptr) && bus->attach(sim), "bus init");
+    if (bus->start(sim)) {
+        RMICheck(false, "started with a truncated F12 data descriptor");
+        sim->close(bus);
+        bus->terminate();
+    } else {
+        bus->detach(sim);
+    }
+
+    OSSafeReleaseNULL(bus);
+    OSSafeReleaseNULL(sim);
+}
+
+int main(int argc, char **argv) {
+    if (argc < 2) {
+        fprintf(stderr, "usage: %s <profile>\n", argv[0]);
+        return 1;
+    }
+
+    testOneByte();
+    testTwoByte();
+    testFourByte();
+    testMixed();
+    testFullPresence();
+    testTruncatedAttach(argv[1]);
+    return RMITestResult();
+}
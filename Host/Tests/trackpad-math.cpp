@@ -0,0 +1,68 @@
+/* SPDX-License-Identifier: GPL-2.0-only
+ * Trackpad integer math against the double math it replaced
+ *
+ * Copyright (c) 2023 Avery Black
+ */
+
+#include "RMITrackpadFunction.hpp"
+#include "RMITest.h"
+
+/*
+ * Every sensor size and percentage a configuration can hold. The double
+ * version multiplied by val / 100.0, which is rounded before the multiply,
+ * so it can come out one short of an exact multiple of 100. Those are the
+ * only differences accepted, and none happen with the default percentages.
+ */
+
+// Differences over sizes 0-65535 and percentages 0-100
+#define ACCEPTED_DIFFERENCES 3278
+
+static int doublePercentOf(UInt16 total, UInt8 val) {
+    return total * ((double) val / 100.0);
+}
+
+static bool isDefaultPercentage(UInt8 val) {
+    const RmiConfiguration conf {};
+
+    // Info.plist ships 10 and 60 instead of the built in 15 and 80
+    return val == 10 || val == 60 ||
+           val == conf.palmRejectionWidth ||
+           val == conf.palmRejectionHeight ||
+           val == conf.palmRejectionHeightTrackpoint;
+}
+
+static void testPercentOf() {
+    UInt32 differences = 0;
+
+    for (UInt32 val = 0; val <= UINT8_MAX; val++) {
+        for (UInt32 total = 0; total <= UINT16_MAX; total++) {
+            int expected = doublePercentOf(total, val);
+            int actual = cfgPercentOf((UInt16) total, (UInt8) val);
+
+            if (actual == expected)
+                continue;
+
+            RMICheck(actual == expected + 1 && (total * val) % 100 == 0,
+                     "%u%% of %u is %d, was %d", val, total, actual, expected);
+            RMICheck(!isDefaultPercentage(val), "default %u%% of %u changed", val, total);
+
+            if (val <= 100)
+                differences++;
+        }
+    }
+
+    RMICheck(differences == ACCEPTED_DIFFERENCES, "%u differences", differences);
+}
+
+static void testWidth() {
+    for (UInt32 z = 0; z <= UINT8_MAX; z++) {
+        UInt8 expected = z / 2.0;
+        RMICheck(zToWidth((UInt8) z) == expected, "z %u width %u, was %u", z, zToWidth((UInt8) z), expected);
+    }
+}
+
+int main() {
+    testPercentOf();
+    testWidth();
+    return RMITestResult();
+}
@@ -0,0 +1,30 @@
+/* SPDX-License-Identifier: GPL-2.0-only
+ * Host shim for IOCommandGate
+ */
+
+#ifndef SHIM_IOCommandGate_h
+#define SHIM_IOCommandGate_h
+#include <IOKit/IOWorkLoop.h>
+
+/*
+ * Host only: nothing else can run while a command sleeps on the host, so this
+ * is called in place of blocking. The harness delivers whatever interrupts
+ * would have woken the sleeper.
+ */
+extern void (*gHostCommandSleepHook)(void);
+
+class IOCommandGate : public IOEventSource {
+    OSDeclareDefaultStructors(IOCommandGate);
+public:
+    typedef IOReturn (*Action)(OSObject *owner, void *arg0, void *arg1, void *arg2, void *arg3);
+    static IOCommandGate *commandGate(OSObject *owner, Action action = nullptr);
+    virtual IOReturn runAction(Action action, void *arg0 = nullptr, void *arg1 = nullptr, void *arg2 = nullptr, void *arg3 = nullptr);
+    virtual IOReturn attemptAction(Action action, void *arg0 = nullptr, void *arg1 = nullptr, void *arg2 = nullptr, void *arg3 = nullptr);
+    virtual IOReturn commandSleep(void *event, UInt32 interruptible = THREAD_ABORTSAFE);
+    virtual IOReturn commandSleep(void *event, AbsoluteTime deadline, UInt32 interruptible);
+    virtual void commandWakeup(void *event, bool oneThread = false);
+private:
+    void *sleepEvent {nullptr};
+    bool woken {false};
+};
+#endif
@@ -0,0 +1,19 @@
+/* SPDX-License-Identifier: GPL-2.0-only
+ * Host shim for IOInterruptEventSource
+ */
+
+#ifndef SHIM_IOInterruptEventSource_h
+#define SHIM_IOInterruptEventSource_h
+#include <IOKit/IOWorkLoop.h>
+
+class IOInterruptEventSource;
+typedef void (*IOInterruptEventAction)(OSObject *owner, IOInterruptEventSource *sender, int count);
+
+class IOInterruptEventSource : public IOEventSource {
+    OSDeclareDefaultStructors(IOInterruptEventSource);
+public:
+    static IOInterruptEventSource *interruptEventSource(OSObject *owner, IOInterruptEventAction action, IOService *provider = nullptr, int intIndex = 0);
+    /* Host only: deliver one interrupt on the calling thread */
+    void interruptOccurred(void *, IOService *, int);
+};
+#endif
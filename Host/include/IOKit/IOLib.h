@@ -0,0 +1,126 @@
+/* SPDX-License-Identifier: GPL-2.0-only
+ * Host shim for IOLib, clocks and locks
+ */
+
+#ifndef SHIM_IOLib_h
+#define SHIM_IOLib_h
+// Lets shared code hook into checks only the host can do
+#define RMI_HOST_SHIM 1
+#include <stdint.h>
+#include <stddef.h>
+#include <string.h>
+#include <strings.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdarg.h>
+#include <unistd.h>
+#include <time.h>
+#include <mutex>
+
+typedef uint8_t UInt8; typedef uint16_t UInt16; typedef uint32_t UInt32; typedef uint64_t UInt64;
+typedef int8_t SInt8; typedef int16_t SInt16; typedef int32_t SInt32; typedef int64_t SInt64;
+typedef int IOReturn; typedef int kern_return_t;
+typedef UInt64 AbsoluteTime;
+typedef uint32_t IOOptionBits;
+typedef unsigned long IOPMPowerFlags;
+typedef uint32_t IOItemCount;
+
+#define APPLE_KEXT_OVERRIDE override
+#define __ACIDANTHERA_MAC_SDK 1
+
+#define sys_iokit                 (((0x38) & 0x3f) << 26)
+#define sub_iokit_common          0
+#define sub_iokit_vendor_specific (((-2) & 0xfff) << 14)
+#define iokit_common_msg(message)          ((UInt32)(sys_iokit|sub_iokit_common|(message)))
+#define iokit_vendor_specific_msg(message) ((UInt32)(sys_iokit|sub_iokit_vendor_specific|(message)))
+#define iokit_common_err(return)  (sys_iokit|sub_iokit_common|(return))
+
+#define kIOReturnSuccess 0
+#define kIOReturnError           iokit_common_err(0x2bc)
+#define kIOReturnNoMemory        iokit_common_err(0x2bd)
+#define kIOReturnNoResources     iokit_common_err(0x2be)
+#define kIOReturnNoDevice        iokit_common_err(0x2c0)
+#define kIOReturnBadArgument     iokit_common_err(0x2c2)
+#define kIOReturnUnsupported     iokit_common_err(0x2c7)
+#define kIOReturnIOError         iokit_common_err(0x2ca)
+#define kIOReturnNotOpen         iokit_common_err(0x2cd)
+#define kIOReturnBusy            iokit_common_err(0x2d5)
+#define kIOReturnTimeout         iokit_common_err(0x2d6)
+#define kIOReturnNotReady        iokit_common_err(0x2d8)
+#define kIOReturnNoInterrupt     iokit_common_err(0x2df)
+#define kIOReturnUnderrun        iokit_common_err(0x2e7)
+#define kIOReturnNoSpace         iokit_common_err(0x2db)
+#define kIOReturnOverrun         iokit_common_err(0x2e8)
+#define kIOReturnAborted         iokit_common_err(0x2eb)
+#define kIOReturnNotFound        iokit_common_err(0x2f0)
+#define kIOReturnInvalid         iokit_common_err(0x1)
+
+#define THREAD_AWAKENED 0
+#define THREAD_TIMED_OUT 1
+#define THREAD_INTERRUPTED 2
+#define THREAD_UNINT 0
+#define THREAD_ABORTSAFE 1
+
+#define NSEC_PER_USEC 1000ull
+#define NSEC_PER_MSEC 1000000ull
+#define NSEC_PER_SEC 1000000000ull
+#define kMillisecondScale 1000000
+#define kSecondScale 1000000000
+#define kMicrosecondScale 1000
+
+static inline void IOLog(const char *fmt, ...) __attribute__((format(printf, 1, 2)));
+static inline void IOLog(const char *fmt, ...) {
+    if (getenv("RMI_HOST_QUIET")) return;
+    va_list ap; va_start(ap, fmt); vfprintf(stderr, fmt, ap); va_end(ap);
+}
+static inline void IOSleep(unsigned) {}
+static inline void IODelay(unsigned) {}
+[[noreturn]] static inline void panic(const char *fmt, ...) {
+    va_list ap; va_start(ap, fmt); vfprintf(stderr, fmt, ap); va_end(ap); fputc('\n', stderr); abort();
+}
+
+/* Raised by RMIAllocGuard in DEBUG builds, allocating while it's set aborts */
+extern thread_local unsigned gHostNoAllocDepth;
+static inline void hostCheckAllocation() {
+    if (gHostNoAllocDepth) panic("VRMI - Allocation inside an RMIAllocGuard section");
+}
+static inline void *IOMalloc(size_t size) { hostCheckAllocation(); return calloc(1, size ? size : 1); }
+static inline void *IOMallocZero(size_t size) { hostCheckAllocation(); return calloc(1, size ? size : 1); }
+static inline void IOFree(void *p, size_t) { free(p); }
+
+typedef std::recursive_mutex IOLock;
+static inline IOLock *IOLockAlloc() { return new std::recursive_mutex; }
+static inline void IOLockFree(IOLock *l) { delete l; }
+static inline void IOLockLock(IOLock *l) { l->lock(); }
+static inline void IOLockUnlock(IOLock *l) { l->unlock(); }
+static inline bool IOLockTryLock(IOLock *l) { return l->try_lock(); }
+typedef IOLock IOSimpleLock;
+static inline IOSimpleLock *IOSimpleLockAlloc() { return new std::recursive_mutex; }
+static inline void IOSimpleLockFree(IOSimpleLock *l) { delete l; }
+static inline void IOSimpleLockLock(IOSimpleLock *l) { l->lock(); }
+static inline void IOSimpleLockUnlock(IOSimpleLock *l) { l->unlock(); }
+
+/* Host clock: overridable by the host harness for deterministic runs */
+extern uint64_t (*gHostUptimeHook)(void);
+static inline uint64_t hostMonotonicNs() {
+    if (gHostUptimeHook) return gHostUptimeHook();
+    struct timespec ts; clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t) ts.tv_sec * NSEC_PER_SEC + ts.tv_nsec;
+}
+static inline void clock_get_uptime(uint64_t *result) { *result = hostMonotonicNs(); }
+static inline UInt64 mach_absolute_time() { return hostMonotonicNs(); }
+static inline void absolutetime_to_nanoseconds(UInt64 abstime, uint64_t *result) { *result = abstime; }
+static inline void nanoseconds_to_absolutetime(UInt64 ns, uint64_t *result) { *result = ns; }
+static inline void clock_interval_to_absolutetime_interval(uint32_t interval, uint32_t scale, UInt64 *result) { *result = (UInt64) interval * scale; }
+
+#define OSSwapLittleToHostInt16(x) ((uint16_t)(x))
+#define OSSwapLittleToHostInt32(x) ((uint32_t)(x))
+#define OSSwapLittleToHostInt64(x) ((uint64_t)(x))
+#define OSSwapHostToLittleInt16(x) ((uint16_t)(x))
+#define OSSwapHostToLittleInt32(x) ((uint32_t)(x))
+
+static inline int min(int a, int b) { return a < b ? a : b; }
+static inline int max(int a, int b) { return a > b ? a : b; }
+
+#include <libkern/OSAtomic.h>
+#endif
@@ -0,0 +1 @@
+#include <IOKit/IOService.h>
@@ -0,0 +1,95 @@
+/* SPDX-License-Identifier: GPL-2.0-only
+ * Host shim for IORegistryEntry and IOService
+ */
+
+#ifndef SHIM_IOService_h
+#define SHIM_IOService_h
+#include <IOKit/IOLib.h>
+#include <libkern/c++/OSContainers.h>
+
+class IOService;
+class IOWorkLoop;
+
+struct IOPMPowerState {
+    unsigned long version, capabilityFlags, outputPowerCharacter, inputPowerRequirement;
+    unsigned long staticPower, unbudgetedPower, powerToAttain, timeToAttain;
+    unsigned long settleUpTime, timeToLower, settleDownTime, powerDomainBudget;
+};
+#define kIOPMPowerOn        0x00000002
+#define kIOPMDeviceUsable   0x00008000
+#define kIOPMAckImplied     0
+#define kIOPMNoSuchState    0xffffffff
+#define kIOServiceAsynchronous 0x00000008
+#define kIOMessageServiceIsTerminated iokit_common_msg(0x010)
+
+struct IORegistryPlane;
+extern const IORegistryPlane *gIOServicePlane;
+extern const IORegistryPlane *gIODTPlane;
+
+class IORegistryEntry : public OSObject {
+    OSDeclareDefaultStructors(IORegistryEntry);
+public:
+    virtual bool init(OSDictionary *dict = nullptr);
+    void free() override;
+    virtual bool setProperty(const char *key, OSObject *obj);
+    bool setProperty(const char *key, const char *str);
+    bool setProperty(const char *key, bool b);
+    bool setProperty(const char *key, unsigned long long n, unsigned int bits);
+    bool setProperty(const char *key, void *bytes, unsigned int length);
+    virtual OSObject *getProperty(const char *key) const;
+    virtual void removeProperty(const char *key);
+    OSDictionary *dictionaryWithProperties() const;
+    virtual IORegistryEntry *getParentEntry(const IORegistryPlane *plane) const;
+    virtual const char *getName(const IORegistryPlane *plane = nullptr) const;
+    // Only "/options" exists on the host, standing in for NVRAM
+    static IORegistryEntry *fromPath(const char *path, const IORegistryPlane *plane = nullptr);
+protected:
+    OSDictionary *properties {nullptr};
+    IORegistryEntry *parent {nullptr};
+    mutable std::recursive_mutex propertyLock;
+};
+
+class IOService : public IORegistryEntry {
+    OSDeclareDefaultStructors(IOService);
+public:
+    bool init(OSDictionary *dict = nullptr) override;
+    void free() override;
+    virtual IOService *probe(IOService *provider, SInt32 *score) { return this; }
+    virtual bool start(IOService *provider) { return true; }
+    virtual void stop(IOService *provider) {}
+    virtual bool attach(IOService *provider);
+    virtual void detach(IOService *provider);
+    virtual bool terminate(IOOptionBits options = 0);
+    virtual bool willTerminate(IOService *provider, IOOptionBits options) { return true; }
+    virtual bool open(IOService *forClient, IOOptionBits options = 0, void *arg = nullptr);
+    virtual void close(IOService *forClient, IOOptionBits options = 0);
+    virtual bool isOpen(const IOService *forClient = nullptr) const;
+    virtual bool handleOpen(IOService *forClient, IOOptionBits options, void *arg);
+    virtual void handleClose(IOService *forClient, IOOptionBits options);
+    virtual bool handleIsOpen(const IOService *forClient) const;
+    virtual IOReturn message(UInt32 type, IOService *provider, void *argument = 0) { return kIOReturnUnsupported; }
+    virtual IOReturn messageClient(UInt32 type, OSObject *client, void *argument = nullptr, size_t argSize = 0);
+    virtual IOReturn messageClients(UInt32 type, void *argument = nullptr, size_t argSize = 0);
+    virtual IOReturn setProperties(OSObject *properties) { return kIOReturnUnsupported; }
+    virtual OSIterator *getClientIterator() const;
+    virtual IOService *getProvider() const { return provider; }
+    virtual IOWorkLoop *getWorkLoop() const;
+    virtual void registerService(IOOptionBits options = 0) {}
+    virtual void PMinit() {}
+    virtual void PMstop() {}
+    virtual void joinPMtree(IOService *driver) {}
+    virtual IOReturn registerPowerDriver(IOService *controllingDriver, IOPMPowerState *powerStates, unsigned long numberOfStates) { return kIOReturnSuccess; }
+    virtual IOPMPowerFlags registerInterestedDriver(IOService *theDriver) { return 0; }
+    virtual IOReturn setPowerState(unsigned long powerStateOrdinal, IOService *whatDevice) { return kIOPMAckImplied; }
+    virtual IOReturn powerStateDidChangeTo(IOPMPowerFlags capabilities, unsigned long stateNumber, IOService *whatDevice) { return kIOPMAckImplied; }
+    const char *getName(const IORegistryPlane *plane = nullptr) const override;
+    virtual const char *stringFromReturn(IOReturn rtn);
+protected:
+    IOService *provider {nullptr};
+    OSArray *clients {nullptr};
+    OSSet *openClients {nullptr};
+    mutable IOWorkLoop *ownWorkLoop {nullptr};
+};
+
+#include <IOKit/IOWorkLoop.h>
+#endif
@@ -0,0 +1,30 @@
+/* SPDX-License-Identifier: GPL-2.0-only
+ * Host shim for IOTimerEventSource
+ */
+
+#ifndef SHIM_IOTimerEventSource_h
+#define SHIM_IOTimerEventSource_h
+#include <IOKit/IOWorkLoop.h>
+
+class IOTimerEventSource : public IOEventSource {
+    OSDeclareDefaultStructors(IOTimerEventSource);
+public:
+    typedef void (*Action)(OSObject *owner, IOTimerEventSource *sender);
+    static IOTimerEventSource *timerEventSource(OSObject *owner, Action action = nullptr);
+    void free() override;
+    virtual IOReturn setTimeoutMS(UInt32 ms);
+    virtual IOReturn setTimeoutUS(UInt32 us);
+    virtual IOReturn setTimeout(UInt32 interval, UInt32 scaleFactor = kMillisecondScale);
+    virtual IOReturn wakeAtTime(AbsoluteTime abstime);
+    virtual void cancelTimeout();
+    bool isArmed() const { return armed; }
+    AbsoluteTime getDeadline() const { return deadline; }
+
+    /* Host only: fire every armed, enabled timer whose deadline is <= now, earliest first */
+    static bool runExpired(AbsoluteTime now);
+    static bool nextDeadline(AbsoluteTime *deadline);
+private:
+    bool armed {false};
+    AbsoluteTime deadline {0};
+};
+#endif
@@ -0,0 +1,48 @@
+/* SPDX-License-Identifier: GPL-2.0-only
+ * Host shim for IOWorkLoop and IOEventSource
+ */
+
+#ifndef SHIM_IOWorkLoop_h
+#define SHIM_IOWorkLoop_h
+#include <IOKit/IOLib.h>
+#include <libkern/c++/OSContainers.h>
+
+class IOWorkLoop;
+class IOService;
+
+class IOEventSource : public OSObject {
+    OSDeclareDefaultStructors(IOEventSource);
+public:
+    typedef void (*Action)(OSObject *owner, ...);
+    virtual bool init(OSObject *owner, Action action = nullptr);
+    virtual void enable() { enabled = true; }
+    virtual void disable() { enabled = false; }
+    virtual bool isEnabled() const { return enabled; }
+    virtual void setWorkLoop(IOWorkLoop *wl) { workLoop = wl; }
+    virtual IOWorkLoop *getWorkLoop() const { return workLoop; }
+    OSObject *getOwner() const { return owner; }
+protected:
+    OSObject *owner {nullptr};
+    Action action {nullptr};
+    bool enabled {true};
+    IOWorkLoop *workLoop {nullptr};
+};
+
+class IOWorkLoop : public OSObject {
+    OSDeclareDefaultStructors(IOWorkLoop);
+public:
+    static IOWorkLoop *workLoop();
+    bool init() override;
+    void free() override;
+    virtual IOReturn addEventSource(IOEventSource *src);
+    virtual IOReturn removeEventSource(IOEventSource *src);
+    /* Host only: serialises "work loop context" like the kernel gate does */
+    std::recursive_mutex gateLock;
+private:
+    OSArray *sources {nullptr};
+};
+
+#include <IOKit/IOCommandGate.h>
+#include <IOKit/IOTimerEventSource.h>
+#include <IOKit/IOInterruptEventSource.h>
+#endif
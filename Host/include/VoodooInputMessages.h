@@ -0,0 +1 @@
+#include "VoodooInputMultitouch/VoodooInputMessages.h"
@@ -0,0 +1,57 @@
+/* SPDX-License-Identifier: GPL-2.0-only
+ * Subset of the VoodooInput message definitions used by the host build
+ */
+
+#ifndef SHIM_VoodooInputMessages_h
+#define SHIM_VoodooInputMessages_h
+#include <IOKit/IOLib.h>
+#include "VoodooInputTransducer.h"
+
+#define VOODOO_INPUT_MAX_TRANSDUCERS 10
+#define kIOMessageVoodooInputMessage 12345
+#define kIOMessageVoodooInputUpdateDimensionsMessage 12346
+#define kIOMessageVoodooInputUpdatePropertiesNotification 12347
+#define kIOMessageVoodooTrackpointMessage 12348
+#define kIOMessageVoodooTrackpointRelativePointer 12349
+#define kIOMessageVoodooTrackpointScrollWheel 12350
+#define kIOMessageVoodooTrackpointUpdatePropertiesNotification 12351
+
+#define VOODOO_INPUT_LOGICAL_MAX_X_KEY "Logical Max X"
+#define VOODOO_INPUT_LOGICAL_MAX_Y_KEY "Logical Max Y"
+#define VOODOO_INPUT_PHYSICAL_MAX_X_KEY "Physical Max X"
+#define VOODOO_INPUT_PHYSICAL_MAX_Y_KEY "Physical Max Y"
+#define VOODOO_INPUT_TRANSFORM_KEY "IOFBTransform"
+#define VOODOO_INPUT_IDENTIFIER "VoodooInput Instance"
+
+#define VOODOO_TRACKPOINT_KEY "Trackpoint"
+#define VOODOO_TRACKPOINT_DEADZONE "Deadzone"
+#define VOODOO_TRACKPOINT_BTN_CNT "Button Count"
+#define VOODOO_TRACKPOINT_MOUSE_MULT_X "Mouse Multiplier X"
+#define VOODOO_TRACKPOINT_MOUSE_MULT_Y "Mouse Multiplier Y"
+#define VOODOO_TRACKPOINT_MOUSE_DIV_X "Mouse Divisor X"
+#define VOODOO_TRACKPOINT_MOUSE_DIV_Y "Mouse Divisor Y"
+#define VOODOO_TRACKPOINT_SCROLL_MULT_X "Scroll Multiplier X"
+#define VOODOO_TRACKPOINT_SCROLL_MULT_Y "Scroll Multiplier Y"
+#define VOODOO_TRACKPOINT_SCROLL_DIV_X "Scroll Divisor X"
+#define VOODOO_TRACKPOINT_SCROLL_DIV_Y "Scroll Divisor Y"
+
+struct VoodooInputEvent {
+    UInt8 contact_count;
+    AbsoluteTime timestamp;
+    VoodooInputTransducer transducers[VOODOO_INPUT_MAX_TRANSDUCERS];
+};
+
+struct TrackpointReport {
+    AbsoluteTime timestamp;
+    UInt32 buttons;
+    SInt32 dx;
+    SInt32 dy;
+};
+
+struct RelativePointerEvent {
+    AbsoluteTime timestamp;
+    UInt32 buttons;
+    SInt32 dx;
+    SInt32 dy;
+};
+#endif
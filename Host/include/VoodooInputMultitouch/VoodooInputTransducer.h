@@ -0,0 +1,42 @@
+/* SPDX-License-Identifier: GPL-2.0-only
+ * Subset of the VoodooInput transducer definitions used by the host build
+ */
+
+#ifndef SHIM_VoodooInputTransducer_h
+#define SHIM_VoodooInputTransducer_h
+#include <IOKit/IOLib.h>
+
+enum VoodooInputTransducerType { STYLUS, FINGER };
+
+enum MT2FingerType {
+    kMT2FingerTypeUndefined = 0,
+    kMT2FingerTypeThumb,
+    kMT2FingerTypeIndexFinger,
+    kMT2FingerTypeMiddleFinger,
+    kMT2FingerTypeRingFinger,
+    kMT2FingerTypeLittleFinger,
+    kMT2FingerTypePalm,
+    kMT2FingerTypeCount
+};
+
+struct TouchCoordinates {
+    UInt32 x;
+    UInt32 y;
+    UInt8 pressure;
+    UInt8 width;
+};
+
+struct VoodooInputTransducer {
+    AbsoluteTime timestamp;
+    UInt32 secondaryId;
+    VoodooInputTransducerType type;
+    MT2FingerType fingerType;
+    bool isValid;
+    bool isPhysicalButtonDown;
+    bool isTransducerActive;
+    bool supportsPressure;
+    TouchCoordinates currentCoordinates;
+    TouchCoordinates previousCoordinates;
+    UInt32 maxPressure;
+};
+#endif
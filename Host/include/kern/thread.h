@@ -0,0 +1,16 @@
+/* SPDX-License-Identifier: GPL-2.0-only
+ * Host shim for kern/thread.h
+ */
+
+#ifndef SHIM_kern_thread_h
+#define SHIM_kern_thread_h
+
+typedef struct thread *thread_t;
+
+// Unique per host thread, only ever compared
+static inline thread_t current_thread() {
+    static thread_local char self;
+    return reinterpret_cast<thread_t>(&self);
+}
+
+#endif
@@ -0,0 +1,17 @@
+/* SPDX-License-Identifier: GPL-2.0-only
+ * Host shim for libkern atomics
+ */
+
+#ifndef SHIM_OSAtomic_h
+#define SHIM_OSAtomic_h
+#include <stdint.h>
+static inline SInt32 OSIncrementAtomic(volatile SInt32 *a) { return __atomic_fetch_add(a, 1, __ATOMIC_SEQ_CST); }
+static inline SInt32 OSDecrementAtomic(volatile SInt32 *a) { return __atomic_fetch_sub(a, 1, __ATOMIC_SEQ_CST); }
+static inline SInt32 OSAddAtomic(SInt32 amt, volatile SInt32 *a) { return __atomic_fetch_add(a, amt, __ATOMIC_SEQ_CST); }
+static inline SInt64 OSAddAtomic64(SInt64 amt, volatile SInt64 *a) { return __atomic_fetch_add(a, amt, __ATOMIC_SEQ_CST); }
+static inline SInt64 OSIncrementAtomic64(volatile SInt64 *a) { return __atomic_fetch_add(a, 1, __ATOMIC_SEQ_CST); }
+static inline bool OSCompareAndSwap(UInt32 o, UInt32 n, volatile UInt32 *a) { return __atomic_compare_exchange_n(a, &o, n, false, __ATOMIC_SEQ_CST, __ATOMIC_SEQ_CST); }
+static inline bool OSCompareAndSwap64(UInt64 o, UInt64 n, volatile UInt64 *a) { return __atomic_compare_exchange_n(a, &o, n, false, __ATOMIC_SEQ_CST, __ATOMIC_SEQ_CST); }
+static inline bool OSCompareAndSwapPtr(void *o, void *n, void * volatile *a) { return __atomic_compare_exchange_n(a, &o, n, false, __ATOMIC_SEQ_CST, __ATOMIC_SEQ_CST); }
+static inline void OSMemoryBarrier() { __atomic_thread_fence(__ATOMIC_SEQ_CST); }
+#endif
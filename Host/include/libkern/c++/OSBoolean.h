@@ -0,0 +1 @@
+#include <libkern/c++/OSContainers.h>
@@ -0,0 +1,276 @@
+/* SPDX-License-Identifier: GPL-2.0-only
+ * Host shim for OSObject and the libkern containers
+ */
+
+#ifndef SHIM_OSContainers_h
+#define SHIM_OSContainers_h
+#include <IOKit/IOLib.h>
+#include <vector>
+#include <string>
+#include <utility>
+#include <typeinfo>
+
+class OSMetaClassBase {
+public:
+    virtual ~OSMetaClassBase() {}
+    typedef void (*_ptf_t)(void);
+    static _ptf_t _ptmf2ptf(const OSMetaClassBase *self, void (OSMetaClassBase::*func)(void)) {
+        union { void (OSMetaClassBase::*fIn)(void); struct { uintptr_t ptr; ptrdiff_t adj; } pmf; } map;
+        map.fIn = func;
+        if (map.pmf.ptr & 1) {
+            const char *obj = reinterpret_cast<const char *>(self) + map.pmf.adj;
+            const char *vtbl = *reinterpret_cast<const char * const *>(obj);
+            return *reinterpret_cast<const _ptf_t *>(vtbl + map.pmf.ptr - 1);
+        }
+        return reinterpret_cast<_ptf_t>(map.pmf.ptr);
+    }
+};
+
+#define OSMemberFunctionCast(cptrtype, self, func) \
+    (cptrtype) OSMetaClassBase::_ptmf2ptf(self, (void (OSMetaClassBase::*)(void)) func)
+
+class OSObject : public OSMetaClassBase {
+public:
+    static void *operator new(size_t size) { hostCheckAllocation(); return calloc(1, size); }
+    static void operator delete(void *p) { ::free(p); }
+    OSObject() {}
+    virtual ~OSObject() {}
+    virtual bool init() { return true; }
+    virtual void free() { delete this; }
+    virtual void retain() const { __atomic_add_fetch(&refCount, 1, __ATOMIC_SEQ_CST); }
+    virtual void release() const {
+        if (__atomic_sub_fetch(&refCount, 1, __ATOMIC_SEQ_CST) == 0)
+            const_cast<OSObject *>(this)->free();
+    }
+    virtual int getRetainCount() const { return refCount; }
+    virtual const char *getClassName() const { return "OSObject"; }
+    virtual bool isEqualTo(const OSObject *other) const { return this == other; }
+private:
+    mutable int refCount {1};
+};
+
+#define OSDeclareDefaultStructors(className, ...) \
+    public: \
+    className(); \
+    virtual const char *getClassName() const; \
+    protected: \
+    virtual ~className();
+
+#define OSDeclareAbstractStructors OSDeclareDefaultStructors
+
+#define OSDefineMetaClassAndStructors(className, superclassName) \
+    className::className() : superclassName() {} \
+    className::~className() {} \
+    const char *className::getClassName() const { return #className; }
+#define OSDefineMetaClassAndAbstractStructors OSDefineMetaClassAndStructors
+
+template <class T, class U>
+static inline T *__OSDynamicCast(U *obj) {
+    return dynamic_cast<T *>(const_cast<OSMetaClassBase *>(static_cast<const OSMetaClassBase *>(obj)));
+}
+#define OSDynamicCast(type, inst) __OSDynamicCast<type>(inst)
+#define OSRequiredCast(type, inst) __OSDynamicCast<type>(inst)
+#define OSTypeAlloc(type) (new type)
+#define OSSafeReleaseNULL(inst) do { if (inst) (inst)->release(); (inst) = nullptr; } while (0)
+#define OSSafeRelease(inst) do { if (inst) (inst)->release(); } while (0)
+
+class OSNumber : public OSObject {
+public:
+    static OSNumber *withNumber(unsigned long long v, unsigned int bits) {
+        OSNumber *n = new OSNumber; n->value = v; n->bits = bits;
+        if (bits < 64) n->value &= ((1ull << bits) - 1);
+        return n;
+    }
+    unsigned long long unsigned64BitValue() const { return value; }
+    unsigned int unsigned32BitValue() const { return (unsigned int) value; }
+    unsigned short unsigned16BitValue() const { return (unsigned short) value; }
+    unsigned char unsigned8BitValue() const { return (unsigned char) value; }
+    unsigned int numberOfBits() const { return bits; }
+    void setValue(unsigned long long v) { value = v; }
+    const char *getClassName() const override { return "OSNumber"; }
+    bool isEqualTo(const OSObject *o) const override {
+        const OSNumber *n = OSDynamicCast(const OSNumber, o); return n && n->value == value;
+    }
+private:
+    unsigned long long value {0};
+    unsigned int bits {64};
+};
+
+class OSBoolean : public OSObject {
+public:
+    explicit OSBoolean(bool v) : value(v) {}
+    bool getValue() const { return value; }
+    bool isTrue() const { return value; }
+    bool isFalse() const { return !value; }
+    static OSBoolean *withBoolean(bool v);
+    void release() const override {}
+    void retain() const override {}
+    const char *getClassName() const override { return "OSBoolean"; }
+private:
+    bool value;
+};
+extern OSBoolean *const kOSBooleanTrue;
+extern OSBoolean *const kOSBooleanFalse;
+inline OSBoolean *OSBoolean::withBoolean(bool v) { return v ? kOSBooleanTrue : kOSBooleanFalse; }
+
+class OSString : public OSObject {
+public:
+    static OSString *withCString(const char *s) { OSString *o = new OSString; o->str = s ? s : ""; return o; }
+    static OSString *withCStringNoCopy(const char *s) { return withCString(s); }
+    const char *getCStringNoCopy() const { return str.c_str(); }
+    unsigned int getLength() const { return (unsigned int) str.size(); }
+    bool isEqualTo(const char *s) const { return s && str == s; }
+    bool isEqualTo(const OSObject *o) const override {
+        const OSString *s = OSDynamicCast(const OSString, o); return s && s->str == str;
+    }
+    const char *getClassName() const override { return "OSString"; }
+protected:
+    std::string str;
+};
+
+class OSSymbol : public OSString {
+public:
+    static const OSSymbol *withCString(const char *s) { OSSymbol *o = new OSSymbol; o->str = s ? s : ""; return o; }
+    static const OSSymbol *withCStringNoCopy(const char *s) { return withCString(s); }
+    const char *getClassName() const override { return "OSSymbol"; }
+};
+
+class OSData : public OSObject {
+public:
+    static OSData *withBytes(const void *bytes, unsigned int len) {
+        OSData *d = new OSData; d->appendBytes(bytes, len); return d;
+    }
+    static OSData *withCapacity(unsigned int cap) { OSData *d = new OSData; d->bytes.reserve(cap); return d; }
+    bool appendBytes(const void *b, unsigned int len) {
+        if (b) bytes.insert(bytes.end(), (const UInt8 *) b, (const UInt8 *) b + len);
+        else bytes.insert(bytes.end(), len, 0);
+        return true;
+    }
+    const void *getBytesNoCopy() const { return bytes.empty() ? nullptr : bytes.data(); }
+    const void *getBytesNoCopy(unsigned int start, unsigned int len) const {
+        if (start + len > bytes.size()) return nullptr;
+        return bytes.data() + start;
+    }
+    unsigned int getLength() const { return (unsigned int) bytes.size(); }
+    bool isEqualTo(const OSObject *o) const override {
+        const OSData *d = OSDynamicCast(const OSData, o); return d && d->bytes == bytes;
+    }
+    const char *getClassName() const override { return "OSData"; }
+private:
+    std::vector<UInt8> bytes;
+};
+
+class OSIterator : public OSObject {
+public:
+    virtual OSObject *getNextObject() = 0;
+    virtual void reset() = 0;
+    virtual bool isValid() { return true; }
+};
+
+class OSCollection : public OSObject {
+public:
+    virtual unsigned int getCount() const = 0;
+    virtual OSObject *getAnyObjectAt(unsigned int i) const = 0;
+    virtual void flushCollection() = 0;
+};
+
+class OSArray : public OSCollection {
+public:
+    static OSArray *withCapacity(unsigned int cap) { OSArray *a = new OSArray; a->items.reserve(cap); return a; }
+    ~OSArray() override { flushCollection(); }
+    bool setObject(const OSObject *o) { if (!o) return false; o->retain(); items.push_back(const_cast<OSObject *>(o)); return true; }
+    OSObject *getObject(unsigned int i) const { return i < items.size() ? items[i] : nullptr; }
+    void removeObject(unsigned int i) { if (i < items.size()) { items[i]->release(); items.erase(items.begin() + i); } }
+    unsigned int getCount() const override { return (unsigned int) items.size(); }
+    OSObject *getAnyObjectAt(unsigned int i) const override { return getObject(i); }
+    void flushCollection() override { for (auto *o : items) o->release(); items.clear(); }
+    const char *getClassName() const override { return "OSArray"; }
+private:
+    std::vector<OSObject *> items;
+};
+
+class OSSet : public OSCollection {
+public:
+    static OSSet *withCapacity(unsigned int cap) { OSSet *s = new OSSet; s->items.reserve(cap); return s; }
+    ~OSSet() override { flushCollection(); }
+    bool setObject(const OSObject *o) {
+        if (!o || containsObject(o)) return false;
+        o->retain(); items.push_back(const_cast<OSObject *>(o)); return true;
+    }
+    bool containsObject(const OSObject *o) const { for (auto *i : items) if (i == o) return true; return false; }
+    void removeObject(const OSObject *o) {
+        for (size_t i = 0; i < items.size(); i++) if (items[i] == o) { items[i]->release(); items.erase(items.begin() + i); return; }
+    }
+    unsigned int getCount() const override { return (unsigned int) items.size(); }
+    OSObject *getAnyObjectAt(unsigned int i) const override { return i < items.size() ? items[i] : nullptr; }
+    OSObject *getAnyObject() const { return getAnyObjectAt(0); }
+    void flushCollection() override { for (auto *o : items) o->release(); items.clear(); }
+    const char *getClassName() const override { return "OSSet"; }
+private:
+    std::vector<OSObject *> items;
+};
+
+class OSDictionary : public OSCollection {
+public:
+    static OSDictionary *withCapacity(unsigned int cap) { OSDictionary *d = new OSDictionary; d->items.reserve(cap); return d; }
+    static OSDictionary *withDictionary(const OSDictionary *src, unsigned int = 0) {
+        OSDictionary *d = new OSDictionary; if (src) d->merge(src); return d;
+    }
+    ~OSDictionary() override { flushCollection(); }
+    bool setObject(const char *key, const OSObject *o) {
+        if (!key || !o) return false;
+        o->retain();
+        for (auto &kv : items) if (kv.first == key) { kv.second->release(); kv.second = const_cast<OSObject *>(o); return true; }
+        items.emplace_back(key, const_cast<OSObject *>(o));
+        return true;
+    }
+    bool setObject(const OSString *key, const OSObject *o) { return key && setObject(key->getCStringNoCopy(), o); }
+    OSObject *getObject(const char *key) const { for (auto &kv : items) if (kv.first == key) return kv.second; return nullptr; }
+    OSObject *getObject(const OSString *key) const { return key ? getObject(key->getCStringNoCopy()) : nullptr; }
+    void removeObject(const char *key) {
+        for (size_t i = 0; i < items.size(); i++) if (items[i].first == key) { items[i].second->release(); items.erase(items.begin() + i); return; }
+    }
+    bool merge(const OSDictionary *other) {
+        if (!other) return false;
+        for (auto &kv : other->items) setObject(kv.first.c_str(), kv.second);
+        return true;
+    }
+    unsigned int getCount() const override { return (unsigned int) items.size(); }
+    /* Iteration yields keys, like the kernel */
+    OSObject *getAnyObjectAt(unsigned int i) const override;
+    const char *keyAt(unsigned int i) const { return i < items.size() ? items[i].first.c_str() : nullptr; }
+    void flushCollection() override {
+        for (auto &kv : items) kv.second->release();
+        for (auto *key : keyCache) key->release();
+        items.clear();
+        keyCache.clear();
+    }
+    const char *getClassName() const override { return "OSDictionary"; }
+private:
+    std::vector<std::pair<std::string, OSObject *>> items;
+    mutable std::vector<OSString *> keyCache;
+};
+
+inline OSObject *OSDictionary::getAnyObjectAt(unsigned int i) const {
+    if (i >= items.size()) return nullptr;
+    OSString *key = OSString::withCString(items[i].first.c_str());
+    keyCache.push_back(key);
+    return key;
+}
+
+class OSCollectionIterator : public OSIterator {
+public:
+    static OSCollectionIterator *withCollection(const OSCollection *c) {
+        if (!c) return nullptr;
+        OSCollectionIterator *it = new OSCollectionIterator; it->coll = c; c->retain(); return it;
+    }
+    ~OSCollectionIterator() override { if (coll) coll->release(); }
+    OSObject *getNextObject() override { return coll->getAnyObjectAt(index++); }
+    void reset() override { index = 0; }
+    const char *getClassName() const override { return "OSCollectionIterator"; }
+private:
+    const OSCollection *coll {nullptr};
+    unsigned int index {0};
+};
+
+#endif
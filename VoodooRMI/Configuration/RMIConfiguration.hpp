@@ -63,6 +63,48 @@ struct RmiConfiguration {
     uint8_t palmRejectionHeight {80};
     uint8_t palmRejectionHeightTrackpoint {20};
     RmiForceTouchMode forceTouchType {RMI_FT_CLICK_AND_SIZE};
+    /* Packets to VoodooInput */
+    // Milliseconds between repeats of an unchanged packet, 0 sends every one
+    uint32_t repeatKeepAlive {100};
+};
+
+/*
+ * Two copies of a configuration, the current one and the one the next
+ * update is written to. Readers take a copy, and check the version didn't
+ * move while copying. Only the update after next writes over the copy a
+ * reader is using, so a reader retries at most once per update, and never
+ * waits on one. Updates must be serialized by the caller.
+ */
+template <typename T>
+class RmiVersionedStore {
+public:
+    inline T get() const {
+        T copy;
+        UInt32 start;
+        
+        do {
+            start = __atomic_load_n(&version, __ATOMIC_ACQUIRE);
+            copy = configs[start & 1];
+            __atomic_thread_fence(__ATOMIC_ACQUIRE);
+        } while (start != __atomic_load_n(&version, __ATOMIC_RELAXED));
+        
+        return copy;
+    }
+    
+    // Bumped every time an update is published
+    inline UInt32 getVersion() const { return __atomic_load_n(&version, __ATOMIC_ACQUIRE); }
+    
+    // Only the writer reads the current configuration in place
+    inline const T &current() const { return configs[version & 1]; }
+    
+    inline void publish(const T &next) {
+        configs[(version + 1) & 1] = next;
+        __atomic_store_n(&version, version + 1, __ATOMIC_RELEASE);
+    }
+    
+private:
+    T configs[2] {};
+    UInt32 version {0};
 };
 
 // Data for F30 and F3A
@@ -175,10 +175,19 @@ void F01::publishProps()
     propDict->release();
 }
 
+void F01::stop(IOService *provider)
+{
+    releaseRead(irqReadHandle);
+    super::stop(provider);
+}
+
 IOReturn F01::config()
 {
     int error;
     
+    releaseRead(irqReadHandle);
+    irqReadHandle = prepareRead(getDataAddr() + 1, numIrqRegs);
+    
     error = writeByte(getCtrlAddr(),
                       &device_control.ctrl0);
     if (error) {
@@ -228,8 +237,8 @@ int F01::rmi_f01_read_properties()
     UInt16 prod_info_addr;
     UInt8 ds4_query_len;
     
-    ret = readBlock(query_offset,
-                    queries, RMI_F01_BASIC_QUERY_LEN);
+    ret = readCapability(query_offset,
+                         queries, RMI_F01_BASIC_QUERY_LEN);
     if (ret) {
         IOLogError("F01 failed to read device query registers: %d", ret);
         return ret;
@@ -255,7 +264,7 @@ int F01::rmi_f01_read_properties()
              queries[5] & RMI_F01_QRY6_MONTH_MASK,
              queries[4] & RMI_F01_QRY5_YEAR_MASK);
     
-    memcpy(properties.product_id, &queries[11],
+    memcpy(properties.product_id, &queries[PRODUCT_ID_QUERY_OFFSET],
            RMI_PRODUCT_ID_LENGTH);
     properties.product_id[RMI_PRODUCT_ID_LENGTH] = '\0';
     
@@ -267,7 +276,7 @@ int F01::rmi_f01_read_properties()
         query_offset++;
     
     if (has_query42) {
-        ret = readByte(query_offset, queries);
+        ret = readCapability(query_offset, queries, 1);
         if (ret) {
             IOLogError("Failed to read query 42 register: %d", ret);
             return ret;
@@ -278,7 +287,7 @@ int F01::rmi_f01_read_properties()
     }
     
     if (has_ds4_queries) {
-        ret = readByte(query_offset, &ds4_query_len);
+        ret = readCapability(query_offset, &ds4_query_len, 1);
         if (ret) {
             IOLogError("Failed to read DS4 queries length: %d", ret);
             return ret;
@@ -286,7 +295,7 @@ int F01::rmi_f01_read_properties()
         query_offset++;
         
         if (ds4_query_len > 0) {
-            ret = readByte(query_offset, queries);
+            ret = readCapability(query_offset, queries, 1);
             if (ret) {
                 IOLogError("Failed to read DS4 queries: %d",
                         ret);
@@ -298,7 +307,7 @@ int F01::rmi_f01_read_properties()
         }
         
         if (has_package_id_query) {
-            ret = readBlock(prod_info_addr,
+            ret = readCapability(prod_info_addr,
                                  queries, sizeof(UInt64));
             if (ret) {
                 IOLogError("Failed to read package info: %d",
@@ -313,7 +322,7 @@ int F01::rmi_f01_read_properties()
         }
         
         if (has_build_id_query) {
-            ret = readBlock(prod_info_addr, queries, 3);
+            ret = readCapability(prod_info_addr, queries, 3);
             if (ret) {
                 IOLogError("Failed to read product info: %d",
                         ret);
@@ -322,6 +331,7 @@ int F01::rmi_f01_read_properties()
             
             properties.firmware_id = queries[1] << 8 | queries[0];
             properties.firmware_id += queries[2] * 65536;
+            firmware_id_addr = prod_info_addr;
         }
     }
     
@@ -373,16 +383,23 @@ int F01::rmi_f01_resume()
     return error;
 }
 
-void F01::attention()
+void F01::attention(AbsoluteTime time, RmiAttention *attention)
 {
     int error;
     UInt8 device_status = 0;
     
-    error = readByte(getDataAddr(), &device_status);
-    
-    if (error) {
-        IOLogError("F01: Failed to read device status: %d", error);
-        return;
+    if (attention) {
+        if (!readAttention(attention, &device_status, 1)) {
+            IOLogError("F01: Device status missing from attention report");
+            return;
+        }
+    } else {
+        error = readByte(getDataAddr(), &device_status);
+        
+        if (error) {
+            IOLogError("F01: Failed to read device status: %d", error);
+            return;
+        }
     }
     
     if (RMI_F01_STATUS_BOOTLOADER(device_status))
@@ -416,9 +433,10 @@ IOReturn F01::setPowerState(unsigned long powerStateOrdinal, IOService *whatDevi
 // MARK: RMI4 device IRQs
 
 IOReturn F01::readIRQ(UInt32 &irq) const {
-    return readBlock(getDataAddr() + 1,
-                      reinterpret_cast<UInt8 *>(&irq),
-                      numIrqRegs);
+    return readPrepared(irqReadHandle,
+                        getDataAddr() + 1,
+                        reinterpret_cast<UInt8 *>(&irq),
+                        numIrqRegs);
 }
 
 IOReturn F01::setIRQs() const {
@@ -442,6 +460,15 @@ IOReturn F01::setIRQs() const {
     return error;
 }
 
+void F01::getCapabilityKey(RmiCapabilityKey &key) const
+{
+    memset(&key, 0, sizeof(key));
+    key.productIdAddr = getQryAddr() + PRODUCT_ID_QUERY_OFFSET;
+    key.firmwareIdAddr = firmware_id_addr;
+    memcpy(key.productId, properties.product_id, RMI_CAP_PRODUCT_ID_LENGTH);
+    key.firmwareId = properties.firmware_id;
+}
+
 IOReturn F01::clearIRQs() const {
     int error = 0;
     UInt32 currentEnabledIRQs;
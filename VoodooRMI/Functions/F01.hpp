@@ -18,6 +18,7 @@
 #define RMI_DATE_CODE_LENGTH      3
 
 #define PRODUCT_ID_OFFSET 0x10
+#define PRODUCT_ID_QUERY_OFFSET 11
 #define PRODUCT_INFO_OFFSET 0x1E
 
 
@@ -124,8 +125,9 @@ class F01 : public RMIFunction {
     
 public:
     bool attach(IOService *provider) override;
+    void stop(IOService *provider) override;
     IOReturn config() override;
-    void attention() override;
+    void attention(AbsoluteTime time, RmiAttention *attention) override;
     
     IOReturn setPowerState(unsigned long powerStateOrdinal, IOService *whatDevice) override;
     
@@ -133,6 +135,7 @@ public:
     IOReturn readIRQ(UInt32 &irq) const;
     IOReturn setIRQs() const;
     IOReturn clearIRQs() const;
+    void getCapabilityKey(RmiCapabilityKey &key) const;
 private:
     UInt16 doze_interval_addr;
     UInt16 wakeup_threshold_addr;
@@ -143,9 +146,11 @@ private:
     
     f01_basic_properties properties;
     f01_device_control device_control;
+    UInt16 firmware_id_addr {0};
     
     UInt8 numIrqRegs;
     UInt32 irqMask;
+    int irqReadHandle {-1};
     
     f01_basic_properties * getProperties();
     void publishProps();
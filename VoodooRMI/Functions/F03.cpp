@@ -44,7 +44,7 @@ bool F03::attach(IOService *provider)
         return false;
     }
     
-    int error = readByte(getQryAddr(), &query1);
+    int error = readCapability(getQryAddr(), &query1, 1);
     
     if (error < 0) {
         IOLogError("F03: Failed to read query register: %02X", error);
@@ -65,7 +65,7 @@ bool F03::attach(IOService *provider)
         device_count = 1;
         rx_queue_length = 7;
     } else {
-        error = readBlock(getQryAddr() + 1, query2, query2_len);
+        error = readCapability(getQryAddr() + 1, query2, query2_len);
         if (error) {
             IOLogError("Failed to read second set of query registers (%d)",
                        error);
@@ -142,6 +142,7 @@ void F03::stop(IOService *provider)
     }
     
     OSSafeReleaseNULL(work_loop);
+    releaseRead(ob_read_handle);
     super::stop(provider);
 }
 
@@ -155,7 +156,7 @@ int F03::rmi_f03_pt_write(unsigned char val)
     return error;
 }
 
-void F03::handlePacket(UInt8 *packet)
+void F03::handlePacket(UInt8 *packet, AbsoluteTime time)
 {
     RMITrackpointReport report;
     // Trackpoint isn't initialized!
@@ -175,6 +176,7 @@ void F03::handlePacket(UInt8 *packet)
     report.buttons = (packet[0] & 0x7);
     report.dx = ((packet[0] & 0x10) ? 0xffffff00 : 0) | packet[1];
     report.dy = -(((packet[0] & 0x20) ? 0xffffff00 : 0) | packet[2]);
+    report.timestamp = time;
     index = 0;
     
     handleReport(&report);
@@ -199,18 +201,34 @@ IOReturn F03::setPowerState(unsigned long powerStateOrdinal, IOService *whatDevi
     return kIOPMAckImplied;
 }
 
-void F03::attention()
+IOReturn F03::config()
+{
+    releaseRead(ob_read_handle);
+    ob_read_handle = prepareRead(getDataAddr() + RMI_F03_OB_OFFSET, rx_queue_length * RMI_F03_OB_SIZE);
+    return kIOReturnSuccess;
+}
+
+void F03::attention(AbsoluteTime time, RmiAttention *attention)
 {
     const UInt16 data_addr = getDataAddr() + RMI_F03_OB_OFFSET;
     const UInt8 ob_len = rx_queue_length * RMI_F03_OB_SIZE;
     UInt8 obs[RMI_F03_QUEUE_LENGTH * RMI_F03_OB_SIZE];
     
-    int error = readBlock(data_addr, obs, ob_len);
-    if (error) {
-        IOLogError("F03 - Failed to read output buffers: %d", error);
-        return;
+    if (attention) {
+        if (readAttention(attention, obs, ob_len) < ob_len) {
+            IOLogError("F03 - Output buffers missing from attention report");
+            return;
+        }
+    } else {
+        int error = readPrepared(ob_read_handle, data_addr, obs, ob_len);
+        if (error) {
+            IOLogError("F03 - Failed to read output buffers: %d", error);
+            return;
+        }
     }
     
+    markLatency(RMI_LATENCY_DATA_READ);
+    
     for (int i = 0; i < ob_len; i += RMI_F03_OB_SIZE) {
         UInt8 ob_status = obs[i];
         UInt8 ob_data = obs[i + RMI_F03_OB_DATA_OFFSET];
@@ -229,7 +247,7 @@ void F03::attention()
             continue;
         }
         
-        handleByte(ob_data);
+        handleByte(ob_data, time);
     }
 }
 
@@ -296,7 +314,7 @@ void F03::initPS2Interrupt(OSObject *owner, IOTimerEventSource *timer)
     timer->disable();
 }
 
-void F03::handleByte(UInt8 byte)
+void F03::handleByte(UInt8 byte, AbsoluteTime time)
 {
     if (!cmdcnt && !flags) {
         // Wait for start of packets
@@ -306,7 +324,7 @@ void F03::handleByte(UInt8 byte)
         databuf[index++] = byte;
         
         if (index == 3)
-            handlePacket(databuf);
+            handlePacket(databuf, time);
         return;
     }
     
@@ -382,7 +400,9 @@ int F03::ps2CommandGated(UInt8 *param, unsigned int *cmd)
     IOReturn res;
     UInt8 send_param[16];
     
-    memcpy(send_param, param, send);
+    // memcpy with a null param lets the compiler drop the null check below
+    if (param)
+        memcpy(send_param, param, send);
     flags = command == PS2_CMD_GETID ? PS2_FLAG_WAITID : 0;
     cmdcnt = receive;
     
@@ -24,7 +24,8 @@ public:
     bool start(IOService *provider) override;
     void stop(IOService *provider) override;
     IOReturn setPowerState(unsigned long powerStateOrdinal, IOService *whatDevice) override;
-    void attention() override;
+    IOReturn config() override;
+    void attention(AbsoluteTime time, RmiAttention *attention) override;
     
 private:
     IOWorkLoop *work_loop {nullptr};
@@ -48,16 +49,17 @@ private:
     // F03 Data
     UInt8 device_count;
     UInt8 rx_queue_length;
+    int ob_read_handle {-1};
     
     int rmi_f03_pt_write(unsigned char val);
     int ps2DoSendbyteGated(UInt8 byte, uint64_t timeout);
     int ps2CommandGated(UInt8 *param, unsigned int *command);
     int ps2Command(UInt8 *param, unsigned int command);
-    void handleByte(UInt8);
+    void handleByte(UInt8, AbsoluteTime);
     void initPS2();
     void initPS2Interrupt(OSObject *owner, IOTimerEventSource *timer);
     
-    void handlePacket(UInt8 *packet);
+    void handlePacket(UInt8 *packet, AbsoluteTime time);
 };
 
 #endif /* F03_hpp */
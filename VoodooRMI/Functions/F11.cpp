@@ -31,39 +31,32 @@ bool F11::attach(IOService *provider)
     return true;
 }
 
-void F11::free()
-{
-    if (data_pkt != nullptr) {
-        IOFree(data_pkt, pkt_size);
-        data_pkt = nullptr;
-    }
-    super::free();
-}
-
-void F11::attention()
+void F11::attention(AbsoluteTime time, RmiAttention *attention)
 {
     int error, abs_size;
-    size_t fingers;
+    size_t fingers, valid_bytes = pkt_size;
     UInt8 finger_state;
-    AbsoluteTime timestamp;
     
-    error = readBlock(getDataAddr(), data_pkt, pkt_size);
-    if (error < 0) {
-        IOLogError("Could not read F11 attention data: %d", error);
-        return;
+    if (attention) {
+        valid_bytes = readAttention(attention, data_pkt, attn_size);
+    } else {
+        error = readPrepared(data_read_handle, getDataAddr(), data_pkt, pkt_size);
+        if (error < 0) {
+            IOLogError("Could not read F11 attention data: %d", error);
+            return;
+        }
     }
     
-    clock_get_uptime(&timestamp);
-    
-    if (shouldDiscardReport(timestamp))
+    markLatency(RMI_LATENCY_DATA_READ);
+    if (shouldDiscardReport(time))
         return;
     
     IOLogDebug("F11 Packet");
     
     abs_size = nbr_fingers & RMI_F11_ABS_BYTES;
     
-    if (abs_size > pkt_size)
-        fingers = pkt_size / RMI_F11_ABS_BYTES;
+    if (abs_size > valid_bytes)
+        fingers = valid_bytes / RMI_F11_ABS_BYTES;
     else fingers = nbr_fingers;
     
     for (size_t i = 0; i < fingers; i++) {
@@ -76,32 +69,41 @@ void F11::attention()
             continue;
         }
         
-        report.objs[i].x = (pos_data[0] << 4) | (pos_data[2] & 0x0F);
-        report.objs[i].y = (pos_data[1] << 4) | (pos_data[2] >> 4);
-        report.objs[i].z = pos_data[4];
-        report.objs[i].wx = pos_data[3] & 0x0f;
-        report.objs[i].wy = pos_data[3] >> 4;
+        report.x[i] = (pos_data[0] << 4) | (pos_data[2] & 0x0F);
+        report.y[i] = (pos_data[1] << 4) | (pos_data[2] >> 4);
+        report.z[i] = pos_data[4];
+        report.wx[i] = pos_data[3] & 0x0f;
+        report.wy[i] = pos_data[3] >> 4;
         
         switch (finger_state) {
             case F11_PRESENT:
-                report.objs[i].type = RMI_2D_OBJECT_FINGER;
+                report.type[i] = RMI_2D_OBJECT_FINGER;
                 break;
             case F11_INACCURATE:
-                report.objs[i].type = RMI_2D_OBJECT_INACCURATE;
+                report.type[i] = RMI_2D_OBJECT_INACCURATE;
                 break;
             default:
-                report.objs[i].type = RMI_2D_OBJECT_NONE;
+                report.type[i] = RMI_2D_OBJECT_NONE;
         }
     }
     
-    report.timestamp = timestamp;
+    report.timestamp = time;
     report.fingers = fingers;
     
     handleReport(&report);
 }
 
+void F11::stop(IOService *provider)
+{
+    releaseRead(data_read_handle);
+    super::stop(provider);
+}
+
 int F11::config()
 {
+    super::config();
+    releaseRead(data_read_handle);
+    data_read_handle = prepareRead(getDataAddr(), pkt_size);
     return f11_write_control_regs(&sens_query, &dev_controls, getQryAddr());
 }
 
@@ -171,7 +173,7 @@ int F11::f11_2d_construct_data()
         pkt_size +=
             DIV_ROUND_UP(query->nr_touch_shapes + 1, 8);
     
-    data_pkt = reinterpret_cast<UInt8*>(IOMalloc(pkt_size));
+    data_pkt = arena.alloc<UInt8>(pkt_size);
     
     if (!data_pkt)
         return -ENOMEM;
@@ -197,7 +199,7 @@ int F11::rmi_f11_get_query_parameters(f11_2d_sensor_queries *sensor_query,
     UInt8 query_buf[RMI_F11_QUERY_SIZE];
     bool has_query36 = false;
     
-    rc = readBlock(query_base_addr, query_buf, RMI_F11_QUERY_SIZE);
+    rc = readCapability(query_base_addr, query_buf, RMI_F11_QUERY_SIZE);
     if (rc < 0)
         return rc;
     
@@ -229,7 +231,7 @@ int F11::rmi_f11_get_query_parameters(f11_2d_sensor_queries *sensor_query,
     query_size = RMI_F11_QUERY_SIZE;
     OSNumber *value;
     if (sensor_query->has_abs) {
-        rc = readByte(query_base_addr + query_size, query_buf);
+        rc = readCapability(query_base_addr + query_size, query_buf, 1);
         if (rc < 0)
             return rc;
         
@@ -262,14 +264,14 @@ int F11::rmi_f11_get_query_parameters(f11_2d_sensor_queries *sensor_query,
     }
     
     if (sensor_query->has_rel) {
-        rc = readByte(query_base_addr + query_size, &sensor_query->f11_2d_query6);
+        rc = readCapability(query_base_addr + query_size, &sensor_query->f11_2d_query6, 1);
         if (rc < 0)
             return rc;
         query_size++;
     }
     
     if (sensor_query->has_gestures) {
-        rc = readBlock(query_base_addr + query_size, query_buf, RMI_F11_QUERY_GESTURE_SIZE);
+        rc = readCapability(query_base_addr + query_size, query_buf, RMI_F11_QUERY_GESTURE_SIZE);
         if (rc < 0)
             return rc;
         
@@ -336,7 +338,7 @@ int F11::rmi_f11_get_query_parameters(f11_2d_sensor_queries *sensor_query,
     }
     
     if (has_query9) {
-        rc = readByte(query_base_addr + query_size, query_buf);
+        rc = readCapability(query_base_addr + query_size, query_buf, 1);
         if (rc < 0)
             return rc;
         
@@ -373,7 +375,7 @@ int F11::rmi_f11_get_query_parameters(f11_2d_sensor_queries *sensor_query,
     }
     
     if (sensor_query->has_touch_shapes) {
-        rc = readByte(query_base_addr + query_size, query_buf);
+        rc = readCapability(query_base_addr + query_size, query_buf, 1);
         if (rc < 0)
             return rc;
         
@@ -386,7 +388,7 @@ int F11::rmi_f11_get_query_parameters(f11_2d_sensor_queries *sensor_query,
     }
     
     if (has_query11) {
-        rc = readByte(query_base_addr + query_size, query_buf);
+        rc = readCapability(query_base_addr + query_size, query_buf, 1);
         if (rc < 0)
             return rc;
         
@@ -423,7 +425,7 @@ int F11::rmi_f11_get_query_parameters(f11_2d_sensor_queries *sensor_query,
     }
     
     if (has_query12) {
-        rc = readByte(query_base_addr + query_size, query_buf);
+        rc = readCapability(query_base_addr + query_size, query_buf, 1);
         if (rc < 0)
             return rc;
         
@@ -459,7 +461,7 @@ int F11::rmi_f11_get_query_parameters(f11_2d_sensor_queries *sensor_query,
     }
 
     if (sensor_query->has_jitter_filter) {
-        rc = readByte(query_base_addr + query_size, query_buf);
+        rc = readCapability(query_base_addr + query_size, query_buf, 1);
         if (rc < 0)
             return rc;
         
@@ -478,7 +480,7 @@ int F11::rmi_f11_get_query_parameters(f11_2d_sensor_queries *sensor_query,
     }
     
     if (sensor_query->has_info2) {
-        rc = readByte(query_base_addr + query_size, query_buf);
+        rc = readCapability(query_base_addr + query_size, query_buf, 1);
         if (rc < 0)
             return rc;
         
@@ -507,7 +509,7 @@ int F11::rmi_f11_get_query_parameters(f11_2d_sensor_queries *sensor_query,
     }
     
     if (sensor_query->has_physical_props) {
-        rc = readBlock(query_base_addr + query_size, query_buf, 4);
+        rc = readCapability(query_base_addr + query_size, query_buf, 4);
         if (rc < 0)
             return rc;
         
@@ -538,7 +540,7 @@ int F11::rmi_f11_get_query_parameters(f11_2d_sensor_queries *sensor_query,
      * The check for has_query36 in here suggests not though
      */
     if (has_query28) {
-        rc = readByte(query_base_addr + query_size, query_buf);
+        rc = readCapability(query_base_addr + query_size, query_buf, 1);
         if (rc < 0)
             return rc;
         
@@ -547,7 +549,7 @@ int F11::rmi_f11_get_query_parameters(f11_2d_sensor_queries *sensor_query,
     
     if (has_query36) {
         query_size += 2;
-        rc = readByte(query_base_addr + query_size, query_buf);
+        rc = readCapability(query_base_addr + query_size, query_buf, 1);
         if (rc < 0)
             return rc;
         
@@ -573,7 +575,7 @@ int F11::rmi_f11_initialize()
     query_base_addr = getQryAddr();
     control_base_addr = getCtrlAddr();
     
-    rc = readByte(query_base_addr, &buf);
+    rc = readCapability(query_base_addr, &buf, 1);
     if (rc < 0) {
         IOLogError("F11: Could not read Query Base Addr");
         return rc;
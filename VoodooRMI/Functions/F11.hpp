@@ -500,8 +500,8 @@ class F11 : public RMITrackpadFunction {
     
 public:
     bool attach(IOService *provider) override;
-    void attention() override;
-    void free() override;
+    void stop(IOService *provider) override;
+    void attention(AbsoluteTime time, RmiAttention *attention) override;
     
     IOReturn config() override;
     
@@ -530,6 +530,7 @@ private:
     UInt16 rezero_wait_ms;
     UInt8 *data_pkt { nullptr };
     size_t pkt_size;
+    int data_read_handle {-1};
     size_t attn_size;
     struct f11_2d_sensor_queries sens_query;
     struct f11_2d_data data_2d;
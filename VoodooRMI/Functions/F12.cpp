@@ -19,13 +19,12 @@ bool F12::attach(IOService *provider)
     UInt8 buf;
     UInt16 query_addr = getQryAddr();
     const rmi_register_desc_item *item;
-    UInt16 data_offset = 0;
     
     if(!super::attach(provider)) {
         return false;
     }
     
-    ret = readByte(query_addr, &buf);
+    ret = readCapability(query_addr, &buf, 1);
     if (ret < 0) {
         IOLogError("F12 - Failed to read general info register: %d", ret);
         return false;
@@ -42,7 +41,7 @@ bool F12::attach(IOService *provider)
     ret = rmi_read_register_desc(query_addr, &query_reg_desc);
     if (ret) {
         IOLogError ("F12 - Failed to read the Query Register Descriptor: %d", ret);
-        return ret;
+        return false;
     }
     query_addr += 3;
     
@@ -50,7 +49,7 @@ bool F12::attach(IOService *provider)
     if (ret) {
         IOLogError("F12 - Failed to read the Control Register Descriptor: %d",
                    ret);
-        return ret;
+        return false;
     }
     query_addr += 3;
     
@@ -58,17 +57,20 @@ bool F12::attach(IOService *provider)
     if (ret) {
         IOLogError("F12 - Failed to read the Data Register Descriptor: %d",
                    ret);
-        return ret;
+        return false;
     }
     query_addr += 3;
     
     pkt_size = rmi_register_desc_calc_size(&data_reg_desc);
     IOLogDebug("F12 - Data packet size: 0x%lx", pkt_size);
     
-    data_pkt = reinterpret_cast<UInt8 *>(IOMalloc(pkt_size));
+    // Zeroed, as trimmed reads leave slots they don't read untouched
+    data_pkt = arena.alloc<UInt8>(pkt_size);
     
-    if (!data_pkt)
-        return -ENOMEM;
+    if (!data_pkt) {
+        IOLogError("F12 - Failed to allocate %lu byte data packet", pkt_size);
+        return false;
+    }
     
     ret = rmi_f12_read_sensor_tuning();
     if (ret) {
@@ -83,40 +85,22 @@ bool F12::attach(IOService *provider)
      * attention report check to see if the device is receiving data from
      * HID attention reports.
      */
-    item = rmi_get_register_desc_item(&data_reg_desc, 0);
-    if (item)
-        data_offset += item->reg_size;
-    
     item = rmi_get_register_desc_item(&data_reg_desc, 1);
     if (!item) {
-        return false;
         IOLogError("F12 - No Data1 Reg!");
+        return false;
     }
     
     data1 = item;
-    data1_offset = data_offset;
-    data_offset += item->reg_size;
+    data1_offset = item->byte_offset;
     nbr_fingers = item->num_subpackets;
     report_abs = 1;
     attn_size += item->reg_size;
     
-    item = rmi_get_register_desc_item(&data_reg_desc, 2);
-    if (item)
-        data_offset += item->reg_size;
-    
-    item = rmi_get_register_desc_item(&data_reg_desc, 3);
-    if (item)
-        data_offset += item->reg_size;
-    
-    item = rmi_get_register_desc_item(&data_reg_desc, 4);
-    if (item)
-        data_offset += item->reg_size;
-    
     item = rmi_get_register_desc_item(&data_reg_desc, 5);
     if (item) {
         data5 = item;
-        data5_offset = data_offset;
-        data_offset += item->reg_size;
+        data5_offset = item->byte_offset;
         attn_size += item->reg_size;
     }
     
@@ -125,17 +109,96 @@ bool F12::attach(IOService *provider)
     setProperty("Number of fingers", nbr_fingers, 8);
     IOLogDebug("F12 - Number of fingers %u", nbr_fingers);
     
-    
+    rmi_f12_setup_trimmed_reads();
     return true;
 }
 
-void F12::free()
+/*
+ * Packet registers each take a single address, so Data1 and the object
+ * bitmap can be read on their own. Needs a bitmap big enough for every
+ * object, otherwise the whole data packet is read on every attention.
+ * Only worth it when the transport reads part of a prepared read in fewer
+ * transactions, and the packet takes more than one, so the bitmap read
+ * costs no more than the block it saves. On I2C the whole packet is a
+ * single prepared read, splitting it only adds a transaction.
+ */
+void F12::rmi_f12_setup_trimmed_reads()
 {
-    if (data_pkt != nullptr) {
-        IOFree(data_pkt, pkt_size);
-        data_pkt = nullptr;
+    const rmi_register_desc_item *item;
+    int data1_index, mask_index;
+    size_t block_size = getPreparedReadBlockSize();
+    
+    if (block_size == 0 || pkt_size <= block_size) {
+        setProperty("Trimmed Reads", kOSBooleanFalse);
+        return;
+    }
+    
+    data1_index = rmi_register_desc_calc_reg_offset(&data_reg_desc, 1);
+    
+    mask_is_present = true;
+    item = rmi_get_register_desc_item(&data_reg_desc, 15);
+    if (!item) {
+        mask_is_present = false;
+        item = data5;
+    }
+    
+    if (data1_index < 0 || data1->reg_size < nbr_fingers * F12_DATA1_BYTES_PER_OBJ || !item ||
+        item->reg_size == 0 || item->reg_size > F12_OBJECT_MASK_MAX_BYTES ||
+        item->reg_size * BITS_PER_BYTE < nbr_fingers) {
+        setProperty("Trimmed Reads", kOSBooleanFalse);
+        return;
     }
-    super::free();
+    
+    mask_index = rmi_register_desc_calc_reg_offset(&data_reg_desc, item->reg);
+    data1_addr = getDataAddr() + data1_index;
+    mask_addr = getDataAddr() + mask_index;
+    mask_size = item->reg_size;
+    trimmed_reads = true;
+    
+    setProperty("Trimmed Reads", mask_is_present ? "Data15" : "Data5");
+}
+
+/*
+ * Read the object bitmap, then Data1 up to the highest object in it.
+ * Slots past that are either empty (Data15) or unchanged (Data5). The
+ * transport may read more slots than asked, see readPrepared.
+ */
+int F12::rmi_f12_read_objects()
+{
+    UInt8 mask_buf[F12_OBJECT_MASK_MAX_BYTES];
+    UInt8 *objs = &data_pkt[data1_offset];
+    UInt32 mask = 0;
+    int slots, retval;
+    
+    retval = readPrepared(mask_read_handle, mask_addr, mask_buf, mask_size);
+    if (retval < 0)
+        return retval;
+    
+    for (size_t i = 0; i < mask_size; i++)
+        mask |= (UInt32) mask_buf[i] << (i * BITS_PER_BYTE);
+    
+    mask &= (nbr_fingers < 32) ? BIT(nbr_fingers) - 1 : ~0U;
+    slots = mask ? 32 - __builtin_clz(mask) : 0;
+    
+    if (slots > 0) {
+        retval = readPrepared(data1_read_handle, data1_addr, objs, slots * F12_DATA1_BYTES_PER_OBJ);
+        if (retval < 0)
+            return retval;
+    }
+    
+    if (mask_is_present && slots < nbr_fingers)
+        memset(&objs[slots * F12_DATA1_BYTES_PER_OBJ], 0,
+               (nbr_fingers - slots) * F12_DATA1_BYTES_PER_OBJ);
+    
+    return 0;
+}
+
+void F12::stop(IOService *provider)
+{
+    releaseRead(mask_read_handle);
+    releaseRead(data1_read_handle);
+    releaseRead(data_read_handle);
+    super::stop(provider);
 }
 
 IOReturn F12::config()
@@ -146,6 +209,16 @@ IOReturn F12::config()
     UInt8 subpacket_offset = 0;
     IOReturn ret;
     
+    super::config();
+    releaseRead(mask_read_handle);
+    releaseRead(data1_read_handle);
+    releaseRead(data_read_handle);
+    if (trimmed_reads) {
+        mask_read_handle = prepareRead(mask_addr, mask_size);
+        data1_read_handle = prepareRead(data1_addr, nbr_fingers * F12_DATA1_BYTES_PER_OBJ);
+    } else
+        data_read_handle = prepareRead(getDataAddr(), pkt_size);
+    
     if (!has_dribble) {
         return kIOReturnSuccess;
     }
@@ -214,7 +287,7 @@ int F12::rmi_f12_read_sensor_tuning()
         return -ENODEV;
     }
     
-    ret = readBlock(getCtrlAddr() + offset, buf, item->reg_size);
+    ret = readCapability(getCtrlAddr() + offset, buf, item->reg_size);
     if (ret)
         return ret;
     
@@ -267,82 +340,80 @@ int F12::rmi_f12_read_sensor_tuning()
     return 0;
 }
 
-void F12::attention()
+void F12::attention(AbsoluteTime time, RmiAttention *attention)
 {
-    AbsoluteTime timestamp;
+    size_t valid_bytes = pkt_size - data1_offset;
     
     if (!data1)
         return;
     
-    int retval = readBlock(getDataAddr(), data_pkt, pkt_size);
-    
-    if (retval < 0) {
-        IOLogError("F12 - Failed to read object data. Code: %d", retval);
-        return;
+    if (attention) {
+        // Attention reports start at Data1
+        valid_bytes = readAttention(attention, &data_pkt[data1_offset], attn_size);
+    } else {
+        int retval;
+        
+        if (trimmed_reads)
+            retval = rmi_f12_read_objects();
+        else
+            retval = readPrepared(data_read_handle, getDataAddr(), data_pkt, pkt_size);
+        
+        if (retval < 0) {
+            IOLogError("F12 - Failed to read object data. Code: %d", retval);
+            return;
+        }
     }
     
-    clock_get_uptime(&timestamp);
-    if (shouldDiscardReport(timestamp))
+    markLatency(RMI_LATENCY_DATA_READ);
+    if (shouldDiscardReport(time))
         return;
     
     IOLogDebug("F12 Packet");
-#if DEBUG
-    if (nbr_fingers > 5) {
-        IOLogDebug("More than 5 fingers!");
-    }
-#endif // debug
     
-    int fingers = min (nbr_fingers, 5);
-    UInt8 *data = &data_pkt[data1_offset];
+    int fingers = min (nbr_fingers, MAX_FINGERS);
+    if (fingers * F12_DATA1_BYTES_PER_OBJ > valid_bytes)
+        fingers = (int) (valid_bytes / F12_DATA1_BYTES_PER_OBJ);
     
-    for (int i = 0; i < fingers; i++) {
-        rmi_2d_sensor_abs_object *obj = &report.objs[i];
-        
-        switch (data[0]) {
-            case RMI_F12_OBJECT_FINGER:
-                obj->type = RMI_2D_OBJECT_FINGER;
-                break;
-            case RMI_F12_OBJECT_STYLUS:
-                obj->type = RMI_2D_OBJECT_STYLUS;
-                break;
-            default:
-                obj->type = RMI_2D_OBJECT_NONE;
-        }
-        
-        obj->x = (data[2] << 8) | data[1];
-        obj->y = (data[4] << 8) | data[3];
-        obj->z = data[5];
-        obj->wx = data[6];
-        obj->wy = data[7];
-        
-        data += F12_DATA1_BYTES_PER_OBJ;
-    }
-    
-    report.timestamp = timestamp;
+    unpackObjects(&data_pkt[data1_offset], fingers, report);
+    report.timestamp = time;
     report.fingers = fingers;
     
     handleReport(&report);
 }
 
+static_assert((int) RMI_F12_OBJECT_FINGER == (int) RMI_2D_OBJECT_FINGER &&
+              (int) RMI_F12_OBJECT_STYLUS == (int) RMI_2D_OBJECT_STYLUS,
+              "F12 object types are passed through as rmi_2d_sensor_object_type");
+
+void F12::unpackObjects(const UInt8 *data, size_t count, RMI2DSensorReport &report)
+{
+    for (size_t i = 0; i < count; i++) {
+        const UInt8 *obj = &data[i * F12_DATA1_BYTES_PER_OBJ];
+        UInt8 type = obj[0];
+        
+        report.type[i] = (type == RMI_F12_OBJECT_FINGER || type == RMI_F12_OBJECT_STYLUS) ?
+                         type : RMI_2D_OBJECT_NONE;
+        report.x[i] = (obj[2] << 8) | obj[1];
+        report.y[i] = (obj[4] << 8) | obj[3];
+        report.z[i] = obj[5];
+        report.wx[i] = obj[6];
+        report.wy[i] = obj[7];
+    }
+}
+
 int F12::rmi_read_register_desc(UInt16 addr,
                                 rmi_register_descriptor *rdesc)
 {
     int ret;
     UInt8 size_presence_reg;
     UInt8 buf[35];
-    int presense_offset = 1;
     UInt8 *struct_buf;
-    int reg;
-    int offset = 0;
-    int map_offset = 0;
-    int i;
-    int b;
     
     /*
      * The first register of the register descriptor is the size of
      * the register descriptor's presense register.
      */
-    ret = readByte(addr, &size_presence_reg);
+    ret = readCapability(addr, &size_presence_reg, 1);
     if (ret)
         return ret;
     ++addr;
@@ -357,35 +428,17 @@ int F12::rmi_read_register_desc(UInt16 addr,
      * and a bitmap which identified which packet registers are present
      * for this particular register type (ie query, control, or data).
      */
-    ret = readBlock(addr, buf, size_presence_reg);
+    ret = readCapability(addr, buf, size_presence_reg);
     if (ret)
         return ret;
     ++addr;
     
-    if (buf[0] == 0) {
-        presense_offset = 3;
-        rdesc->struct_size = buf[1] | (buf[2] << 8);
-    } else {
-        rdesc->struct_size = buf[0];
-    }
-    
-    for (i = presense_offset; i < size_presence_reg; i++) {
-        for (b = 0; b < 8; b++) {
-            if (buf[i] & (0x1 << b))
-                bitmap_set(rdesc->presense_map, map_offset, 1);
-            ++map_offset;
-        }
-    }
-    
-    rdesc->num_registers = bitmap_weight(rdesc->presense_map,
-                                         RMI_REG_DESC_PRESENSE_BITS);
+    rmi_parse_register_presence(rdesc, buf, size_presence_reg);
     
-    rdesc->registers = reinterpret_cast<rmi_register_desc_item *>(IOMalloc(rdesc->num_registers * sizeof(rmi_register_desc_item)));
+    rdesc->registers = arena.alloc<rmi_register_desc_item>(rdesc->num_registers);
     if (!rdesc->registers)
         return -ENOMEM;
     
-    memset (rdesc->registers, 0, rdesc->num_registers * sizeof(rmi_register_desc_item));
-    
     /*
      * Allocate a temporary buffer to hold the register structure.
      * I'm not using devm_kzalloc here since it will not be retained
@@ -401,37 +454,97 @@ int F12::rmi_read_register_desc(UInt16 addr,
      * register and a bitmap of all subpackets contained in the packet
      * register.
      */
-    ret = readBlock(addr, struct_buf, rdesc->struct_size);
-    if (ret)
-        goto free_struct_buff;
+    ret = readCapability(addr, struct_buf, rdesc->struct_size);
+    if (!ret)
+        ret = rmi_parse_register_struct(rdesc, struct_buf);
+    
+    IOFree(struct_buf, rdesc->struct_size);
+    return ret;
+}
+
+void F12::rmi_parse_register_presence(rmi_register_descriptor *rdesc,
+                                      const UInt8 *buf, UInt8 size)
+{
+    int presense_offset = 1;
+    int map_offset = 0;
+    int i;
+    int b;
+    
+    if (buf[0] == 0) {
+        presense_offset = 3;
+        rdesc->struct_size = buf[1] | (buf[2] << 8);
+    } else {
+        rdesc->struct_size = buf[0];
+    }
+    
+    // A one byte size leaves room for more bits than the map holds
+    for (i = presense_offset; i < size; i++) {
+        for (b = 0; b < 8 && map_offset < RMI_REG_DESC_PRESENSE_BITS; b++) {
+            if (buf[i] & (0x1 << b))
+                bitmap_set(rdesc->presense_map, map_offset, 1);
+            ++map_offset;
+        }
+    }
+    
+    rdesc->num_registers = bitmap_weight(rdesc->presense_map,
+                                         RMI_REG_DESC_PRESENSE_BITS);
+}
+
+int F12::rmi_parse_register_struct(rmi_register_descriptor *rdesc,
+                                   const UInt8 *struct_buf)
+{
+    int reg;
+    int offset = 0;
+    int map_offset;
+    int i;
+    int b;
     
+    /*
+     * Sizes are one byte, or 0 followed by two bytes, or 0, 0, 0 and
+     * then four bytes. A truncated structure fails rather than reading
+     * past the end of struct_buf.
+     */
     reg = find_first_bit(rdesc->presense_map, RMI_REG_DESC_PRESENSE_BITS);
     for (i = 0; i < rdesc->num_registers; i++) {
         struct rmi_register_desc_item *item = &rdesc->registers[i];
-        int reg_size = struct_buf[offset];
+        unsigned long reg_size;
+        
+        if (offset + 1 > rdesc->struct_size)
+            goto truncated;
+        reg_size = struct_buf[offset];
         
         ++offset;
         if (reg_size == 0) {
+            if (offset + 2 > rdesc->struct_size)
+                goto truncated;
             reg_size = struct_buf[offset] |
                        (struct_buf[offset + 1] << 8);
             offset += 2;
         }
         
         if (reg_size == 0) {
+            if (offset + 4 > rdesc->struct_size)
+                goto truncated;
             reg_size = struct_buf[offset] |
                        (struct_buf[offset + 1] << 8) |
                        (struct_buf[offset + 2] << 16) |
-                       (struct_buf[offset + 3] << 24);
+                       ((unsigned long) struct_buf[offset + 3] << 24);
             offset += 4;
         }
         
         item->reg = reg;
         item->reg_size = reg_size;
+        item->byte_offset = rdesc->packet_size;
+        rdesc->packet_size += reg_size;
+        if (reg < RMI_REG_DESC_PRESENSE_BITS)
+            rdesc->reg_index[reg] = i + 1;
         
         map_offset = 0;
         
         do {
-            for (b = 0; b < 7; b++) {
+            if (offset >= rdesc->struct_size)
+                goto truncated;
+            for (b = 0; b < 7 && map_offset < RMI_REG_DESC_SUBPACKET_BITS; b++) {
                 if (struct_buf[offset] & (0x1 << b))
                     bitmap_set(item->subpacket_map,
                                map_offset, 1);
@@ -449,57 +562,36 @@ int F12::rmi_read_register_desc(UInt16 addr,
                             RMI_REG_DESC_PRESENSE_BITS, reg + 1);
     }
     
-free_struct_buff:
-    IOFree(struct_buf, rdesc->struct_size);
-    return ret;
+    return 0;
+truncated:
+    IOLogError("F12 - Register descriptor structure is truncated at register %d", reg);
+    return -EIO;
 }
 
 /* Compute the register offset relative to the base address */
 int F12::rmi_register_desc_calc_reg_offset(rmi_register_descriptor *rdesc, UInt16 reg)
 {
-    const struct rmi_register_desc_item *item;
-    int offset = 0;
-    int i;
+    if (reg >= RMI_REG_DESC_PRESENSE_BITS)
+        return -1;
     
-    for (i = 0; i < rdesc->num_registers; i++) {
-        item = &rdesc->registers[i];
-        if (item->reg == reg)
-            return offset;
-        ++offset;
-    }
-    return -1;
+    return rdesc->reg_index[reg] - 1;
 }
 
 size_t F12::rmi_register_desc_calc_size(rmi_register_descriptor *rdesc)
 {
-    const rmi_register_desc_item *item;
-    int i;
-    size_t size = 0;
-    
-    for (i = 0; i < rdesc->num_registers; i++) {
-        item = &rdesc->registers[i];
-        size += item->reg_size;
-    }
-    return size;
+    return rdesc->packet_size;
 }
 
 rmi_register_desc_item *F12::rmi_get_register_desc_item(rmi_register_descriptor *rdesc, UInt16 reg)
 {
-    rmi_register_desc_item *item;
-    int i;
-    
-    for (i = 0; i < rdesc->num_registers; i++) {
-        item = &rdesc->registers[i];
-        if (item->reg == reg)
-            return item;
-    }
+    int index = rmi_register_desc_calc_reg_offset(rdesc, reg);
     
-    return NULL;
+    return index < 0 ? NULL : &rdesc->registers[index];
 }
 
 bool F12::rmi_register_desc_has_subpacket(const rmi_register_desc_item *item,
                                           UInt8 subpacket)
 {
-    return find_next_bit(item->subpacket_map, RMI_REG_DESC_PRESENSE_BITS,
-                         subpacket) == subpacket;
+    return subpacket < RMI_REG_DESC_SUBPACKET_BITS &&
+           (item->subpacket_map[subpacket / BITS_PER_LONG] >> (subpacket % BITS_PER_LONG)) & 1;
 }
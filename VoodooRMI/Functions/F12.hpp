@@ -12,6 +12,7 @@
 #include <RMITrackpadFunction.hpp>
 
 #define F12_DATA1_BYTES_PER_OBJ            8
+#define F12_OBJECT_MASK_MAX_BYTES          4
 #define RMI_REG_DESC_PRESENSE_BITS    (32 * BITS_PER_BYTE)
 #define RMI_REG_DESC_SUBPACKET_BITS    (37 * BITS_PER_BYTE)
 
@@ -21,17 +22,26 @@ struct rmi_register_desc_item {
     unsigned long reg_size;
     UInt8 num_subpackets;
     unsigned long subpacket_map[BITS_TO_LONGS(RMI_REG_DESC_SUBPACKET_BITS)];
+    /* offset of this register in a block read from the base address */
+    size_t byte_offset;
 };
 
 /*
  * describes the packet registers for a particular type
  * (ie query, control, data)
+ *
+ * Each packet register takes one address, so a register's address is
+ * base + its index in registers. Reading a block from the base returns
+ * every register back to back, where it starts at byte_offset instead.
  */
 struct rmi_register_descriptor {
     unsigned long struct_size;
     unsigned long presense_map[BITS_TO_LONGS(RMI_REG_DESC_PRESENSE_BITS)];
     UInt8 num_registers;
     struct rmi_register_desc_item *registers;
+    /* register number -> index in registers + 1, 0 if not present */
+    UInt8 reg_index[RMI_REG_DESC_PRESENSE_BITS];
+    size_t packet_size;
 };
 
 enum rmi_f12_object_type {
@@ -54,11 +64,25 @@ class F12 : public RMITrackpadFunction {
     
 public:
     bool attach(IOService *provider) override;
-    void attention() override;
-    void free() override;
+    void stop(IOService *provider) override;
+    void attention(AbsoluteTime time, RmiAttention *attention) override;
     
     IOReturn config() override;
     
+    // Decode count Data1 objects into the report. Branchless so it vectorizes
+    static void unpackObjects(const UInt8 *data, size_t count, RMI2DSensorReport &report);
+    
+    /*
+     * Register descriptor parsing, split from reading it so it can be fed
+     * bytes directly. The presence buffer is zero padded to at least 3
+     * bytes. The structure parse needs num_registers items allocated, and
+     * fails with -EIO if struct_size ends before every register is described.
+     */
+    static void rmi_parse_register_presence(rmi_register_descriptor *rdesc,
+                                            const UInt8 *buf, UInt8 size);
+    static int rmi_parse_register_struct(rmi_register_descriptor *rdesc,
+                                         const UInt8 *struct_buf);
+    
 private:
     IOService *voodooInputInstance {nullptr};
     
@@ -73,6 +97,7 @@ private:
     /* F12 Data */
     UInt8 *data_pkt;
     size_t pkt_size;
+    int data_read_handle {-1};
     size_t attn_size;
     bool has_dribble;
     
@@ -92,6 +117,23 @@ private:
     const rmi_register_desc_item *data6 {nullptr};
     UInt16 data6_offset;
     
+    /*
+     * Trimmed reads: read a bitmap of objects first, then only the Data1
+     * slots up to the highest object in it. Data15 has a bit for every
+     * object present, Data5 a bit for every object that changed.
+     */
+    bool trimmed_reads {false};
+    bool mask_is_present {false};
+    UInt16 data1_addr;
+    UInt16 mask_addr;
+    size_t mask_size;
+    int mask_read_handle {-1};
+    // Prepared for every object, only the chunks up to the highest object are read
+    int data1_read_handle {-1};
+    
+    void rmi_f12_setup_trimmed_reads();
+    int rmi_f12_read_objects();
+    
     int rmi_f12_read_sensor_tuning();
     int rmi_read_register_desc(UInt16 addr,
                                rmi_register_descriptor *rdesc);
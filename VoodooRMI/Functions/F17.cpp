@@ -27,18 +27,12 @@ bool F17::attach(IOService *provider)
     return true;
 }
 
-void F17::free()
-{
-    if (f17.sticks)
-        IOFree(f17.sticks, (f17.query.number_of_sticks + 1) * sizeof(struct rmi_f17_stick_data));
-    super::free();
-}
-
-void F17::attention()
+void F17::attention(AbsoluteTime time, RmiAttention *attention)
 {
+    // Sticks aren't part of attention reports, always read the registers
     int retval = 0;
     for (int i = 0; i < f17.query.number_of_sticks + 1 && !retval; i++)
-        retval = rmi_f17_process_stick(&f17.sticks[i]);
+        retval = rmi_f17_process_stick(&f17.sticks[i], time);
 
     if (retval < 0) {
         IOLogError("%s: Could not read data: %d", __func__, retval);
@@ -49,7 +43,7 @@ int F17::rmi_f17_init_stick(struct rmi_f17_stick_data *stick,
               UInt16 *next_query_reg, UInt16 *next_data_reg,
               UInt16 *next_control_reg) {
     int retval;
-    retval = readBlock(*next_query_reg,
+    retval = readCapability(*next_query_reg,
                        stick->query.general.regs,
                        sizeof(stick->query.general.regs));
     if (retval < 0) {
@@ -90,7 +84,7 @@ int F17::rmi_f17_init_stick(struct rmi_f17_stick_data *stick,
     setPropertyNumber(stickProps, "Reserved2", stick->query.general.reserved2, 8);
 #endif
     if (stick->query.general.has_gestures) {
-        retval = readBlock(*next_query_reg,
+        retval = readCapability(*next_query_reg,
                            stick->query.gestures.regs,
                            sizeof(stick->query.gestures.regs));
         if (retval < 0) {
@@ -135,7 +129,7 @@ int F17::rmi_f17_initialize() {
     UInt16 next_data_reg = getDataAddr();
     UInt16 next_control_reg = getCtrlAddr();
 
-    retval = readBlock(getQryAddr(),
+    retval = readCapability(getQryAddr(),
                        f17.query.regs, sizeof(f17.query.regs));
 
     if (retval < 0) {
@@ -145,12 +139,11 @@ int F17::rmi_f17_initialize() {
 
     IOLogInfo("%s: Found %d sticks", __func__, f17.query.number_of_sticks + 1);
 
-    f17.sticks = reinterpret_cast<rmi_f17_stick_data*>(IOMalloc((f17.query.number_of_sticks + 1) * sizeof(struct rmi_f17_stick_data)));
+    f17.sticks = arena.alloc<rmi_f17_stick_data>(f17.query.number_of_sticks + 1);
     if (!f17.sticks) {
         IOLogError("%s: Failed to allocate per stick data", __func__);
         return -1;
     }
-    bzero(f17.sticks, (f17.query.number_of_sticks + 1) * sizeof(struct rmi_f17_stick_data));
 
     next_query_reg += sizeof(f17.query.regs);
 
@@ -213,55 +206,63 @@ int F17::config() {
     return retval;
 }
 
-int F17::rmi_f17_process_stick(struct rmi_f17_stick_data *stick) {
+int F17::rmi_f17_process_stick(struct rmi_f17_stick_data *stick, AbsoluteTime time) {
     int retval = 0;
-    const RmiConfiguration &conf = getConfiguration();
+    const RmiConfiguration conf = getConfiguration();
     RMITrackpointReport report;
+    RmiReadRange ranges[3];
+    size_t count = 0;
     
+    // abs, rel and gesture registers are usually back to back, read them together
     if (stick->query.general.has_absolute) {
-        retval = readBlock(stick->data.abs.address,
+        ranges[count++] = {stick->data.abs.address,
                            stick->data.abs.regs,
-                           sizeof(stick->data.abs.regs));
-        if (retval < 0) {
-            IOLogError("%s: Failed to read abs data for stick %d, code %d", __func__, stick->index, retval);
-        } else {
-            IOLogDebug("%s: Reporting x_force_high: %d, x_force_low: %d, y_force_high: %d, y_force_low: %d, z_force: %d\n",
-                       __func__,
-                       stick->data.abs.x_force_high,
-                       stick->data.abs.x_force_low,
-                       stick->data.abs.y_force_high,
-                       stick->data.abs.y_force_low,
-                       stick->data.abs.z_force);
-        }
+                           sizeof(stick->data.abs.regs)};
     }
-
-    if (stick->query.general.has_relative && !retval) {
-        retval = readBlock(stick->data.rel.address,
+    
+    if (stick->query.general.has_relative) {
+        ranges[count++] = {stick->data.rel.address,
                            stick->data.rel.regs,
-                           sizeof(stick->data.rel.regs));
-        if (retval < 0) {
-            IOLogError("%s: Failed to read rel data for stick %d, code %d", __func__, stick->index, retval);
-        } else {
-            IOLogDebug("%s: Reporting dx: %d, dy: %d\n", __func__, stick->data.rel.x_delta, stick->data.rel.y_delta);
+                           sizeof(stick->data.rel.regs)};
+    }
+    
+    if (stick->query.general.has_gestures) {
+        ranges[count++] = {stick->data.gestures.address,
+                           stick->data.gestures.regs,
+                           sizeof(stick->data.gestures.regs)};
+    }
+    
+    retval = readBlocks(ranges, count);
+    if (retval < 0) {
+        IOLogError("%s: Failed to read data for stick %d, code %d", __func__, stick->index, retval);
+        return retval;
+    }
+    
+    markLatency(RMI_LATENCY_DATA_READ);
+    
+    if (stick->query.general.has_absolute) {
+        IOLogDebug("%s: Reporting x_force_high: %d, x_force_low: %d, y_force_high: %d, y_force_low: %d, z_force: %d\n",
+                   __func__,
+                   stick->data.abs.x_force_high,
+                   stick->data.abs.x_force_low,
+                   stick->data.abs.y_force_high,
+                   stick->data.abs.y_force_low,
+                   stick->data.abs.z_force);
+    }
 
-            report.dx = (SInt32)((SInt64)stick->data.rel.x_delta * conf.trackpointMult / DEFAULT_MULT);
-            report.dy = -(SInt32)((SInt64)stick->data.rel.y_delta * conf.trackpointMult / DEFAULT_MULT);
-            report.buttons = 0;
+    if (stick->query.general.has_relative) {
+        IOLogDebug("%s: Reporting dx: %d, dy: %d\n", __func__, stick->data.rel.x_delta, stick->data.rel.y_delta);
 
-            handleReport(&report);
-        }
+        report.dx = (SInt32)((SInt64)stick->data.rel.x_delta * conf.trackpointMult / DEFAULT_MULT);
+        report.dy = -(SInt32)((SInt64)stick->data.rel.y_delta * conf.trackpointMult / DEFAULT_MULT);
+        report.buttons = 0;
+        report.timestamp = time;
+
+        handleReport(&report);
     }
 
-    if (stick->query.general.has_gestures && !retval) {
-        retval = readBlock(stick->data.gestures.address,
-                           stick->data.gestures.regs,
-                           sizeof(stick->data.gestures.regs));
-        if (retval < 0) {
-            IOLogError("%s: Failed to read gestures for stick %d, code %d", __func__,
-                stick->index, retval);
-        } else {
-            IOLogDebug("%s: Reporting gesture: %d\n", __func__, stick->data.gestures.regs[0]);
-        }
+    if (stick->query.general.has_gestures) {
+        IOLogDebug("%s: Reporting gesture: %d\n", __func__, stick->data.gestures.regs[0]);
     }
 
     return retval;
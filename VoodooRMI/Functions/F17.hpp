@@ -149,8 +149,7 @@ class F17 : public RMITrackpointFunction {
     
 public:
     bool attach(IOService *provider) override;
-    void free() override;
-    void attention() override;
+    void attention(AbsoluteTime time, RmiAttention *attention) override;
     
     IOReturn config() override;
 private:
@@ -158,7 +157,7 @@ private:
 
     int rmi_f17_init_stick(struct rmi_f17_stick_data *stick, UInt16 *next_query_reg, UInt16 *next_data_reg, UInt16 *next_control_reg);
     int rmi_f17_initialize();
-    int rmi_f17_process_stick(struct rmi_f17_stick_data *stick);
+    int rmi_f17_process_stick(struct rmi_f17_stick_data *stick, AbsoluteTime time);
 };
 
 #endif /* F17_hpp */
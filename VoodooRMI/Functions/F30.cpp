@@ -75,14 +75,13 @@ int F30::initialize()
     int error;
 
     query_regs_size = RMI_F30_QUERY_SIZE;
-    query_regs = reinterpret_cast<uint8_t *>(IOMalloc(query_regs_size * sizeof(uint8_t)));
+    query_regs = arena.alloc<uint8_t>(query_regs_size);
     if (!query_regs) {
         IOLogError("%s - Failed to allocate %d query registers", getName(), query_regs_size);
         return -1;
     }
-    bzero(query_regs, query_regs_size * sizeof(uint8_t));
 
-    error = readBlock(getQryAddr(),
+    error = readCapability(getQryAddr(),
                       query_regs, RMI_F30_QUERY_SIZE);
     if (error) {
         IOLogError("%s: Failed to read query register: %d", getName(), error);
@@ -117,16 +116,15 @@ int F30::initialize()
     // get correct ctrl_regs_size only
     rmi_f30_calc_ctrl_data();
 
-    ctrl_regs = reinterpret_cast<uint8_t *>(IOMalloc(ctrl_regs_size * sizeof(uint8_t)));
+    ctrl_regs = arena.alloc<uint8_t>(ctrl_regs_size);
     if (!ctrl_regs) {
         IOLogError("%s - Failed to allocate %d control registers", getName(), ctrl_regs_size);
         return -1;
     }
-    bzero(ctrl_regs, ctrl_regs_size * sizeof(uint8_t));
 
     rmi_f30_calc_ctrl_data();
 
-    error = readBlock(getCtrlAddr(), ctrl_regs, ctrl_regs_size);
+    error = readCapability(getCtrlAddr(), ctrl_regs, ctrl_regs_size);
     if (error) {
         IOLogError("%s - Failed to read control registers: %d", getName(), error);
         return error;
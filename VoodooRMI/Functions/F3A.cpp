@@ -18,7 +18,7 @@ int F3A::initialize()
     IOReturn error;
     uint8_t temp;
 
-    error = readByte(getQryAddr(), &temp);
+    error = readCapability(getQryAddr(), &temp, 1);
     if (error != kIOReturnSuccess) {
         IOLogError("%s - Failed to read general info register: %d", getName(), error);
         return error;
@@ -30,29 +30,27 @@ int F3A::initialize()
     query_regs_size = register_count + 1;
     ctrl_regs_size = register_count + 1;
 
-    query_regs = reinterpret_cast<uint8_t *>(IOMalloc(query_regs_size * sizeof(uint8_t)));
+    query_regs = arena.alloc<uint8_t>(query_regs_size);
     if (!query_regs) {
         IOLogError("%s - Failed to allocate %d query registers", getName(), query_regs_size);
         return -1;
     }
-    bzero(query_regs, query_regs_size * sizeof(uint8_t));
 
-    ctrl_regs = reinterpret_cast<uint8_t *>(IOMalloc(ctrl_regs_size * sizeof(uint8_t)));
+    ctrl_regs = arena.alloc<uint8_t>(ctrl_regs_size);
     if (!ctrl_regs) {
         IOLogError("%s - Failed to allocate %d control registers", getName(), ctrl_regs_size);
         return -1;
     }
-    bzero(ctrl_regs, ctrl_regs_size * sizeof(uint8_t));
 
     /* Query1 -> gpio exist */
-    error = readBlock(getQryAddr(), query_regs, query_regs_size);
+    error = readCapability(getQryAddr(), query_regs, query_regs_size);
     if (error != kIOReturnSuccess) {
         IOLogError("%s - Failed to read query1 registers: %d", getName(), error);
         return error;
     }
 
     /* Ctrl1 -> gpio direction */
-    error = readBlock(getCtrlAddr(), ctrl_regs, ctrl_regs_size);
+    error = readCapability(getCtrlAddr(), ctrl_regs, ctrl_regs_size);
     if (error) {
         IOLogError("%s - Failed to read control registers: %d", getName(), error);
         return error;
@@ -33,9 +33,16 @@ bool RMIFunction::start(IOService *provider) {
         return false;
     }
     
+    setProperty("Allocated Memory", arena.getReserved(), 32);
+    
     PMinit();
     provider->joinPMtree(this);
     registerPowerDriver(this, RMIPowerStates, 2);
     registerService();
     return true;
 }
+
+void RMIFunction::free() {
+    arena.release();
+    IOService::free();
+}
@@ -8,6 +8,8 @@
 #include <IOKit/IOLib.h>
 #include <IOKit/IOService.h>
 #include "RMIBus.hpp"
+#include "RMIArena.h"
+#include "RMIRepeatFilter.h"
 #include "RMIPowerStates.h"
 
 // macOS kernel/math has absolute value in it. It's only for doubles though
@@ -48,35 +50,86 @@ public:
     virtual bool init(RmiPdtEntry &pdtEntry);
     virtual bool attach(IOService *provider) override;
     virtual bool start(IOService *provider) override;
+    virtual void free() override;
     
     bool hasAttnSig(const UInt32 irq) const;
+    inline UInt32 getIrqMask() const { return pdtEntry.irqMask; }
     
     // Methods to override
     // Config happens after start and is where control registers should be set
     virtual IOReturn config() { return kIOReturnSuccess; };
     // Attention is called whenever this function has data. Any input data
-    // should be read here.
-    virtual void attention() { };
+    // should be read here. If the transport pushed an attention report, the
+    // function's data should be taken from it instead of reading registers.
+    // Reports should be stamped with time, when the interrupt arrived.
+    virtual void attention(AbsoluteTime time, RmiAttention *attention) { };
+    // Called from the bus's stats timer, properties should be set here rather
+    // than while handling a report
+    virtual void publishStats() { };
 private:
     RmiPdtEntry pdtEntry;
     RMIBus *bus {nullptr};
     
 protected:
+    // Memory kept until the function is freed should be allocated from here in attach
+    RMIArena arena;
     
     // Useful functions to talk to RMI4 devicce
     inline void sendVoodooInputPacket(UInt32 msg, void *packet) {
         IOService *vi = bus->getVoodooInput();
         if (vi != nullptr) {
+            markLatency(RMI_LATENCY_REPORT);
             vi->message(msg, bus, packet);
+            markLatency(RMI_LATENCY_DELIVERED);
         }
     }
     inline const RmiGpioData &getGPIOData() const { return bus->getGPIOData(); }
-    inline const RmiConfiguration &getConfiguration() const { return bus->getConfiguration(); }
+    inline RmiConfiguration getConfiguration() const { return bus->getConfiguration(); }
+    // Use for anything reported or compared against report times outside of
+    // attention, see RMIClock
+    inline AbsoluteTime getTimestamp() const { return bus->getTimestamp(); }
+    // Call once input data has been read in attention, see RMILatencyStats
+    inline void markLatency(RmiLatencyStage stage) const { bus->markLatency(stage); }
     inline IOReturn readByte(UInt16 addr, UInt8 *buf) const { return bus->read(addr, buf); }
     inline IOReturn writeByte(UInt16 addr, UInt8 *buf) const { return bus->write(addr, buf); }
     inline IOReturn readBlock(UInt16 addr, UInt8 *buf, size_t size) const {
         return bus->readBlock(addr, buf, size);
     }
+    inline IOReturn readBlocks(const RmiReadRange *ranges, size_t count) const {
+        return bus->readBlocks(ranges, count);
+    }
+    // Query registers and firmware set up control registers, see RMICapabilityCache
+    inline IOReturn readCapability(UInt16 addr, UInt8 *buf, size_t size) const {
+        return bus->readCapability(addr, buf, size);
+    }
+    // Reads done on every attention should be prepared in config()
+    inline int prepareRead(UInt16 addr, size_t size) const { return bus->prepareRead(addr, size); }
+    inline IOReturn readPrepared(int handle, UInt16 addr, UInt8 *buf, size_t size) const {
+        // Not every transport supports prepared reads
+        if (handle < 0)
+            return bus->readBlock(addr, buf, size);
+        
+        return bus->readPrepared(handle, buf, size);
+    }
+    // Handles must be released before preparing the read again and when stopping
+    inline void releaseRead(int &handle) const {
+        if (handle >= 0)
+            bus->releaseRead(handle);
+        handle = -1;
+    }
+    // 0 if reading part of a prepared range is no cheaper than reading all of it
+    inline size_t getPreparedReadBlockSize() const { return bus->getPreparedReadBlockSize(); }
+    // Take this function's packed data off the front of an attention report,
+    // returns how many bytes were available
+    inline size_t readAttention(RmiAttention *attention, UInt8 *buf, size_t size) const {
+        if (size > attention->size)
+            size = attention->size;
+        
+        memcpy(buf, attention->data, size);
+        attention->data += size;
+        attention->size -= size;
+        return size;
+    }
     inline IOReturn writeBlock(UInt16 addr, UInt8 *buf, size_t size) const {
         return bus->blockWrite(addr, buf, size);
     }
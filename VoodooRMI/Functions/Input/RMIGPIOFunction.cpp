@@ -33,8 +33,26 @@ bool RMIGPIOFunction::attach(IOService *provider)
     return true;
 }
 
+void RMIGPIOFunction::stop(IOService *provider)
+{
+    releaseRead(data_read_handle);
+    super::stop(provider);
+}
+
+void RMIGPIOFunction::publishStats()
+{
+    if (repeatFilter.isPublishDue())
+        setProperty("Suppressed Packets", repeatFilter.getSuppressed(), 64);
+}
+
 IOReturn RMIGPIOFunction::config()
 {
+    // Config runs again after a reset or wake, resend the buttons after it
+    repeatFilter.reset();
+    releaseRead(data_read_handle);
+    if (has_gpio)
+        data_read_handle = prepareRead(getDataAddr(), register_count);
+    
     /* Write Control Register values back to device */
     int error = writeBlock(getCtrlAddr(),
                            ctrl_regs, ctrl_regs_size);
@@ -51,12 +69,11 @@ int RMIGPIOFunction::mapGpios()
     if (!has_gpio)
         return -1;
 
-    data_regs = reinterpret_cast<uint8_t *>(IOMalloc(register_count * sizeof(uint8_t)));
+    data_regs = arena.alloc<uint8_t>(register_count);
     if (!data_regs) {
         IOLogError("%s - Failed to allocate %d data registers", getName(), register_count);
         return -1;
     }
-    bzero(data_regs, register_count * sizeof(uint8_t));
 
     unsigned int button = BTN_LEFT;
     unsigned int trackpoint_button = BTN_LEFT;
@@ -64,12 +81,11 @@ int RMIGPIOFunction::mapGpios()
     const RmiGpioData &gpio = getGPIOData();
     setProperty("Button Count", buttonArrLen, 32);
 
-    gpioled_key_map = reinterpret_cast<uint16_t *>(IOMalloc(buttonArrLen * sizeof(uint16_t)));
+    gpioled_key_map = arena.alloc<uint16_t>(buttonArrLen);
     if (!gpioled_key_map) {
         IOLogError("%s - Failed to allocate %d gpioled map memory", getName(), buttonArrLen);
         return -1;
     }
-    bzero(gpioled_key_map, buttonArrLen * sizeof(gpioled_key_map[0]));
 
     for (int i = 0; i < buttonArrLen; i++) {
         if (!is_valid_button(i))
@@ -96,20 +112,28 @@ int RMIGPIOFunction::mapGpios()
     return 0;
 }
 
-void RMIGPIOFunction::attention()
+void RMIGPIOFunction::attention(AbsoluteTime time, RmiAttention *attention)
 {
-    int error = readBlock(getDataAddr(),
-                          data_regs, register_count);
+    if (attention) {
+        if (readAttention(attention, data_regs, register_count) < register_count) {
+            IOLogError("%s data missing from attention report", getName());
+            return;
+        }
+    } else {
+        int error = readPrepared(data_read_handle, getDataAddr(),
+                                 data_regs, register_count);
 
-    if (error < 0) {
-        IOLogError("Could not read %s data: %d", getName(), error);
+        if (error < 0) {
+            IOLogError("Could not read %s data: %d", getName(), error);
+        }
     }
 
+    markLatency(RMI_LATENCY_DATA_READ);
     if (has_gpio)
-        reportButton();
+        reportButton(time);
 }
 
-void RMIGPIOFunction::reportButton()
+void RMIGPIOFunction::reportButton(AbsoluteTime timestamp)
 {
     TrackpointReport relativeEvent {};
     unsigned int mask, trackpointBtns = 0, btns = 0;
@@ -150,25 +174,18 @@ void RMIGPIOFunction::reportButton()
     }
 
     if (numButtons > 1) {
-        AbsoluteTime timestamp;
-        clock_get_uptime(&timestamp);
+        UInt64 keepAlive = (UInt64) getConfiguration().repeatKeepAlive * MILLI_TO_NANO;
 
         relativeEvent.dx = relativeEvent.dy = 0;
         relativeEvent.buttons = btns;
         relativeEvent.timestamp = timestamp;
-        sendVoodooInputPacket(kIOMessageVoodooTrackpointRelativePointer, &relativeEvent);
+
+        // Buttons are all that changes, there's no motion
+        if (repeatFilter.shouldSend(btns, timestamp, keepAlive))
+            sendVoodooInputPacket(kIOMessageVoodooTrackpointRelativePointer, &relativeEvent);
     }
 
     if (hasTrackpointButtons) {
         notify(kHandleRMITrackpointButton, reinterpret_cast<void *>(trackpointBtns));
     }
 }
-
-void RMIGPIOFunction::free() {
-    IOFree(gpioled_key_map, min(gpioled_count, TRACKPOINT_RANGE_END) * sizeof(uint16_t));
-    IOFree(query_regs, query_regs_size * sizeof(uint8_t));
-    IOFree(ctrl_regs, ctrl_regs_size * sizeof(uint8_t));
-    IOFree(data_regs, register_count * sizeof(uint8_t));
-
-    super::free();
-}
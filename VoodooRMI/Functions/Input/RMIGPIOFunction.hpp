@@ -17,9 +17,10 @@ class RMIGPIOFunction : public RMIFunction {
 
 public:
     bool attach(IOService *provider) override;
+    void stop(IOService *provider) override;
     IOReturn config() override;
-    void attention() override;
-    void free() override;
+    void attention(AbsoluteTime time, RmiAttention *attention) override;
+    void publishStats() override;
 
 protected:
     uint8_t *query_regs {nullptr};
@@ -29,6 +30,7 @@ protected:
     uint8_t *data_regs {nullptr};
 
     UInt8 register_count {0};
+    int data_read_handle {-1};
     UInt8 gpioled_count {0};
     UInt16 *gpioled_key_map {nullptr};
 
@@ -37,12 +39,14 @@ protected:
     UInt8 clickpadIndex {0};
     bool clickpadState {false};
     bool hasTrackpointButtons {false};
+    
+    RMIRepeatFilter<UInt32> repeatFilter;
 
     virtual inline int initialize() {return -1;};
     virtual inline bool is_valid_button(int button) {return false;};
 
     int mapGpios();
-    void reportButton();
+    void reportButton(AbsoluteTime timestamp);
 };
 
 #endif /* RMIGPIOFunction_hpp */
@@ -20,7 +20,6 @@ OSDefineMetaClassAndStructors(RMITrackpadFunction, RMIFunction)
 #define RMI_2D_MIN_ZONE_VEL 10
 #define RMI_2D_MIN_ZONE_Y_VEL 6
 #define RMI_MT2_MAX_PRESSURE 255
-#define cfgToPercent(val) ((double) val / 100.0)
 
 static void fillZone (RMI2DSensorZone *zone, int min_x, int min_y, int max_x, int max_y) {
     zone->x_min = min_x;
@@ -46,43 +45,62 @@ bool RMITrackpadFunction::start(IOService *provider)
         fingerState[i] = RMI_FINGER_LIFTED;
     }
     
-    const RmiConfiguration &conf = getConfiguration();
-    const int palmRejectWidth = data.maxX * cfgToPercent(conf.palmRejectionWidth);
-    const int palmRejectHeight = data.maxY * cfgToPercent(conf.palmRejectionHeight);
-    const int trackpointRejectHeight = data.maxY * cfgToPercent(conf.palmRejectionHeightTrackpoint);
+    compileConfiguration();
     
-    /*
-     * Calculate reject zones.
-     * These zones invalidate any fingers within them when typing
-     * or using the trackpoint. 0, 0 is top left
-     */
+    // VoodooPS2 keyboard notifs
+    setProperty("RM,deliverNotifications", kOSBooleanTrue);
+    
+    for (int i = 0; i < MAX_FINGERS; i++) {
+        auto& transducer = transducers[i];
+        transducer.secondaryId = i;
+        transducer.type = FINGER;
+        transducer.supportsPressure = true;
+        transducer.isValid = 1;
+    }
+    
+    return super::start(provider);
+}
+
+/*
+ * Reject zones invalidate any fingers within them when typing or using
+ * the trackpoint. 0, 0 is top left
+ */
+void RMITrackpadFunction::compileConfiguration()
+{
+    const RmiConfiguration conf = getConfiguration();
+    RmiTrackpadConfig config {};
+    
+    const int palmRejectWidth = cfgPercentOf(data.maxX, conf.palmRejectionWidth);
+    const int palmRejectHeight = cfgPercentOf(data.maxY, conf.palmRejectionHeight);
+    const int trackpointRejectHeight = cfgPercentOf(data.maxY, conf.palmRejectionHeightTrackpoint);
     
     // Top left
-    fillZone(&rejectZones[0],
+    fillZone(&config.rejectZones[0],
              0, 0,
              palmRejectWidth, palmRejectHeight);
     
     // Top right
-    fillZone(&rejectZones[1],
+    fillZone(&config.rejectZones[1],
              data.maxX - palmRejectWidth, 0,
              data.maxX, palmRejectHeight);
 
     // Top band for trackpoint and buttons
-    fillZone(&rejectZones[2],
+    fillZone(&config.rejectZones[2],
              0, 0,
              data.maxX, trackpointRejectHeight);
     
-    // VoodooPS2 keyboard notifs
-    setProperty("RM,deliverNotifications", kOSBooleanTrue);
+    config.typingTimeout = conf.disableWhileTypingTimeout * MILLI_TO_NANO;
+    config.trackpointTimeout = conf.disableWhileTrackpointTimeout * MILLI_TO_NANO;
+    config.minYDiffGesture = conf.minYDiffGesture;
+    config.maxObjWidth = conf.palmRejectionMaxObjWidth;
+    config.maxObjHeight = conf.palmRejectionMaxObjHeight;
+    config.forceTouchEnabled = conf.forceTouchType == RMI_FT_CLICK_AND_SIZE ||
+                               conf.forceTouchType == RMI_FT_SIZE;
+    config.forceTouchNeedsClick = conf.forceTouchType == RMI_FT_CLICK_AND_SIZE;
+    config.forceTouchMinPressure = conf.forceTouchMinPressure;
+    config.repeatKeepAlive = (UInt64) conf.repeatKeepAlive * MILLI_TO_NANO;
     
-    for (int i = 0; i < VOODOO_INPUT_MAX_TRANSDUCERS; i++) {
-        auto& transducer = inputEvent.transducers[i];
-        transducer.type = FINGER;
-        transducer.supportsPressure = true;
-        transducer.isValid = 1;
-    }
-    
-    return super::start(provider);
+    trackpadConfig.publish(config);
 }
 
 IOReturn RMITrackpadFunction::message(UInt32 type, IOService *provider, void *argument)
@@ -93,11 +111,12 @@ IOReturn RMITrackpadFunction::message(UInt32 type, IOService *provider, void *ar
             clickpadState = !!(argument);
             break;
         case kHandleRMITrackpoint:
-            uint64_t timestamp;
-            clock_get_uptime(&timestamp);
-            absolutetime_to_nanoseconds(timestamp, &lastTrackpointTS);
+            absolutetime_to_nanoseconds(getTimestamp(), &lastTrackpointTS);
             invalidateFingers();
             break;
+        case kHandleRMIConfigurationChanged:
+            compileConfiguration();
+            break;
         // VoodooPS2 Messages
         case kKeyboardKeyPressTime:
             lastKeyboardTS = *((uint64_t*) argument);
@@ -110,6 +129,7 @@ IOReturn RMITrackpadFunction::message(UInt32 type, IOService *provider, void *ar
         }
         case kKeyboardSetTouchStatus:
             trackpadEnable = *((bool *) argument);
+            repeatFilter.reset();
             break;
     }
     
@@ -122,10 +142,10 @@ bool RMITrackpadFunction::shouldDiscardReport(AbsoluteTime timestamp)
 }
 
 // Returns zone that finger is in (or 0 if not in a zone)
-size_t RMITrackpadFunction::checkInZone(VoodooInputTransducer &obj) {
+size_t RMITrackpadFunction::checkInZone(const RmiTrackpadConfig &config, VoodooInputTransducer &obj) {
     TouchCoordinates &fingerCoords = obj.currentCoordinates;
     for (size_t i = 0; i < 3; i++) {
-        RMI2DSensorZone &zone = rejectZones[i];
+        const RMI2DSensorZone &zone = config.rejectZones[i];
         if (fingerCoords.x >= zone.x_min &&
             fingerCoords.x <= zone.x_max &&
             fingerCoords.y >= zone.y_min &&
@@ -148,24 +168,24 @@ size_t RMITrackpadFunction::checkInZone(VoodooInputTransducer &obj) {
 void RMITrackpadFunction::handleReport(RMI2DSensorReport *report)
 {
     int validFingerCount = 0;
-    const RmiConfiguration &conf = getConfiguration();
+    const RmiTrackpadConfig config = trackpadConfig.get();
     
-    bool discardRegions = ((report->timestamp - lastKeyboardTS) < (conf.disableWhileTypingTimeout * MILLI_TO_NANO)) ||
-                          ((report->timestamp - lastTrackpointTS) < (conf.disableWhileTrackpointTimeout * MILLI_TO_NANO));
+    bool discardRegions = ((report->timestamp - lastKeyboardTS) < config.typingTimeout) ||
+                          ((report->timestamp - lastTrackpointTS) < config.trackpointTimeout);
     
     size_t maxIdx = report->fingers > MAX_FINGERS ? MAX_FINGERS : report->fingers;
     for (int i = 0; i < maxIdx; i++) {
-        rmi_2d_sensor_abs_object obj = report->objs[i];
+        UInt8 type = report->type[i];
+        UInt8 z = report->z[i];
         
-        bool isValidObj = obj.type == RMI_2D_OBJECT_FINGER ||
-                          obj.type == RMI_2D_OBJECT_STYLUS ||
+        bool isValidObj = type == RMI_2D_OBJECT_FINGER ||
+                          type == RMI_2D_OBJECT_STYLUS ||
                           // Allow inaccurate objects as they are likely invalid, which we want to track still
                           // This can be a random finger or one which was lifted up slightly
-                          obj.type == RMI_2D_OBJECT_INACCURATE;
+                          type == RMI_2D_OBJECT_INACCURATE;
         
-        auto& transducer = inputEvent.transducers[i];
+        auto& transducer = transducers[i];
         transducer.isTransducerActive = isValidObj;
-        transducer.secondaryId = i;
         
         // Finger lifted, make finger valid
         if (!isValidObj) {
@@ -177,11 +197,11 @@ void RMITrackpadFunction::handleReport(RMI2DSensorReport *report)
             
         transducer.isTransducerActive = true;
         transducer.previousCoordinates = transducer.currentCoordinates;
-        transducer.currentCoordinates.width = obj.z / 2.0;
+        transducer.currentCoordinates.width = zToWidth(z);
         transducer.timestamp = report->timestamp;
         
-        transducer.currentCoordinates.x = obj.x;
-        transducer.currentCoordinates.y = data.maxY - obj.y;
+        transducer.currentCoordinates.x = report->x[i];
+        transducer.currentCoordinates.y = data.maxY - report->y[i];
         
         switch (fingerState[i]) {
             case RMI_FINGER_LIFTED:
@@ -191,7 +211,7 @@ void RMITrackpadFunction::handleReport(RMI2DSensorReport *report)
                 
                 /* fall through */
             case RMI_FINGER_STARTED_IN_ZONE: {
-                size_t zone = checkInZone(transducer);
+                size_t zone = checkInZone(config, transducer);
                 if (zone == 0) {
                     fingerState[i] = RMI_FINGER_VALID;
                 }
@@ -207,10 +227,10 @@ void RMITrackpadFunction::handleReport(RMI2DSensorReport *report)
             }
                 /* fall through */
             case RMI_FINGER_VALID:
-                if (obj.z > RMI_2D_MAX_Z ||
-                    obj.wx > conf.palmRejectionMaxObjWidth ||
-                    obj.wy > conf.palmRejectionMaxObjHeight ||
-                    obj.type == RMI_2D_OBJECT_INACCURATE) {
+                if (z > RMI_2D_MAX_Z ||
+                    report->wx[i] > config.maxObjWidth ||
+                    report->wy[i] > config.maxObjHeight ||
+                    type == RMI_2D_OBJECT_INACCURATE) {
                     
                     fingerState[i] = RMI_FINGER_INVALID;
                 }
@@ -218,13 +238,13 @@ void RMITrackpadFunction::handleReport(RMI2DSensorReport *report)
                 // Force touch emulation only works with clickpads (button underneath trackpad)
                 // Lock finger in place and in force touch until lifted
                 // Checks for VALID input before registering as force touch
-                if (isForceTouch(obj.z) && fingerState[i] == RMI_FINGER_VALID) {
+                if (isForceTouch(config, z) && fingerState[i] == RMI_FINGER_VALID) {
                     fingerState[i] = RMI_FINGER_FORCE_TOUCH;
                 }
                 
                 break;
             case RMI_FINGER_FORCE_TOUCH:
-                if (!isForceTouch(obj.z)) {
+                if (!isForceTouch(config, z)) {
                     fingerState[i] = RMI_FINGER_VALID;
                     transducer.currentCoordinates.pressure = 0;
                     break;
@@ -242,21 +262,21 @@ void RMITrackpadFunction::handleReport(RMI2DSensorReport *report)
         IOLogDebug("Finger num: %d (%s) (%d, %d) [Z: %u WX: %u WY: %u FingerType: %d Pressure: %d]",
                    i,
                    fingerState[i] != RMI_FINGER_INVALID ? "valid" : "invalid",
-                   obj.x, obj.y, obj.z, obj.wx, obj.wy,
+                   report->x[i], report->y[i], z, report->wx[i], report->wy[i],
                    transducer.fingerType,
                    transducer.currentCoordinates.pressure
                    );
     }
     
     if (validFingerCount >= 4 && freeFingerTypes[kMT2FingerTypeThumb]) {
-        setThumbFingerType(maxIdx, report);
+        setThumbFingerType(config, maxIdx, report);
     }
     
     bool isGesture = !discardRegions && validFingerCount > 2;
     
     // Second loop to get finger type and allow gestures
     for (size_t i = 0; i < maxIdx; i++) {
-        auto& trans = inputEvent.transducers[i];
+        auto& trans = transducers[i];
         
         if (isGesture &&
             fingerState[i] == RMI_FINGER_STARTED_IN_ZONE) {
@@ -279,18 +299,80 @@ void RMITrackpadFunction::handleReport(RMI2DSensorReport *report)
         }
     }
     
+    // Pack active fingers to the front. Ones that went away since the last report
+    // are sent once more as inactive so VoodooInput sees them lift.
+    size_t count = 0;
+    UInt16 activeSlots = 0;
+    for (size_t i = 0; i < MAX_FINGERS; i++) {
+        bool active = i < maxIdx && transducers[i].isTransducerActive;
+        
+        if (active)
+            activeSlots |= 1 << i;
+        else if (!(reportedSlots & (1 << i)))
+            continue;
+        
+        auto &trans = inputEvent.transducers[count++];
+        trans = transducers[i];
+        trans.isTransducerActive = active;
+    }
+    reportedSlots = activeSlots;
+    
+    // The button is read off the first transducer, so there always has to be one
+    if (count == 0) {
+        inputEvent.transducers[0] = transducers[0];
+        inputEvent.transducers[0].isTransducerActive = false;
+        count = 1;
+    }
+    
     inputEvent.transducers[0].isPhysicalButtonDown = clickpadState;
-    inputEvent.contact_count = maxIdx;
+    inputEvent.contact_count = count;
     inputEvent.timestamp = report->timestamp;
     
-    sendVoodooInputPacket(kIOMessageVoodooInputMessage, &inputEvent);
-    for (int i = 0; i < VOODOO_INPUT_MAX_TRANSDUCERS; i++) {
-        inputEvent.transducers[i].isTransducerActive = false;
+    if (!isRepeatedFrame(config))
+        sendVoodooInputPacket(kIOMessageVoodooInputMessage, &inputEvent);
+}
+
+// Same as the last frame sent, and the keep-alive hasn't run out yet
+bool RMITrackpadFunction::isRepeatedFrame(const RmiTrackpadConfig &config)
+{
+    RmiTouchFrameKey key;
+    bool send;
+    
+    memset(&key, 0, sizeof(key));
+    for (size_t i = 0; i < inputEvent.contact_count; i++) {
+        const auto &trans = inputEvent.transducers[i];
+        
+        key.transducers[i].x = trans.currentCoordinates.x;
+        key.transducers[i].y = trans.currentCoordinates.y;
+        key.transducers[i].pressure = trans.currentCoordinates.pressure;
+        key.transducers[i].width = trans.currentCoordinates.width;
+        key.transducers[i].fingerType = trans.fingerType;
+        key.transducers[i].id = trans.secondaryId;
+        key.transducers[i].active = trans.isTransducerActive;
     }
+    
+    key.contactCount = (UInt32) inputEvent.contact_count;
+    key.buttonDown = inputEvent.transducers[0].isPhysicalButtonDown;
+    
+    send = repeatFilter.shouldSend(key, inputEvent.timestamp, config.repeatKeepAlive);
+    return !send;
+}
+
+void RMITrackpadFunction::publishStats()
+{
+    if (repeatFilter.isPublishDue())
+        setProperty("Suppressed Packets", repeatFilter.getSuppressed(), 64);
+}
+
+// Runs again after a reset or wake, when the last frame sent is stale
+IOReturn RMITrackpadFunction::config()
+{
+    repeatFilter.reset();
+    return kIOReturnSuccess;
 }
 
 // Take the most obvious lowest fingers - otherwise take finger with greatest area
-void RMITrackpadFunction::setThumbFingerType(size_t maxIdx, RMI2DSensorReport *report)
+void RMITrackpadFunction::setThumbFingerType(const RmiTrackpadConfig &config, size_t maxIdx, RMI2DSensorReport *report)
 {
     size_t lowestFingerIndex = -1;
     size_t greatestFingerIndex = -1;
@@ -298,11 +380,8 @@ void RMITrackpadFunction::setThumbFingerType(size_t maxIdx, RMI2DSensorReport *r
     UInt32 maxDiff = 0;
     UInt32 maxArea = 0;
     
-    const RmiConfiguration &conf = getConfiguration();
-    
     for (size_t i = 0; i < maxIdx; i++) {
-        auto &trans = inputEvent.transducers[i];
-        rmi_2d_sensor_abs_object *obj = &report->objs[i];
+        auto &trans = transducers[i];
         
         if (!trans.isTransducerActive)
             continue;
@@ -317,14 +396,14 @@ void RMITrackpadFunction::setThumbFingerType(size_t maxIdx, RMI2DSensorReport *r
             secondLowest = trans.currentCoordinates.y;
         }
         
-        if (obj->z > maxArea) {
-            maxDiff = (obj->wy - obj->wx);
-            maxArea = obj->z;
+        if (report->z[i] > maxArea) {
+            maxDiff = (report->wy[i] - report->wx[i]);
+            maxArea = report->z[i];
             greatestFingerIndex = i;
         }
     }
     
-    if (minY - secondLowest < conf.minYDiffGesture || greatestFingerIndex == -1) {
+    if (minY - secondLowest < config.minYDiffGesture || greatestFingerIndex == -1) {
         lowestFingerIndex = greatestFingerIndex;
     }
     
@@ -333,7 +412,7 @@ void RMITrackpadFunction::setThumbFingerType(size_t maxIdx, RMI2DSensorReport *r
         return;
     }
     
-    auto &trans = inputEvent.transducers[lowestFingerIndex];
+    auto &trans = transducers[lowestFingerIndex];
     if (trans.fingerType != kMT2FingerTypeUndefined)
         freeFingerTypes[trans.fingerType] = true;
     
@@ -360,26 +439,24 @@ MT2FingerType RMITrackpadFunction::getFingerType()
  * Used when keyboard or trackpoint send events
  */
 void RMITrackpadFunction::invalidateFingers() {
+    const RmiTrackpadConfig config = trackpadConfig.get();
+    
     for (size_t i = 0; i < MAX_FINGERS; i++) {
-        VoodooInputTransducer &finger = inputEvent.transducers[i];
+        VoodooInputTransducer &finger = transducers[i];
         
         if (fingerState[i] == RMI_FINGER_LIFTED ||
             fingerState[i] == RMI_FINGER_INVALID)
             continue;
         
-        if (checkInZone(finger) > 0)
+        if (checkInZone(config, finger) > 0)
             fingerState[i] = RMI_FINGER_INVALID;
     }
+    
+    repeatFilter.reset();
 }
 
-bool RMITrackpadFunction::isForceTouch(UInt8 pressure) {
-    const RmiConfiguration &conf = getConfiguration();
-    switch (conf.forceTouchType) {
-        case RMI_FT_DISABLE:
-            return false;
-        case RMI_FT_CLICK_AND_SIZE:
-            return clickpadState && pressure > conf.forceTouchMinPressure;
-        case RMI_FT_SIZE:
-            return pressure > conf.forceTouchMinPressure;
-    }
+bool RMITrackpadFunction::isForceTouch(const RmiTrackpadConfig &config, UInt8 pressure) {
+    return config.forceTouchEnabled &&
+           (clickpadState || !config.forceTouchNeedsClick) &&
+           pressure > config.forceTouchMinPressure;
 }
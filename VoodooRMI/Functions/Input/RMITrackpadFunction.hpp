@@ -18,6 +18,14 @@
 
 #define MAX_FINGERS 10
 
+/*
+ * Integer math only, the report path shouldn't touch the FPU. Width is the
+ * same as the double math it replaced. Percentages are exact, where the
+ * double math was one short for some sizes, see Host/Tests/trackpad-math.cpp
+ */
+#define cfgPercentOf(total, val) ((int) (total) * (val) / 100)
+#define zToWidth(z) ((UInt8) ((z) / 2))
+
 enum rmi_2d_sensor_object_type {
     RMI_2D_OBJECT_NONE,
     RMI_2D_OBJECT_FINGER,
@@ -42,17 +50,17 @@ struct Rmi2DSensorData {
     UInt16 maxY;
 };
 
-struct rmi_2d_sensor_abs_object {
-    enum rmi_2d_sensor_object_type type;
-    UInt16 x;
-    UInt16 y;
-    UInt8 z;
-    UInt8 wx;
-    UInt8 wy;
-};
-
+/*
+ * Objects are kept as one array per field, so functions can unpack their
+ * data registers in a loop the compiler vectorizes
+ */
 struct RMI2DSensorReport {
-    rmi_2d_sensor_abs_object objs[10];
+    UInt8 type[MAX_FINGERS]; /* rmi_2d_sensor_object_type */
+    UInt16 x[MAX_FINGERS];
+    UInt16 y[MAX_FINGERS];
+    UInt8 z[MAX_FINGERS];
+    UInt8 wx[MAX_FINGERS];
+    UInt8 wy[MAX_FINGERS];
     size_t fingers;
     AbsoluteTime timestamp;
 };
@@ -64,6 +72,40 @@ struct RMI2DSensorZone {
     UInt16 y_max;
 };
 
+/*
+ * RmiConfiguration compiled against the sensor size, so the report path
+ * only does compares. Timeouts are in ns, zones in device units.
+ */
+struct RmiTrackpadConfig {
+    UInt64 typingTimeout;
+    UInt64 trackpointTimeout;
+    RMI2DSensorZone rejectZones[3];
+    UInt32 minYDiffGesture;
+    UInt8 maxObjWidth;
+    UInt8 maxObjHeight;
+    // Force touch is pressure above forceTouchMinPressure, and the clickpad
+    // being down if forceTouchNeedsClick
+    bool forceTouchEnabled;
+    bool forceTouchNeedsClick;
+    UInt32 forceTouchMinPressure;
+    UInt64 repeatKeepAlive;
+};
+
+// The parts of a VoodooInputEvent that VoodooInput acts on, see RMIRepeatFilter
+struct RmiTouchFrameKey {
+    struct {
+        UInt32 x;
+        UInt32 y;
+        UInt8 pressure;
+        UInt8 width;
+        UInt8 fingerType;
+        UInt8 id;
+        bool active;
+    } transducers[VOODOO_INPUT_MAX_TRANSDUCERS];
+    UInt32 contactCount;
+    bool buttonDown;
+};
+
 /**
  * @axis_align - controls parameters that are useful in system prototyping
  * and bring up.
@@ -78,6 +120,8 @@ class RMITrackpadFunction : public RMIFunction {
 public:
     bool start(IOService *provider) override;
     IOReturn message(UInt32 type, IOService *provider, void *argument = 0) override;
+    IOReturn config() override;
+    void publishStats() override;
     
     const Rmi2DSensorData &getData() const;
     
@@ -92,21 +136,34 @@ protected:
     void setData(const Rmi2DSensorData &data);
 private:
     VoodooInputEvent inputEvent {};
-    RMI2DSensorZone rejectZones[3];
     Rmi2DSensorData data;
     
+    // One per sensor slot, secondaryId is the slot. inputEvent only gets the
+    // ones in use, reportedSlots being those sent active last time.
+    VoodooInputTransducer transducers[MAX_FINGERS] {};
+    UInt16 reportedSlots {0};
+    
+    // Reports never wait on a configuration change. Only the bus command
+    // gate (or start) publishes
+    RmiVersionedStore<RmiTrackpadConfig> trackpadConfig {};
+    
+    void compileConfiguration();
+    
     bool freeFingerTypes[kMT2FingerTypeCount];
     finger_state fingerState[MAX_FINGERS];
     bool clickpadState {false};
     bool trackpadEnable {true};
     
     uint64_t lastKeyboardTS {0}, lastTrackpointTS {0};
+    
+    RMIRepeatFilter<RmiTouchFrameKey> repeatFilter;
+    bool isRepeatedFrame(const RmiTrackpadConfig &config);
 
     MT2FingerType getFingerType();
-    size_t checkInZone(VoodooInputTransducer &obj);
-    void setThumbFingerType(size_t fingers, RMI2DSensorReport *report);
+    size_t checkInZone(const RmiTrackpadConfig &config, VoodooInputTransducer &obj);
+    void setThumbFingerType(const RmiTrackpadConfig &config, size_t fingers, RMI2DSensorReport *report);
     void invalidateFingers();
-    bool isForceTouch(UInt8 pressure);
+    bool isForceTouch(const RmiTrackpadConfig &config, UInt8 pressure);
 };
 
 #endif /* RMITrackpadFunction_hpp */
@@ -9,14 +9,11 @@
 OSDefineMetaClassAndStructors(RMITrackpointFunction, RMIFunction)
 
 void RMITrackpointFunction::handleReport(RMITrackpointReport *report) {
-    AbsoluteTime timestamp;
-    clock_get_uptime(&timestamp);
-    
     TrackpointReport trackpointReport;
     trackpointReport.dx = report->dx;
     trackpointReport.dy = report->dy;
     trackpointReport.buttons = report->buttons | overwrite_buttons;
-    trackpointReport.timestamp = timestamp;
+    trackpointReport.timestamp = report->timestamp;
     
     sendVoodooInputPacket(kIOMessageVoodooTrackpointMessage, &trackpointReport);
     if (report->dx || report->dy) {
@@ -31,6 +28,7 @@ IOReturn RMITrackpointFunction::message(UInt32 type, IOService *provider, void *
         case kHandleRMITrackpointButton:
             // This message originates in RMIBus::Notify, which sends an unsigned int
             overwrite_buttons = (unsigned int)((intptr_t) argument);
+            emptyReport.timestamp = getTimestamp();
             handleReport(&emptyReport);
             break;
     }
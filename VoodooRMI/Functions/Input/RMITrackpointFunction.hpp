@@ -12,6 +12,7 @@ struct RMITrackpointReport {
     SInt32 dx;
     SInt32 dy;
     UInt32 buttons;
+    AbsoluteTime timestamp;
 };
 
 class RMITrackpointFunction : public RMIFunction {
@@ -101,11 +101,13 @@
 /* Power on Self Test Results */
 #define TP_POR_SUCCESS        0x3B
 
+// Indexed by TP_VARIANT_*. Array designators are a clang extension in C++
 static const char * const trackpoint_variants[] = {
-    [TP_VARIANT_IBM]    = "IBM",
-    [TP_VARIANT_ALPS]   = "ALPS",
-    [TP_VARIANT_ELAN]   = "Elan",
-    [TP_VARIANT_NXP]    = "NXP",
+    nullptr,
+    "IBM",      /* TP_VARIANT_IBM */
+    "ALPS",     /* TP_VARIANT_ALPS */
+    "Elan",     /* TP_VARIANT_ELAN */
+    "NXP",      /* TP_VARIANT_NXP */
 };
 
 #endif /* PS2_h */
@@ -56,12 +56,36 @@ bool RMIBus::start(IOService *provider) {
         return false;
     }
     
+    statsTimer = IOTimerEventSource::timerEventSource(this, OSMemberFunctionCast(IOTimerEventSource::Action, this, &RMIBus::publishStats));
+    if (statsTimer == nullptr || workLoop->addEventSource(statsTimer) != kIOReturnSuccess) {
+        IOLogInfo("Could not add stats timer, not publishing stats");
+        OSSafeReleaseNULL(statsTimer);
+    }
+    
     // GPIO data from VoodooPS2
     if (OSObject *object = transport->getProperty("GPIO Data")) {
         OSDictionary *dict = OSDynamicCast(OSDictionary, object);
         getGPIOData(dict);
     }
     
+    // Everything from here on goes through the recorder when tracing
+    if (OSNumber *traceSize = OSDynamicCast(OSNumber, getProperty(RMITraceBufferSize))) {
+        if (traceSize->unsigned32BitValue() > 0) {
+            traceRecorder = RMITraceRecorder::withTransport(transport, traceSize->unsigned32BitValue() * 1024);
+            if (traceRecorder != nullptr)
+                transport = traceRecorder;
+        }
+    }
+    
+    // Capabilities recorded on a previous boot let functions skip querying the device
+    if (OSBoolean *useCache = OSDynamicCast(OSBoolean, getProperty("Capability Cache"))) {
+        useCapabilityCache = useCache->getValue();
+    }
+    
+    if (useCapabilityCache) {
+        capabilities.load(*capabilityStore, transport);
+    }
+    
     // Scan page descripton table to find all functionality
     // This is where trackpad/trackpoint/button capability is found
     retval = rmiScanPdt();
@@ -75,6 +99,8 @@ bool RMIBus::start(IOService *provider) {
         goto err;
     }
     
+    saveCapabilities();
+    
     // Ready for interrupts
     setProperty(RMIBusIdentifier, kOSBooleanTrue);
     if (!transport->open(this)) {
@@ -83,9 +109,10 @@ bool RMIBus::start(IOService *provider) {
     }
 
     // Check for any ACPI configuration
+    // Updates are serialized on the gate, userspace could already be sending some
     config = transport->createConfig();
     if (config != nullptr) {
-        updateConfiguration(config);
+        commandGate->runAction(OSMemberFunctionCast(IOCommandGate::Action, this, &RMIBus::updateConfiguration), config);
         OSSafeReleaseNULL(config);
     }
 
@@ -102,60 +129,133 @@ err:
     
     functions->flushCollection();
     OSSafeReleaseNULL(iter);
+    clearIrqHandlers();
     IOLogError("Could not start");
     return false;
 }
 
-void RMIBus::handleHostNotify() {
-    UInt32 irqStatus;
+// Returns kIOReturnNoInterrupt if no function had data, so pollers can back off
+IOReturn RMIBus::handleHostNotify(AbsoluteTime time) {
+    UInt32 irqStatus = 0;
     
     if (controlFunction == nullptr) {
         IOLogError("Interrupt - No F01");
-        return;
+        return kIOReturnError;
     }
     
     IOReturn error = controlFunction->readIRQ(irqStatus);
+    markLatency(RMI_LATENCY_IRQ_READ);
     
     if (error != kIOReturnSuccess){
         IOLogError("Unable to read IRQ");
-        return;
+        return error;
     }
     
-    OSIterator* iter = OSCollectionIterator::withCollection(functions);
-    if (!iter) {
-        IOLogDebug("RMIBus::handleHostNotify: No Iter");
-        return;
+    if (!(irqStatus & irqMask))
+        return kIOReturnNoInterrupt;
+    
+    for (int priority = 0; priority < RMI_IRQ_PRIORITY_COUNT; priority++) {
+        UInt32 pending = irqStatus & irqPriorityMasks[priority];
+        
+        while (pending) {
+            RMIFunction *func = irqHandlers[__builtin_ctz(pending)];
+            func->attention(time, nullptr);
+            // Functions with several IRQ bits are only called once
+            pending &= ~func->getIrqMask();
+        }
     }
     
-    while(RMIFunction *func = OSDynamicCast(RMIFunction, iter->getNextObject())) {
-        if (func->hasAttnSig(irqStatus)) {
-            func->attention();
+    return kIOReturnSuccess;
+}
+
+IOReturn RMIBus::handleAttentionReport(AbsoluteTime time, RmiAttention *attention) {
+    if (attention == nullptr) {
+        IOLogError("Interrupt - No attention report");
+        return kIOReturnBadArgument;
+    }
+    
+    // IRQ status came with the report
+    markLatency(RMI_LATENCY_IRQ_READ);
+    
+    UInt32 pending = attention->irqStatus & irqMask;
+    if (!pending)
+        return kIOReturnNoInterrupt;
+    
+    // Data is packed in IRQ order, so priorities don't apply here
+    while (pending) {
+        UInt8 bit = __builtin_ctz(pending);
+        RMIFunction *func = irqHandlers[bit];
+        
+        if (func == nullptr) {
+            // Function we don't drive, nothing to take from the report
+            pending &= ~(1U << bit);
+            continue;
         }
+        
+        func->attention(time, attention);
+        pending &= ~func->getIrqMask();
     }
     
-    OSSafeReleaseNULL(iter);
+    return kIOReturnSuccess;
 }
 
-void RMIBus::handleHostNotifyLegacy() {
-     if (controlFunction == nullptr) {
-         IOLogError("Interrupt - No F01");
-     }
+// Reports are stamped with when the interrupt came in, not when their data was read
+AbsoluteTime RMIBus::beginInterrupt() {
+    interruptGuard.enter();
+#if RMI_LATENCY_STATS
+    latency.begin();
+#endif
+    return clock->now();
+}
 
-     OSIterator* iter = OSCollectionIterator::withCollection(functions);
-     while(RMIFunction *func = OSDynamicCast(RMIFunction, iter->getNextObject()))
-         func->attention();
-     OSSafeReleaseNULL(iter);
+void RMIBus::endInterrupt() {
+#if RMI_LATENCY_STATS
+    latency.end();
+#endif
+    if (statsTimer != nullptr && !__atomic_exchange_n(&statsArmed, true, __ATOMIC_RELAXED))
+        statsTimer->setTimeoutMS(RMI_BUS_STATS_INTERVAL);
+    interruptGuard.exit();
+}
+
+void RMIBus::publishStats(OSObject *owner, IOTimerEventSource *timer) {
+    OSIterator *iter;
+    
+    RMIAssertCanAllocate(interruptGuard);
+    __atomic_store_n(&statsArmed, false, __ATOMIC_RELAXED);
+    
+#if RMI_LATENCY_STATS
+    OSDictionary *stats = latency.copyStatsIfDue();
+    if (stats != nullptr) {
+        setProperty(RMILatencyStatsKey, stats);
+        OSSafeReleaseNULL(stats);
+    }
+#endif
+    
+    iter = OSCollectionIterator::withCollection(functions);
+    if (iter == nullptr)
+        return;
+    
+    while (RMIFunction *func = OSDynamicCast(RMIFunction, iter->getNextObject()))
+        func->publishStats();
+    
+    OSSafeReleaseNULL(iter);
 }
 
 IOReturn RMIBus::message(UInt32 type, IOService *provider, void *argument) {
     switch (type) {
         case kIOMessageVoodooI2CHostNotify:
-        case kIOMessageVoodooSMBusHostNotify:
-            handleHostNotify();
-            break;
-        case kIOMessageVoodooI2CLegacyHostNotify:
-            handleHostNotifyLegacy();
-            break;
+        case kIOMessageVoodooSMBusHostNotify: {
+            AbsoluteTime time = beginInterrupt();
+            IOReturn ret = handleHostNotify(time);
+            endInterrupt();
+            return ret;
+        }
+        case kIOMessageVoodooI2CLegacyHostNotify: {
+            AbsoluteTime time = beginInterrupt();
+            IOReturn ret = handleAttentionReport(time, reinterpret_cast<RmiAttention *>(argument));
+            endInterrupt();
+            return ret;
+        }
         case kIOMessageRMI4ResetHandler:
             rmiEnableSensor();
             break;
@@ -172,6 +272,29 @@ IOReturn RMIBus::message(UInt32 type, IOService *provider, void *argument) {
     return kIOReturnSuccess;
 }
 
+void RMIBus::saveCapabilities() {
+    RmiCapabilityKey key;
+    OSDictionary *stats = OSDictionary::withCapacity(3);
+    OSNumber *value;
+    
+    if (stats) {
+        setPropertyBoolean(stats, "Valid", capabilities.isValid());
+        setPropertyNumber(stats, "Hits", capabilities.getHits(), 32);
+        setPropertyNumber(stats, "Misses", capabilities.getMisses(), 32);
+        setProperty("Capability Cache Stats", stats);
+        OSSafeReleaseNULL(stats);
+    }
+    
+    if (!useCapabilityCache)
+        return;
+    
+    controlFunction->getCapabilityKey(key);
+    capabilities.setKey(key);
+    
+    if (capabilities.isDirty())
+        capabilities.save(*capabilityStore);
+}
+
 void RMIBus::notify(UInt32 type, void *argument) {
     if (type == kHandleRMIClickpadSet ||
         type == kHandleRMITrackpoint) {
@@ -184,7 +307,16 @@ void RMIBus::notify(UInt32 type, void *argument) {
 }
 
 void RMIBus::stop(IOService *provider) {
-    OSIterator *iter = OSCollectionIterator::withCollection(functions);
+    OSIterator *iter;
+    
+    // Waits for the timer if it's running, functions are stopped next
+    if (statsTimer != nullptr) {
+        statsTimer->cancelTimeout();
+        workLoop->removeEventSource(statsTimer);
+        OSSafeReleaseNULL(statsTimer);
+    }
+    
+    iter = OSCollectionIterator::withCollection(functions);
     
     while (RMIFunction *func = OSDynamicCast(RMIFunction, iter->getNextObject())) {
         func->stop(this);
@@ -193,15 +325,22 @@ void RMIBus::stop(IOService *provider) {
     
     functions->flushCollection();
     OSSafeReleaseNULL(iter);
+    clearIrqHandlers();
     
     super::stop(provider);
 }
 
+void RMIBus::clearIrqHandlers() {
+    memset(irqHandlers, 0, sizeof(irqHandlers));
+    memset(irqPriorityMasks, 0, sizeof(irqPriorityMasks));
+}
+
 void RMIBus::free() {
     workLoop->removeEventSource(commandGate);
     OSSafeReleaseNULL(commandGate);
     OSSafeReleaseNULL(workLoop);
     OSSafeReleaseNULL(functions);
+    OSSafeReleaseNULL(traceRecorder);
     super::free();
 }
 
@@ -214,33 +353,58 @@ bool RMIBus::willTerminate(IOService *provider, IOOptionBits options) {
 }
 
 IOReturn RMIBus::setProperties(OSObject *properties) {
-    commandGate->runAction(OSMemberFunctionCast(IOCommandGate::Action, this, &RMIBus::updateConfiguration), OSDynamicCast(OSDictionary, properties));
+    OSDictionary *dictionary = OSDynamicCast(OSDictionary, properties);
+    
+    commandGate->runAction(OSMemberFunctionCast(IOCommandGate::Action, this, &RMIBus::updateConfiguration), dictionary);
+    if (dictionary != nullptr && dictionary->getObject(RMITraceSnapshot) != nullptr)
+        publishTrace();
+    
     publishVoodooInputProperties();
     return kIOReturnSuccess;
 }
 
+// Copies the trace into the registry, where ioreg can save it
+void RMIBus::publishTrace() {
+    if (traceRecorder == nullptr) {
+        IOLogError("Trace requested, but tracing is disabled");
+        return;
+    }
+    
+    OSData *trace = traceRecorder->copyTrace();
+    if (trace != nullptr) {
+        setProperty(RMITraceKey, trace);
+        OSSafeReleaseNULL(trace);
+    }
+}
+
 void RMIBus::updateConfiguration(OSDictionary* dictionary) {
     if (!dictionary)
         return;
 
+    // Nothing is written to the store unless a key is recognised
+    RmiConfiguration next = conf.current();
     bool update = false;
-    update |= Configuration::loadUInt32Configuration(dictionary, "TrackpointMultiplier", &conf.trackpointMult);
-    update |= Configuration::loadUInt32Configuration(dictionary, "TrackpointScrollMultiplierX", &conf.trackpointScrollXMult);
-    update |= Configuration::loadUInt32Configuration(dictionary, "TrackpointScrollMultiplierY", &conf.trackpointScrollYMult);
-    update |= Configuration::loadUInt32Configuration(dictionary, "TrackpointDeadzone", &conf.trackpointDeadzone);
-    update |= Configuration::loadUInt64Configuration(dictionary, "DisableWhileTypingTimeout", &conf.disableWhileTypingTimeout);
-    update |= Configuration::loadUInt64Configuration(dictionary, "DisableWhileTrackpointTimeout", &conf.disableWhileTrackpointTimeout);
-    update |= Configuration::loadUInt32Configuration(dictionary, "ForceTouchMinPressure", &conf.forceTouchMinPressure);
-    update |= Configuration::loadUInt32Configuration(dictionary, "ForceTouchType", reinterpret_cast<UInt32 *>(&conf.forceTouchType));
-    update |= Configuration::loadUInt32Configuration(dictionary, "MinYDiffThumbDetection", &conf.minYDiffGesture);
-    update |= Configuration::loadUInt8Configuration(dictionary, "PalmRejectionMaxObjWidth", &conf.palmRejectionMaxObjWidth);
-    update |= Configuration::loadUInt8Configuration(dictionary, "PalmRejectionMaxObjHeight", &conf.palmRejectionMaxObjHeight);
-    update |= Configuration::loadUInt8Configuration(dictionary, "PalmRejectionWidth", &conf.palmRejectionWidth);
-    update |= Configuration::loadUInt8Configuration(dictionary, "PalmRejectionHeight", &conf.palmRejectionHeight);
-    update |= Configuration::loadUInt8Configuration(dictionary, "PalmRejectionTrackpointHeight", &conf.palmRejectionHeightTrackpoint);
+    update |= Configuration::loadUInt32Configuration(dictionary, "TrackpointMultiplier", &next.trackpointMult);
+    update |= Configuration::loadUInt32Configuration(dictionary, "TrackpointScrollMultiplierX", &next.trackpointScrollXMult);
+    update |= Configuration::loadUInt32Configuration(dictionary, "TrackpointScrollMultiplierY", &next.trackpointScrollYMult);
+    update |= Configuration::loadUInt32Configuration(dictionary, "TrackpointDeadzone", &next.trackpointDeadzone);
+    update |= Configuration::loadUInt64Configuration(dictionary, "DisableWhileTypingTimeout", &next.disableWhileTypingTimeout);
+    update |= Configuration::loadUInt64Configuration(dictionary, "DisableWhileTrackpointTimeout", &next.disableWhileTrackpointTimeout);
+    update |= Configuration::loadUInt32Configuration(dictionary, "ForceTouchMinPressure", &next.forceTouchMinPressure);
+    update |= Configuration::loadUInt32Configuration(dictionary, "ForceTouchType", reinterpret_cast<UInt32 *>(&next.forceTouchType));
+    update |= Configuration::loadUInt32Configuration(dictionary, "MinYDiffThumbDetection", &next.minYDiffGesture);
+    update |= Configuration::loadUInt8Configuration(dictionary, "PalmRejectionMaxObjWidth", &next.palmRejectionMaxObjWidth);
+    update |= Configuration::loadUInt8Configuration(dictionary, "PalmRejectionMaxObjHeight", &next.palmRejectionMaxObjHeight);
+    update |= Configuration::loadUInt8Configuration(dictionary, "PalmRejectionWidth", &next.palmRejectionWidth);
+    update |= Configuration::loadUInt8Configuration(dictionary, "PalmRejectionHeight", &next.palmRejectionHeight);
+    update |= Configuration::loadUInt8Configuration(dictionary, "PalmRejectionTrackpointHeight", &next.palmRejectionHeightTrackpoint);
+    update |= Configuration::loadUInt32Configuration(dictionary, "RepeatKeepAlive", &next.repeatKeepAlive);
 
     if (update) {
         IOLogDebug("Updating Configuration");
+        conf.publish(next);
+        setProperty("Configuration Version", conf.getVersion(), 32);
+        
         OSDictionary *currentConfig = nullptr;
         OSDictionary *newConfig = nullptr;
         if ((currentConfig = OSDynamicCast(OSDictionary, getProperty("Configuration"))) &&
@@ -250,6 +414,9 @@ void RMIBus::updateConfiguration(OSDictionary* dictionary) {
         else
             IOLogError("Failed to merge dictionary");
         OSSafeReleaseNULL(newConfig);
+        
+        if (trackpadFunction != nullptr)
+            messageClient(kHandleRMIConfigurationChanged, trackpadFunction);
     } else {
         IOLogError("Invalid Configuration");
     }
@@ -309,6 +476,7 @@ void RMIBus::publishVoodooInputProperties() {
     setProperty(VOODOO_INPUT_TRANSFORM_KEY, 0ull, 32);
     
     if (trackpointFunction != nullptr) {
+        const RmiConfiguration conf = getConfiguration();
         OSDictionary *trackpoint = OSDictionary::withCapacity(5);
         if (trackpoint == nullptr)
             return;
@@ -10,19 +10,41 @@
 #include <IOKit/IOLib.h>
 #include <IOKit/IOService.h>
 #include <IOKit/IOCommandGate.h>
+#include <IOKit/IOTimerEventSource.h>
 #include <Availability.h>
 #include "RMITransport.hpp"
 #include "RMIConfiguration.hpp"
+#include "RMICapabilityCache.hpp"
+#include "RMITraceRecorder.hpp"
+#include "RMIClock.h"
+#include "RMILatencyStats.hpp"
+#include "RMIAllocGuard.h"
 
 #ifndef __ACIDANTHERA_MAC_SDK
 #error "This kext SDK is unsupported. Download from https://github.com/acidanthera/MacKernelSDK"
 #error "You can also do 'git clone --depth=1 https://github.com/acidanthera/MacKernelSDK.git'"
 #endif
 
+#define RMI_MAX_IRQS 32
+#define RMI_BUS_STATS_INTERVAL 1000 /* ms */
+
 struct RmiPdtEntry;
+struct RmiPdtData;
 class F01;
+class RMIFunction;
 class RMITrackpadFunction;
 
+/*
+ * Order functions are dispatched in on host notify, so button state is
+ * known before pointing data is reported
+ */
+enum RmiIrqPriority {
+    RMI_IRQ_PRIORITY_BUTTONS = 0,
+    RMI_IRQ_PRIORITY_POINTING,
+    RMI_IRQ_PRIORITY_OTHER,
+    RMI_IRQ_PRIORITY_COUNT
+};
+
 class RMIBus : public IOService {
     OSDeclareDefaultStructors(RMIBus);
     
@@ -48,6 +70,25 @@ public:
     inline int readBlock(UInt16 rmiaddr, UInt8 *databuff, size_t len) const {
         return transport->readBlock(rmiaddr, databuff, len);
     }
+    inline int readBlocks(const RmiReadRange *ranges, size_t count) const {
+        return transport->readBlocks(ranges, count);
+    }
+    inline int prepareRead(UInt16 rmiaddr, size_t len) const {
+        return transport->prepareRead(rmiaddr, len);
+    }
+    inline int readPrepared(int handle, UInt8 *databuff, size_t len) const {
+        return transport->readPrepared(handle, databuff, len);
+    }
+    inline void releaseRead(int handle) const {
+        transport->releaseRead(handle);
+    }
+    inline size_t getPreparedReadBlockSize() const {
+        return transport->getPreparedReadBlockSize();
+    }
+    // Registers that only change with the firmware, may come from the capability cache
+    inline int readCapability(UInt16 rmiaddr, UInt8 *databuff, size_t len) {
+        return capabilities.read(transport, rmiaddr, databuff, len);
+    }
     // rmi_write
     inline int write(UInt16 rmiaddr, UInt8 *buf) const {
         return transport->blockWrite(rmiaddr, buf, 1);
@@ -65,8 +106,32 @@ public:
         return gpio;
     }
     
-    inline const RmiConfiguration &getConfiguration() const {
-        return conf;
+    // Copy of the configuration, never half way through an update
+    inline RmiConfiguration getConfiguration() const {
+        return conf.get();
+    }
+    
+    // Current time on the bus clock. Attention gets the time its interrupt arrived
+    inline AbsoluteTime getTimestamp() const {
+        return clock->now();
+    }
+    
+    // Host builds swap in a virtual clock. The clock must outlive the bus
+    inline void setClock(RMIClock *clock) {
+        this->clock = clock != nullptr ? clock : &systemClock;
+    }
+    
+    // Host builds keep the capability cache in a file. Set before start,
+    // the store must outlive the bus
+    inline void setCapabilityStore(RMICapabilityStore *store) {
+        capabilityStore = store != nullptr ? store : &nvramStore;
+    }
+    
+    // Does nothing unless built with RMI_LATENCY_STATS
+    inline void markLatency(RmiLatencyStage stage) {
+#if RMI_LATENCY_STATS
+        latency.mark(stage);
+#endif
     }
     
     void notify(UInt32 type, void *argument = 0);
@@ -79,24 +144,56 @@ private:
     void publishVoodooInputProperties();
     void getGPIOData(OSDictionary *dict);
     void updateConfiguration(OSDictionary *dictionary);
-    RmiConfiguration conf {};
+    RmiVersionedStore<RmiConfiguration> conf {};
     RmiGpioData gpio {};
     
+    RMICapabilityCache capabilities {};
+    RMINVRAMCapabilityStore nvramStore {};
+    RMICapabilityStore *capabilityStore {&nvramStore};
+    bool useCapabilityCache {false};
+    void saveCapabilities();
+    
     RMITransport *transport {nullptr};
+    RMITraceRecorder *traceRecorder {nullptr};
+    void publishTrace();
+    
     RMITrackpadFunction *trackpadFunction {nullptr};
     IOService *trackpointFunction {nullptr};
     F01 *controlFunction {nullptr};
 
-    void handleHostNotify();
-    void handleHostNotifyLegacy();
+    RMIClock systemClock {};
+    RMIClock *clock {&systemClock};
+    AbsoluteTime beginInterrupt();
+    void endInterrupt();
+    
+    // Functions and transports preallocate, handling an interrupt never allocates
+    RMIAllocGuard interruptGuard {};
+    
+    // Interrupts only arm the timer, stats are published from the work loop
+    IOTimerEventSource *statsTimer {nullptr};
+    bool statsArmed {false};
+    void publishStats(OSObject *owner, IOTimerEventSource *timer);
+    
+#if RMI_LATENCY_STATS
+    RMILatencyStats latency {};
+#endif
+    
+    IOReturn handleHostNotify(AbsoluteTime time);
+    IOReturn handleAttentionReport(AbsoluteTime time, RmiAttention *attention);
     
     // IRQ information
     UInt8 irqCount {0};
     UInt32 irqMask {0};
     
+    // Function owning each IRQ bit, and the IRQ bits of each priority
+    RMIFunction *irqHandlers[RMI_MAX_IRQS] {};
+    UInt32 irqPriorityMasks[RMI_IRQ_PRIORITY_COUNT] {};
+    
+    void clearIrqHandlers();
+    
     IOReturn rmiScanPdt();
     IOReturn rmiHandlePdtEntry(RmiPdtEntry &entry);
-    IOReturn rmiReadPdtEntry(RmiPdtEntry &entry, UInt16 addr);
+    void rmiParsePdtEntry(RmiPdtEntry &entry, const RmiPdtData &data, UInt16 pageBase);
     
     IOReturn rmiEnableSensor();
     
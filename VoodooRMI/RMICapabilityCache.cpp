@@ -0,0 +1,196 @@
+/* SPDX-License-Identifier: GPL-2.0-only
+ * RMI4 Device Capability Cache
+ *
+ * Copyright (c) 2023 Avery Black
+ */
+
+#include <IOKit/IORegistryEntry.h>
+#include "RMICapabilityCache.hpp"
+#include "RMILogging.h"
+
+OSData *RMINVRAMCapabilityStore::load(const char *key) {
+    IORegistryEntry *options = IORegistryEntry::fromPath("/options", gIODTPlane);
+    if (options == nullptr)
+        return nullptr;
+
+    OSData *blob = OSDynamicCast(OSData, options->getProperty(key));
+    if (blob != nullptr)
+        blob->retain();
+
+    options->release();
+    return blob;
+}
+
+bool RMINVRAMCapabilityStore::save(const char *key, OSData *blob) {
+    IORegistryEntry *options = IORegistryEntry::fromPath("/options", gIODTPlane);
+    if (options == nullptr) {
+        IOLogError("Could not find NVRAM to store capabilities");
+        return false;
+    }
+
+    bool ret = options->setProperty(key, blob);
+    options->release();
+    return ret;
+}
+
+void RMICapabilityCache::clear() {
+    memset(&header, 0, sizeof(header));
+    header.magic = RMI_CAP_CACHE_MAGIC;
+    header.version = RMI_CAP_CACHE_VERSION;
+    valid = false;
+}
+
+bool RMICapabilityCache::load(RMICapabilityStore &store, RMITransport *transport) {
+    OSData *blob = store.load(RMICapabilityCacheKey);
+    const UInt8 *bytes;
+    size_t recordsSize;
+
+    clear();
+    if (blob == nullptr)
+        return false;
+
+    bytes = reinterpret_cast<const UInt8 *>(blob->getBytesNoCopy());
+    if (blob->getLength() < sizeof(header))
+        goto invalid;
+
+    memcpy(&header, bytes, sizeof(header));
+    if (header.magic != RMI_CAP_CACHE_MAGIC ||
+        header.version != RMI_CAP_CACHE_VERSION ||
+        header.recordCount > RMI_CAP_CACHE_MAX_RECORDS ||
+        header.dataSize > RMI_CAP_CACHE_DATA_SIZE)
+        goto invalid;
+
+    recordsSize = header.recordCount * sizeof(RmiCapabilityRecord);
+    if (blob->getLength() != sizeof(header) + recordsSize + header.dataSize)
+        goto invalid;
+
+    memcpy(records, bytes + sizeof(header), recordsSize);
+    memcpy(data, bytes + sizeof(header) + recordsSize, header.dataSize);
+
+    for (int i = 0; i < header.recordCount; i++) {
+        if (records[i].offset + records[i].len > header.dataSize)
+            goto invalid;
+    }
+
+    if (!probe(transport)) {
+        IOLogInfo("Capability cache is for another device or firmware");
+        clear();
+        OSSafeReleaseNULL(blob);
+        return false;
+    }
+
+    IOLogInfo("Using cached capabilities for %.*s, fw id: %u",
+              RMI_CAP_PRODUCT_ID_LENGTH, header.key.productId, header.key.firmwareId);
+    valid = true;
+    OSSafeReleaseNULL(blob);
+    return true;
+invalid:
+    IOLogError("Capability cache is corrupt, ignoring it");
+    clear();
+    OSSafeReleaseNULL(blob);
+    return false;
+}
+
+/*
+ * Check the product ID and firmware ID of the device against the cache key
+ */
+bool RMICapabilityCache::probe(RMITransport *transport) const {
+    char productId[RMI_CAP_PRODUCT_ID_LENGTH];
+    UInt8 firmwareId[RMI_CAP_FIRMWARE_ID_LENGTH];
+
+    if (header.key.productIdAddr == 0)
+        return false;
+
+    if (transport->readBlock(header.key.productIdAddr,
+                             reinterpret_cast<UInt8 *>(productId),
+                             sizeof(productId)) < 0)
+        return false;
+
+    if (memcmp(productId, header.key.productId, sizeof(productId)))
+        return false;
+
+    if (header.key.firmwareIdAddr == 0)
+        return header.key.firmwareId == 0;
+
+    if (transport->readBlock(header.key.firmwareIdAddr, firmwareId, sizeof(firmwareId)) < 0)
+        return false;
+
+    return header.key.firmwareId == (UInt32) (firmwareId[0] | (firmwareId[1] << 8) | (firmwareId[2] << 16));
+}
+
+bool RMICapabilityCache::save(RMICapabilityStore &store) {
+    size_t recordsSize = header.recordCount * sizeof(RmiCapabilityRecord);
+    OSData *blob = OSData::withCapacity((unsigned int) (sizeof(header) + recordsSize + header.dataSize));
+    bool ret = false;
+
+    if (blob == nullptr)
+        return false;
+
+    if (blob->appendBytes(&header, sizeof(header)) &&
+        blob->appendBytes(records, (unsigned int) recordsSize) &&
+        blob->appendBytes(data, header.dataSize))
+        ret = store.save(RMICapabilityCacheKey, blob);
+
+    if (ret) {
+        IOLogInfo("Saved %u capability reads (%u bytes)", header.recordCount, blob->getLength());
+        dirty = false;
+    } else {
+        IOLogError("Failed to save capability cache");
+    }
+
+    OSSafeReleaseNULL(blob);
+    return ret;
+}
+
+void RMICapabilityCache::setKey(const RmiCapabilityKey &key) {
+    if (memcmp(&header.key, &key, sizeof(key))) {
+        header.key = key;
+        dirty = true;
+    }
+}
+
+const RmiCapabilityRecord *RMICapabilityCache::find(UInt16 addr, size_t len) const {
+    for (int i = 0; i < header.recordCount; i++) {
+        if (records[i].addr == addr && records[i].len == len)
+            return &records[i];
+    }
+
+    return nullptr;
+}
+
+void RMICapabilityCache::record(UInt16 addr, const UInt8 *buf, size_t len) {
+    if (header.recordCount >= RMI_CAP_CACHE_MAX_RECORDS ||
+        header.dataSize + len > RMI_CAP_CACHE_DATA_SIZE) {
+        IOLogDebug("Capability cache full, not recording 0x%x", addr);
+        return;
+    }
+
+    RmiCapabilityRecord *rec = &records[header.recordCount++];
+    rec->addr = addr;
+    rec->len = len;
+    rec->offset = header.dataSize;
+
+    memcpy(&data[header.dataSize], buf, len);
+    header.dataSize += len;
+    dirty = true;
+}
+
+int RMICapabilityCache::read(RMITransport *transport, UInt16 addr, UInt8 *buf, size_t len) {
+    const RmiCapabilityRecord *rec = valid ? find(addr, len) : nullptr;
+
+    if (rec != nullptr) {
+        memcpy(buf, &data[rec->offset], len);
+        hits++;
+        return 0;
+    }
+
+    int retval = transport->readBlock(addr, buf, len);
+    if (retval < 0)
+        return retval;
+
+    misses++;
+    if (find(addr, len) == nullptr)
+        record(addr, buf, len);
+
+    return retval;
+}
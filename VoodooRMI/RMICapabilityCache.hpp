@@ -0,0 +1,106 @@
+/* SPDX-License-Identifier: GPL-2.0-only
+ * RMI4 Device Capability Cache
+ *
+ * Copyright (c) 2023 Avery Black
+ */
+
+#ifndef RMICapabilityCache_hpp
+#define RMICapabilityCache_hpp
+
+#include <IOKit/IOLib.h>
+#include <libkern/c++/OSData.h>
+#include "RMITransport.hpp"
+
+#define RMI_CAP_CACHE_MAGIC         0x434D4952 /* RMIC */
+#define RMI_CAP_CACHE_VERSION       1
+#define RMI_CAP_CACHE_MAX_RECORDS   96
+#define RMI_CAP_CACHE_DATA_SIZE     1024
+#define RMI_CAP_PRODUCT_ID_LENGTH   10
+#define RMI_CAP_FIRMWARE_ID_LENGTH  3
+
+#define RMICapabilityCacheKey "rmi4-capabilities"
+
+/*
+ * Identifies the device a cache was recorded on. Checking it only
+ * takes reading the product ID and build ID registers of F01.
+ */
+struct __attribute__((__packed__)) RmiCapabilityKey {
+    UInt16 productIdAddr;
+    UInt16 firmwareIdAddr; /* 0 if the device has no build ID query */
+    char productId[RMI_CAP_PRODUCT_ID_LENGTH];
+    UInt32 firmwareId;
+};
+
+struct __attribute__((__packed__)) RmiCapabilityHeader {
+    UInt32 magic;
+    UInt16 version;
+    UInt16 recordCount;
+    UInt16 dataSize;
+    RmiCapabilityKey key;
+};
+
+/* A single register read and where its bytes are in the data area */
+struct __attribute__((__packed__)) RmiCapabilityRecord {
+    UInt16 addr;
+    UInt16 len;
+    UInt16 offset;
+};
+
+/*
+ * Backing storage for serialized caches
+ */
+class RMICapabilityStore {
+public:
+    // Returns a retained blob, or nullptr if there is none
+    virtual OSData *load(const char *key) = 0;
+    virtual bool save(const char *key, OSData *blob) = 0;
+};
+
+/*
+ * Stores the cache in NVRAM so it survives reboots
+ */
+class RMINVRAMCapabilityStore : public RMICapabilityStore {
+public:
+    OSData *load(const char *key) override;
+    bool save(const char *key, OSData *blob) override;
+};
+
+/*
+ * Query registers (and control registers the firmware sets up once) only
+ * change with the firmware. Reads of them are recorded the first time a
+ * device is seen, and served from memory on later boots once the cache
+ * key still matches the device.
+ */
+class RMICapabilityCache {
+public:
+    // Load a cache from the store and check it against the device. Reads
+    // are only served from the cache if this succeeds
+    bool load(RMICapabilityStore &store, RMITransport *transport);
+    bool save(RMICapabilityStore &store);
+
+    int read(RMITransport *transport, UInt16 addr, UInt8 *buf, size_t len);
+    void setKey(const RmiCapabilityKey &key);
+
+    inline bool isValid() const { return valid; }
+    // Whether anything was read from the device that isn't saved yet
+    inline bool isDirty() const { return dirty; }
+    inline UInt32 getHits() const { return hits; }
+    inline UInt32 getMisses() const { return misses; }
+
+private:
+    RmiCapabilityHeader header {};
+    RmiCapabilityRecord records[RMI_CAP_CACHE_MAX_RECORDS] {};
+    UInt8 data[RMI_CAP_CACHE_DATA_SIZE] {};
+
+    bool valid {false};
+    bool dirty {false};
+    UInt32 hits {0};
+    UInt32 misses {0};
+
+    void clear();
+    bool probe(RMITransport *transport) const;
+    const RmiCapabilityRecord *find(UInt16 addr, size_t len) const;
+    void record(UInt16 addr, const UInt8 *buf, size_t len);
+};
+
+#endif /* RMICapabilityCache_hpp */
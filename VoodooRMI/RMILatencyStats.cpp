@@ -0,0 +1,144 @@
+/* SPDX-License-Identifier: GPL-2.0-only
+ * RMI4 Input Latency Statistics
+ *
+ * Copyright (c) 2023 Avery Black
+ */
+
+#include "RMILatencyStats.hpp"
+#include "RMIConfiguration.hpp"
+
+#if RMI_LATENCY_STATS
+
+// MARK: Histogram
+
+UInt32 RMILatencyHistogram::bucketOf(UInt64 ns) {
+    if (ns < RMI_LATENCY_SUB_BUCKETS)
+        return static_cast<UInt32>(ns);
+
+    UInt32 msb = 63 - __builtin_clzll(ns);
+    UInt32 shift = msb - RMI_LATENCY_SUB_BUCKET_BITS;
+    UInt32 sub = (ns >> shift) & (RMI_LATENCY_SUB_BUCKETS - 1);
+    return (shift + 1) * RMI_LATENCY_SUB_BUCKETS + sub;
+}
+
+// Largest value that lands in a bucket
+UInt64 RMILatencyHistogram::bucketLimit(UInt32 bucket) {
+    if (bucket < RMI_LATENCY_SUB_BUCKETS)
+        return bucket;
+
+    UInt32 shift = bucket / RMI_LATENCY_SUB_BUCKETS - 1;
+    UInt64 sub = RMI_LATENCY_SUB_BUCKETS + bucket % RMI_LATENCY_SUB_BUCKETS;
+    return ((sub + 1) << shift) - 1;
+}
+
+void RMILatencyHistogram::add(UInt64 ns) {
+    __atomic_fetch_add(&buckets[bucketOf(ns)], 1, __ATOMIC_RELAXED);
+}
+
+void RMILatencyHistogram::drain(UInt64 *counts) {
+    for (int i = 0; i < RMI_LATENCY_BUCKETS; i++)
+        counts[i] = __atomic_exchange_n(&buckets[i], 0, __ATOMIC_RELAXED);
+}
+
+UInt64 RMILatencyHistogram::percentile(const UInt64 *counts, UInt64 total, UInt32 percent) {
+    UInt64 rank = (total * percent + 99) / 100;
+    UInt64 seen = 0;
+
+    for (int i = 0; i < RMI_LATENCY_BUCKETS; i++) {
+        seen += counts[i];
+        if (seen >= rank && seen > 0)
+            return bucketLimit(i);
+    }
+
+    return 0;
+}
+
+// MARK: Stages
+
+const char *RMILatencyStats::stageName(RmiLatencyStage stage) {
+    switch (stage) {
+        case RMI_LATENCY_INTERRUPT: return "Total";
+        case RMI_LATENCY_IRQ_READ: return "IRQ Read";
+        case RMI_LATENCY_DATA_READ: return "Data Read";
+        case RMI_LATENCY_REPORT: return "Report";
+        case RMI_LATENCY_DELIVERED: return "Delivery";
+        default: return "Unknown";
+    }
+}
+
+void RMILatencyStats::begin() {
+    clock_get_uptime(&interruptTime);
+    lastMark = interruptTime;
+    active = true;
+}
+
+void RMILatencyStats::mark(RmiLatencyStage stage) {
+    AbsoluteTime now;
+    UInt64 ns;
+
+    // Packets sent outside of interrupts, like from timers, aren't measured
+    if (!active)
+        return;
+
+    clock_get_uptime(&now);
+    absolutetime_to_nanoseconds(now - lastMark, &ns);
+    histograms[stage].add(ns);
+    lastMark = now;
+
+    if (stage == RMI_LATENCY_DELIVERED) {
+        absolutetime_to_nanoseconds(now - interruptTime, &ns);
+        histograms[RMI_LATENCY_INTERRUPT].add(ns);
+    }
+}
+
+void RMILatencyStats::end() {
+    active = false;
+}
+
+OSDictionary *RMILatencyStats::copyStatsIfDue() {
+    AbsoluteTime now;
+    UInt64 ns, total;
+    UInt64 *counts;
+    OSDictionary *stats, *stage;
+    OSNumber *value;
+
+    clock_get_uptime(&now);
+    absolutetime_to_nanoseconds(now - lastPublish, &ns);
+    if (ns < RMI_LATENCY_PUBLISH_INTERVAL * 1000000ULL)
+        return nullptr;
+
+    lastPublish = now;
+    counts = reinterpret_cast<UInt64 *>(IOMalloc(sizeof(UInt64) * RMI_LATENCY_BUCKETS));
+    stats = OSDictionary::withCapacity(RMI_LATENCY_STAGE_COUNT);
+    if (counts == nullptr || stats == nullptr)
+        goto err;
+
+    for (int i = 0; i < RMI_LATENCY_STAGE_COUNT; i++) {
+        histograms[i].drain(counts);
+
+        total = 0;
+        for (int j = 0; j < RMI_LATENCY_BUCKETS; j++)
+            total += counts[j];
+
+        stage = OSDictionary::withCapacity(4);
+        if (stage == nullptr)
+            goto err;
+
+        setPropertyNumber(stage, "Count", total, 64);
+        setPropertyNumber(stage, "p50 (us)", RMILatencyHistogram::percentile(counts, total, 50) / 1000, 64);
+        setPropertyNumber(stage, "p95 (us)", RMILatencyHistogram::percentile(counts, total, 95) / 1000, 64);
+        setPropertyNumber(stage, "p99 (us)", RMILatencyHistogram::percentile(counts, total, 99) / 1000, 64);
+        stats->setObject(stageName(static_cast<RmiLatencyStage>(i)), stage);
+        OSSafeReleaseNULL(stage);
+    }
+
+    IOFree(counts, sizeof(UInt64) * RMI_LATENCY_BUCKETS);
+    return stats;
+err:
+    if (counts != nullptr)
+        IOFree(counts, sizeof(UInt64) * RMI_LATENCY_BUCKETS);
+    OSSafeReleaseNULL(stats);
+    return nullptr;
+}
+
+#endif /* RMI_LATENCY_STATS */
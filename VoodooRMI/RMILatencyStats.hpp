@@ -0,0 +1,83 @@
+/* SPDX-License-Identifier: GPL-2.0-only
+ * RMI4 Input Latency Statistics
+ *
+ * Copyright (c) 2023 Avery Black
+ */
+
+#ifndef RMILatencyStats_hpp
+#define RMILatencyStats_hpp
+
+#include <IOKit/IOLib.h>
+#include <libkern/c++/OSDictionary.h>
+
+// Build with RMI_LATENCY_STATS=1 to measure input latency
+#ifndef RMI_LATENCY_STATS
+#define RMI_LATENCY_STATS 0
+#endif
+
+#define RMI_LATENCY_SUB_BUCKET_BITS 2
+#define RMI_LATENCY_SUB_BUCKETS     (1 << RMI_LATENCY_SUB_BUCKET_BITS)
+#define RMI_LATENCY_BUCKETS         (64 * RMI_LATENCY_SUB_BUCKETS)
+#define RMI_LATENCY_PUBLISH_INTERVAL 1000 /* ms */
+
+#define RMILatencyStatsKey "Latency Stats"
+
+/*
+ * Points an interrupt passes through on its way to VoodooInput. Each
+ * stage is measured from the one marked before it in the same interrupt.
+ */
+enum RmiLatencyStage {
+    RMI_LATENCY_INTERRUPT = 0,  // Interrupt arrived. Its histogram is the total
+    RMI_LATENCY_IRQ_READ,       // F01 IRQ status read
+    RMI_LATENCY_DATA_READ,      // A function read its data
+    RMI_LATENCY_REPORT,         // Report handled, about to be sent
+    RMI_LATENCY_DELIVERED,      // VoodooInput returned from the packet
+    RMI_LATENCY_STAGE_COUNT
+};
+
+/*
+ * Buckets are powers of two split into RMI_LATENCY_SUB_BUCKETS linear
+ * steps, so a percentile is within 25% of the real value. Counters are
+ * only ever added to or swapped out atomically, so the histogram can be
+ * read while interrupts are being recorded.
+ */
+class RMILatencyHistogram {
+public:
+    void add(UInt64 ns);
+    // Move the counts into a snapshot, leaving this empty
+    void drain(UInt64 *counts);
+
+    static UInt64 percentile(const UInt64 *counts, UInt64 total, UInt32 percent);
+
+private:
+    UInt64 buckets[RMI_LATENCY_BUCKETS] {};
+
+    static UInt32 bucketOf(UInt64 ns);
+    static UInt64 bucketLimit(UInt32 bucket);
+};
+
+/*
+ * Timestamps every stage of an interrupt with the system uptime. This
+ * measures how long things really take, so it doesn't use the bus clock.
+ */
+class RMILatencyStats {
+public:
+    void begin();
+    void mark(RmiLatencyStage stage);
+    void end();
+
+    // Once a publish interval has passed, returns a new dictionary with
+    // p50/p95/p99 in us per stage since the last one
+    OSDictionary *copyStatsIfDue();
+
+private:
+    RMILatencyHistogram histograms[RMI_LATENCY_STAGE_COUNT] {};
+    AbsoluteTime interruptTime {0};
+    AbsoluteTime lastMark {0};
+    AbsoluteTime lastPublish {0};
+    bool active {false};
+
+    static const char *stageName(RmiLatencyStage stage);
+};
+
+#endif /* RMILatencyStats_hpp */
@@ -0,0 +1,234 @@
+/* SPDX-License-Identifier: GPL-2.0-only
+ * RMI4 Bus Transaction Recorder
+ *
+ * Copyright (c) 2023 Avery Black
+ */
+
+#include "RMITraceRecorder.hpp"
+#include "RMILogging.h"
+
+OSDefineMetaClassAndStructors(RMITraceRecorder, RMITransport)
+#define super RMITransport
+
+RMITraceRecorder *RMITraceRecorder::withTransport(RMITransport *target, size_t capacity) {
+    RMITraceRecorder *recorder = OSTypeAlloc(RMITraceRecorder);
+    UInt64 startTime;
+
+    if (target == nullptr || capacity < RMI_TRACE_MIN_SIZE)
+        goto err;
+
+    if (recorder == nullptr || !recorder->init())
+        goto err;
+
+    recorder->lock = IOLockAlloc();
+    recorder->buffer = reinterpret_cast<UInt8 *>(IOMalloc(capacity));
+    if (recorder->lock == nullptr || recorder->buffer == nullptr)
+        goto err;
+
+    recorder->capacity = capacity;
+    recorder->target = target;
+    recorder->target->retain();
+
+    recorder->header.magic = RMI_TRACE_MAGIC;
+    recorder->header.version = RMI_TRACE_VERSION;
+    recorder->header.headerSize = sizeof(RmiTraceHeader);
+    recorder->header.preparedBlockSize = (UInt32) target->getPreparedReadBlockSize();
+    clock_get_uptime(&recorder->lastTime);
+    absolutetime_to_nanoseconds(recorder->lastTime, &startTime);
+    recorder->header.startTime = startTime;
+
+    // The target only opens for a bus
+    recorder->setProperty(RMIBusIdentifier, kOSBooleanTrue);
+    IOLogInfo("Recording bus trace, %lu KiB", capacity / 1024);
+    return recorder;
+err:
+    IOLogError("Could not create trace recorder");
+    OSSafeReleaseNULL(recorder);
+    return nullptr;
+}
+
+void RMITraceRecorder::free() {
+    if (buffer != nullptr) {
+        IOFree(buffer, capacity);
+        buffer = nullptr;
+    }
+
+    if (lock != nullptr) {
+        IOLockFree(lock);
+        lock = nullptr;
+    }
+
+    OSSafeReleaseNULL(target);
+    super::free();
+}
+
+void RMITraceRecorder::record(RmiTraceRecordType type, UInt16 addr, const UInt8 *payload, size_t len, int result,
+                              const UInt8 *prefix, size_t prefixLen) {
+    RmiTraceRecord rec;
+    AbsoluteTime now, delta;
+    UInt64 deltaNs;
+
+    IOLockLock(lock);
+
+    if (used + sizeof(rec) + prefixLen + len > capacity) {
+        header.droppedCount++;
+        IOLockUnlock(lock);
+        return;
+    }
+
+    clock_get_uptime(&now);
+    delta = now - lastTime;
+    absolutetime_to_nanoseconds(delta, &deltaNs);
+    lastTime = now;
+
+    rec.type = type;
+    rec.addr = addr;
+    rec.length = prefixLen + len;
+    rec.result = result;
+    deltaNs /= 1000;
+    rec.delta = deltaNs > UINT32_MAX ? UINT32_MAX : (UInt32) deltaNs;
+
+    memcpy(buffer + used, &rec, sizeof(rec));
+    used += sizeof(rec);
+    if (prefixLen) {
+        memcpy(buffer + used, prefix, prefixLen);
+        used += prefixLen;
+    }
+    if (len) {
+        memcpy(buffer + used, payload, len);
+        used += len;
+    }
+
+    header.recordCount++;
+    IOLockUnlock(lock);
+}
+
+OSData *RMITraceRecorder::copyTrace() {
+    IOLockLock(lock);
+
+    OSData *trace = OSData::withCapacity((unsigned int) (sizeof(header) + used));
+    if (trace != nullptr) {
+        trace->appendBytes(&header, sizeof(header));
+        trace->appendBytes(buffer, (unsigned int) used);
+    }
+
+    IOLockUnlock(lock);
+    return trace;
+}
+
+// MARK: Transport
+
+int RMITraceRecorder::readBlock(UInt16 rmiaddr, UInt8 *databuff, size_t len) {
+    int retval = target->readBlock(rmiaddr, databuff, len);
+    record(RMI_TRACE_READ, rmiaddr, databuff, len, retval);
+    return retval;
+}
+
+int RMITraceRecorder::blockWrite(UInt16 rmiaddr, UInt8 *buf, size_t len) {
+    int retval = target->blockWrite(rmiaddr, buf, len);
+    record(RMI_TRACE_WRITE, rmiaddr, buf, len, retval);
+    return retval;
+}
+
+// Ranges are recorded one by one, however the target merged them
+int RMITraceRecorder::readBlocks(const RmiReadRange *ranges, size_t count) {
+    int retval = target->readBlocks(ranges, count);
+
+    for (size_t i = 0; i < count; i++)
+        record(RMI_TRACE_READ, ranges[i].addr, ranges[i].buf, ranges[i].len, retval);
+
+    return retval;
+}
+
+int RMITraceRecorder::pinRead(UInt16 rmiaddr, size_t len) {
+    return target->pinRead(rmiaddr, len);
+}
+
+void RMITraceRecorder::unpinRead(UInt16 rmiaddr, size_t len) {
+    target->unpinRead(rmiaddr, len);
+}
+
+int RMITraceRecorder::prepareRead(UInt16 rmiaddr, size_t len) {
+    int handle = target->prepareRead(rmiaddr, len);
+
+    if (handle >= 0 && handle < RMI_PREPARED_READS_MAX) {
+        prepared[handle].addr = rmiaddr;
+        prepared[handle].len = len;
+    } else if (handle >= 0) {
+        // Can't tell what this reads, so let the function fall back to readBlock
+        return -1;
+    }
+
+    return handle;
+}
+
+int RMITraceRecorder::readPrepared(int handle, UInt8 *databuff, size_t len) {
+    int retval = target->readPrepared(handle, databuff, len);
+
+    // Only what was asked for, replay falls back to readBlock of the same length
+    if (handle >= 0 && handle < RMI_PREPARED_READS_MAX)
+        record(RMI_TRACE_READ, prepared[handle].addr, databuff, min(len, prepared[handle].len), retval);
+
+    return retval;
+}
+
+void RMITraceRecorder::releaseRead(int handle) {
+    target->releaseRead(handle);
+}
+
+size_t RMITraceRecorder::getPreparedReadBlockSize() {
+    return target->getPreparedReadBlockSize();
+}
+
+int RMITraceRecorder::reset() {
+    int retval = target->reset();
+    record(RMI_TRACE_RESET, 0, nullptr, 0, retval);
+    return retval;
+}
+
+OSDictionary *RMITraceRecorder::createConfig() {
+    return target->createConfig();
+}
+
+// MARK: Bus
+
+bool RMITraceRecorder::handleOpen(IOService *forClient, IOOptionBits options, void *arg) {
+    if (!super::handleOpen(forClient, options, arg))
+        return false;
+
+    if (!target->open(this)) {
+        super::handleClose(forClient, options);
+        return false;
+    }
+
+    return true;
+}
+
+void RMITraceRecorder::handleClose(IOService *forClient, IOOptionBits options) {
+    if (target->isOpen(this))
+        target->close(this);
+
+    super::handleClose(forClient, options);
+}
+
+IOReturn RMITraceRecorder::message(UInt32 type, IOService *provider, void *argument) {
+    if (bus == nullptr)
+        return kIOReturnNotOpen;
+
+    switch (type) {
+        case kIOMessageVoodooSMBusHostNotify:
+        case kIOMessageVoodooI2CHostNotify:
+            // Logged before the bus handles it, so the reads it does come after
+            record(RMI_TRACE_HOST_NOTIFY, 0, nullptr, 0, 0);
+            break;
+        case kIOMessageVoodooI2CLegacyHostNotify: {
+            RmiAttention *attention = reinterpret_cast<RmiAttention *>(argument);
+            if (attention != nullptr)
+                record(RMI_TRACE_ATTENTION, 0, attention->data, attention->size, 0,
+                       reinterpret_cast<const UInt8 *>(&attention->irqStatus), sizeof(attention->irqStatus));
+            break;
+        }
+    }
+
+    return messageClient(type, bus, argument);
+}
@@ -0,0 +1,104 @@
+/* SPDX-License-Identifier: GPL-2.0-only
+ * RMI4 Bus Transaction Recorder
+ *
+ * Copyright (c) 2023 Avery Black
+ */
+
+#ifndef RMITraceRecorder_hpp
+#define RMITraceRecorder_hpp
+
+#include <IOKit/IOLib.h>
+#include <libkern/c++/OSData.h>
+#include "RMITransport.hpp"
+
+#define RMI_TRACE_MAGIC         0x54494D52 /* RMIT */
+#define RMI_TRACE_VERSION       2
+#define RMI_TRACE_MIN_SIZE      4096
+
+// Size of the trace buffer in KiB, 0 disables tracing
+#define RMITraceBufferSize      "Trace Buffer Size"
+// Set through setProperties to publish the trace recorded so far
+#define RMITraceSnapshot        "Trace Snapshot"
+#define RMITraceKey             "Trace"
+
+enum RmiTraceRecordType : UInt8 {
+    RMI_TRACE_READ = 1,
+    RMI_TRACE_WRITE,
+    RMI_TRACE_RESET,
+    // Interrupt from the transport, the reads it caused follow it
+    RMI_TRACE_HOST_NOTIFY,
+    // Payload is the irq status followed by the attention data
+    RMI_TRACE_ATTENTION,
+};
+
+struct __attribute__((__packed__)) RmiTraceHeader {
+    UInt32 magic;
+    UInt16 version;
+    UInt16 headerSize;
+    UInt64 startTime;       /* ns */
+    UInt32 recordCount;
+    UInt32 droppedCount;    /* Records that did not fit in the buffer */
+    UInt32 preparedBlockSize; /* Target's getPreparedReadBlockSize */
+};
+
+/*
+ * Every record is followed by length bytes of payload. Reads carry the
+ * bytes that came back from the device, writes the bytes sent to it.
+ */
+struct __attribute__((__packed__)) RmiTraceRecord {
+    UInt8 type;
+    UInt16 addr;
+    UInt16 length;
+    SInt32 result;
+    UInt32 delta;           /* us since the previous record */
+};
+
+/*
+ * Sits between RMIBus and the real transport, forwarding everything and
+ * logging it to a fixed size buffer. Recording stops once the buffer is
+ * full, so a trace always starts from the bus starting up.
+ */
+class RMITraceRecorder : public RMITransport {
+    OSDeclareDefaultStructors(RMITraceRecorder);
+
+public:
+    static RMITraceRecorder *withTransport(RMITransport *target, size_t capacity);
+    void free() override;
+
+    int readBlock(UInt16 rmiaddr, UInt8 *databuff, size_t len) override;
+    int blockWrite(UInt16 rmiaddr, UInt8 *buf, size_t len) override;
+    int readBlocks(const RmiReadRange *ranges, size_t count) override;
+    int pinRead(UInt16 rmiaddr, size_t len) override;
+    void unpinRead(UInt16 rmiaddr, size_t len) override;
+    int prepareRead(UInt16 rmiaddr, size_t len) override;
+    int readPrepared(int handle, UInt8 *databuff, size_t len) override;
+    void releaseRead(int handle) override;
+    size_t getPreparedReadBlockSize() override;
+    int reset() override;
+    OSDictionary *createConfig() override;
+
+    bool handleOpen(IOService *forClient, IOOptionBits options, void *arg) override;
+    void handleClose(IOService *forClient, IOOptionBits options) override;
+    IOReturn message(UInt32 type, IOService *provider, void *argument = 0) override;
+
+    // Header and records so far, as a new OSData
+    OSData *copyTrace();
+
+private:
+    RMITransport *target {nullptr};
+    IOLock *lock {nullptr};
+
+    UInt8 *buffer {nullptr};
+    size_t capacity {0};
+    size_t used {0};
+    RmiTraceHeader header {};
+    AbsoluteTime lastTime {0};
+
+    RmiReadRange prepared[RMI_PREPARED_READS_MAX] {};
+
+    // prefix is written in front of the payload, and counts towards the length
+    void record(RmiTraceRecordType type, UInt16 addr, const UInt8 *payload, size_t len, int result,
+                const UInt8 *prefix = nullptr, size_t prefixLen = 0);
+};
+
+#endif /* RMITraceRecorder_hpp */
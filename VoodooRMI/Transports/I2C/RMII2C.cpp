@@ -56,6 +56,8 @@ RMII2C *RMII2C::probe(IOService *provider, SInt32 *score) {
     }
 
     do {
+        if (attempts)
+            bus_stats.retry();
         IOLogDebug("%s::%s Trying to set mode, attempt %d", getName(), name, attempts);
         error = rmi_set_mode(reportMode);
         IOSleep(500);
@@ -66,14 +68,32 @@ RMII2C *RMII2C::probe(IOService *provider, SInt32 *score) {
         return NULL;
     }
 
+    input_scratch_size = (hdesc.wMaxInputLength ? hdesc.wMaxInputLength : RMI_I2C_DEFAULT_MAX_LENGTH) + RMI_READ_HEADER_SIZE;
+    output_scratch_size = (hdesc.wMaxOutputLength ? hdesc.wMaxOutputLength : RMI_I2C_DEFAULT_MAX_LENGTH) + RMI_WRITE_HEADER_SIZE;
+    input_scratch = reinterpret_cast<UInt8 *>(IOMalloc(input_scratch_size));
+    output_scratch = reinterpret_cast<UInt8 *>(IOMalloc(output_scratch_size));
+    if (!input_scratch || !output_scratch) {
+        IOLogError("%s::%s Could not allocate report buffers", getName(), name);
+        return NULL;
+    }
+
+    if (reportMode == RMI_MODE_ATTN_REPORTS) {
+        attn_report_size = hdesc.wMaxInputLength ? hdesc.wMaxInputLength : RMI_I2C_DEFAULT_MAX_LENGTH;
+        attn_report = reinterpret_cast<UInt8 *>(IOMalloc(attn_report_size));
+        if (!attn_report) {
+            IOLogError("%s::%s Could not allocate attention report buffer", getName(), name);
+            return NULL;
+        }
+    }
+
     page_mutex = IOLockAlloc();
-    IOLockLock(page_mutex);
+    bus_stats.lock(page_mutex);
     /*
      * Setting the page to zero will (a) make sure the PSR is in a
      * known state, and (b) make sure we can talk to the device.
      */
     error = rmi_set_page(0);
-    IOLockUnlock(page_mutex);
+    bus_stats.unlock(page_mutex);
     if (error) {
         IOLogError("%s::%s Failed to set page select to 0", getName(), name);
         return NULL;
@@ -103,6 +123,22 @@ bool RMII2C::start(IOService *provider) {
     
     if (interrupt_source) {
         work_loop->addEventSource(interrupt_source);
+
+        OSNumber *duration = OSDynamicCast(OSNumber, getProperty(RMIBurstPollDuration));
+        OSNumber *interval = OSDynamicCast(OSNumber, getProperty(RMIBurstPollInterval));
+        if (duration)
+            burst_duration = duration->unsigned32BitValue();
+        if (interval && interval->unsigned32BitValue())
+            burst_interval = interval->unsigned32BitValue();
+
+        if (burst_duration) {
+            burst_timer = IOTimerEventSource::timerEventSource(this, OSMemberFunctionCast(IOTimerEventSource::Action, this, &RMII2C::burstPoll));
+            if (burst_timer) {
+                work_loop->addEventSource(burst_timer);
+            } else {
+                IOLogInfo("%s::%s Could not get burst timer, using interrupts only", getName(), name);
+            }
+        }
     } else {
         IOLogInfo("%s::%s Could not get interrupt event source, falling back to polling", getName(), name);
         interrupt_simulator = IOTimerEventSource::timerEventSource(this, OSMemberFunctionCast(IOTimerEventSource::Action, this, &RMII2C::simulateInterrupt));
@@ -113,6 +149,15 @@ bool RMII2C::start(IOService *provider) {
         
         work_loop->addEventSource(interrupt_simulator);
     }
+
+    stats_timer = IOTimerEventSource::timerEventSource(this, OSMemberFunctionCast(IOTimerEventSource::Action, this, &RMII2C::publishStats));
+    if (stats_timer && work_loop->addEventSource(stats_timer) == kIOReturnSuccess) {
+        bus_stats.setTimer(stats_timer);
+        bus_stats.arm();
+    } else {
+        IOLogInfo("%s::%s Could not get stats timer, not publishing bus stats", getName(), name);
+        OSSafeReleaseNULL(stats_timer);
+    }
     
     startInterrupt();
 
@@ -120,7 +165,7 @@ bool RMII2C::start(IOService *provider) {
     provider->joinPMtree(this);
     registerPowerDriver(this, RMIPowerStates, 2);
 
-    setProperty("Interrupt mode", (!interrupt_source) ? "Polling" : "Pinned");
+    setProperty("Interrupt mode", (!interrupt_source) ? "Polling" : (burst_timer) ? "Pinned + Burst" : "Pinned");
     setProperty("VoodooI2CServices Supported", kOSBooleanTrue);
     setProperty(RMIBusSupported, kOSBooleanTrue);
     registerService();
@@ -145,6 +190,16 @@ void RMII2C::releaseResources() {
         work_loop->removeEventSource(interrupt_simulator);
     }
 
+    if (burst_timer) {
+        work_loop->removeEventSource(burst_timer);
+    }
+
+    if (stats_timer) {
+        bus_stats.setTimer(nullptr);
+        stats_timer->cancelTimeout();
+        work_loop->removeEventSource(stats_timer);
+    }
+
     if (device_nub) {
         if (device_nub->isOpen(this))
             device_nub->close(this);
@@ -154,6 +209,8 @@ void RMII2C::releaseResources() {
     OSSafeReleaseNULL(command_gate);
     OSSafeReleaseNULL(interrupt_source);
     OSSafeReleaseNULL(interrupt_simulator);
+    OSSafeReleaseNULL(burst_timer);
+    OSSafeReleaseNULL(stats_timer);
     OSSafeReleaseNULL(work_loop);
 
     IOLockFree(page_mutex);
@@ -165,6 +222,17 @@ void RMII2C::stop(IOService *provider) {
     super::stop(provider);
 }
 
+void RMII2C::free() {
+    if (input_scratch)
+        IOFree(input_scratch, input_scratch_size);
+    if (output_scratch)
+        IOFree(output_scratch, output_scratch_size);
+    if (attn_report)
+        IOFree(attn_report, attn_report_size);
+    input_scratch = output_scratch = attn_report = nullptr;
+    super::free();
+}
+
 int RMII2C::rmi_set_page(UInt8 page) {
     /*
      * simplified version of rmi_write_report, hid_hw_output_report, i2c_hid_output_report,
@@ -181,11 +249,15 @@ int RMII2C::rmi_set_page(UInt8 page) {
         page
     };
 
-    if (device_nub->writeI2C(writeReport, sizeof(writeReport)) != kIOReturnSuccess) {
+    bus_stats.pageSelect();
+    IOReturn ret = device_nub->writeI2C(writeReport, sizeof(writeReport));
+    if (ret != kIOReturnSuccess) {
+        bus_stats.failure(ret);
         IOLogError("%s::%s failed to write request output report", getName(), name);
         return -1;
     }
 
+    bus_stats.write(sizeof(writeReport));
     this->page = page;
     return 0;
 }
@@ -255,9 +327,13 @@ int RMII2C::rmi_set_mode(UInt8 mode) {
         mode
     };
 
-    if (device_nub->writeI2C(command, sizeof(command)) != kIOReturnSuccess)
+    IOReturn ret = device_nub->writeI2C(command, sizeof(command));
+    if (ret != kIOReturnSuccess) {
+        bus_stats.failure(ret);
         return -1;
+    }
     
+    bus_stats.write(sizeof(command));
     IOLogDebug("%s::%s mode set", getName(), name);
 
     return 1;
@@ -290,13 +366,12 @@ bool RMII2C::handleOpen(IOService *forClient, IOOptionBits options, void *arg) {
     return IOService::handleOpen(forClient, options, arg);
 }
 
-int RMII2C::readBlock(UInt16 rmiaddr, UInt8 *databuff, size_t len) {
-    int retval = 0;
-
+// Build the output report requesting a read, returns the (possibly clamped) read length
+size_t RMII2C::rmi_read_report_init(UInt8 *writeReport, UInt16 rmiaddr, size_t len) {
     if (hdesc.wMaxInputLength && (len > hdesc.wMaxInputLength))
         len = hdesc.wMaxInputLength;
 
-    UInt8 writeReport[] = {
+    UInt8 report[RMI_READ_REPORT_SIZE] = {
         (UInt8) (hdesc.wOutputRegister & 0xFF),
         (UInt8) (hdesc.wOutputRegister >> 8),
         0x08,  // size & 0xFF; 2 + reportID + buf (reportID excluded)
@@ -308,22 +383,111 @@ int RMII2C::readBlock(UInt16 rmiaddr, UInt8 *databuff, size_t len) {
         (UInt8) (len & 0xFF),
         (UInt8) (len >> 8) };
 
-    UInt8 *i2cInput = new UInt8[len+4];
+    memcpy(writeReport, report, sizeof(report));
+    return len;
+}
+
+int RMII2C::readBlock(UInt16 rmiaddr, UInt8 *databuff, size_t len) {
+    UInt8 writeReport[RMI_READ_REPORT_SIZE];
+
+    len = rmi_read_report_init(writeReport, rmiaddr, len);
+    return rmi_read_report(writeReport, rmiaddr, databuff, len);
+}
+
+int RMII2C::prepareRead(UInt16 rmiaddr, size_t len) {
+    rmi_i2c_prepared_read *read;
+    int handle;
+
+    bus_stats.lock(page_mutex);
+    for (handle = 0; handle < prepared_count; handle++) {
+        read = &prepared_reads[handle];
+        if (read->refs && read->rmiaddr == rmiaddr && read->len == len) {
+            read->refs++;
+            goto exit;
+        }
+    }
+
+    // Take a released slot before growing the table
+    for (handle = 0; handle < prepared_count; handle++) {
+        if (!prepared_reads[handle].refs)
+            break;
+    }
+
+    if (handle >= RMI_PREPARED_READS_MAX) {
+        handle = -1;
+        goto exit;
+    }
+
+    read = &prepared_reads[handle];
+    read->rmiaddr = rmiaddr;
+    read->len = len;
+    read->refs = 1;
+    rmi_read_report_init(read->writeReport, rmiaddr, len);
+    if (handle == prepared_count)
+        prepared_count++;
+
+exit:
+    bus_stats.unlock(page_mutex);
+    return handle;
+}
+
+void RMII2C::releaseRead(int handle) {
+    if (handle < 0 || handle >= prepared_count)
+        return;
+
+    bus_stats.lock(page_mutex);
+    if (prepared_reads[handle].refs)
+        prepared_reads[handle].refs--;
+    bus_stats.unlock(page_mutex);
+}
+
+int RMII2C::readPrepared(int handle, UInt8 *databuff, size_t len) {
+    if (handle < 0 || handle >= prepared_count || !prepared_reads[handle].refs)
+        return -1;
+
+    const rmi_i2c_prepared_read *read = &prepared_reads[handle];
+    // Nothing to reuse for a shorter read, the report is cheap to build
+    if (len < read->len)
+        return readBlock(read->rmiaddr, databuff, len);
+
+    len = read->len;
+
+    if (hdesc.wMaxInputLength && (len > hdesc.wMaxInputLength))
+        len = hdesc.wMaxInputLength;
+
+    return rmi_read_report(read->writeReport, read->rmiaddr, databuff, len);
+}
+
+int RMII2C::rmi_read_report(const UInt8 *writeReport, UInt16 rmiaddr, UInt8 *databuff, size_t len) {
+    int retval = 0;
+    IOReturn ret;
+    UInt8 *i2cInput;
     memset(databuff, 0, len);
 
-    IOLockLock(page_mutex);
+    bus_stats.lock(page_mutex);
+    i2cInput = input_scratch;
+    // Only reads past the descriptor's max input length need their own buffer
+    if (len + RMI_READ_HEADER_SIZE > input_scratch_size) {
+        RMIAssertCanAllocate(interrupt_guard);
+        i2cInput = new UInt8[len + RMI_READ_HEADER_SIZE];
+    }
+
     if (RMI_I2C_PAGE(rmiaddr) != page) {
         retval = rmi_set_page(RMI_I2C_PAGE(rmiaddr));
         if (retval < 0)
             goto exit;
     }
 
-    if (device_nub->writeReadI2C(writeReport, sizeof(writeReport), i2cInput, len+4) != kIOReturnSuccess) {
+    ret = device_nub->writeReadI2C(const_cast<UInt8 *>(writeReport), RMI_READ_REPORT_SIZE, i2cInput, len+4);
+    if (ret != kIOReturnSuccess) {
+        bus_stats.failure(ret);
         IOLogError("%s::%s failed to read I2C input", getName(), name);
         retval = -1;
         goto exit;
     }
 
+    bus_stats.read(len);
+
     if (i2cInput[2] != RMI_READ_DATA_REPORT_ID) {
         IOLogError("%s::%s RMI_READ_DATA_REPORT_ID mismatch %d", getName(), name, i2cInput[2]);
         if (i2cInput[2] == HID_GENERIC_MOUSE ||
@@ -344,22 +508,43 @@ int RMII2C::readBlock(UInt16 rmiaddr, UInt8 *databuff, size_t len) {
         memcpy(databuff+16, i2cInput+4, 16);
         device_nub->readI2C(i2cInput, len+4);
         memcpy(databuff+32, i2cInput+4, 16);
+        bus_stats.read(len);
+        bus_stats.read(len);
     } else {
         memcpy(databuff, i2cInput+4, len);
     }
 exit:
-    delete[] i2cInput;
-    IOLockUnlock(page_mutex);
+    if (i2cInput != input_scratch)
+        delete[] i2cInput;
+    bus_stats.unlock(page_mutex);
     return retval;
 }
 
+int RMII2C::readBlocks(const RmiReadRange *ranges, size_t count) {
+    size_t maxLen = RMI_READ_MERGE_MAX;
+
+    // Legacy mode splits 68 byte reads across several input reports, don't
+    // let a merged read land on that length
+    if (reportMode == RMI_MODE_ATTN_REPORTS)
+        return RMITransport::readBlocks(ranges, count);
+
+    // Input report has 4 bytes of header ahead of the data
+    if (hdesc.wMaxInputLength > 4 && hdesc.wMaxInputLength - 4 < maxLen)
+        maxLen = hdesc.wMaxInputLength - 4;
+
+    return readBlocksMerged(ranges, count, maxLen);
+}
+
 int RMII2C::blockWrite(UInt16 rmiaddr, UInt8 *buf, size_t len) {
     int retval = 0;
+    IOReturn ret;
+
+    UInt8 *writeReport;
 
     if (hdesc.wMaxOutputLength && (len + 6 > hdesc.wMaxOutputLength))
         setProperty("InputLength exceed", len);
 
-    UInt8 *writeReport = new UInt8[len+8] {
+    UInt8 header[RMI_WRITE_HEADER_SIZE] = {
         (UInt8) (hdesc.wOutputRegister & 0xFF),
         (UInt8) (hdesc.wOutputRegister >> 8),
         (UInt8) ((len + 6) & 0xFF),  // size & 0xFF; 2 + reportID + buf (reportID excluded)
@@ -369,39 +554,230 @@ int RMII2C::blockWrite(UInt16 rmiaddr, UInt8 *buf, size_t len) {
         (UInt8) (rmiaddr & 0xFF),
         (UInt8) (rmiaddr >> 8) };
 
-    IOLockLock(page_mutex);
+    bus_stats.lock(page_mutex);
+    writeReport = output_scratch;
+    if (len + RMI_WRITE_HEADER_SIZE > output_scratch_size) {
+        RMIAssertCanAllocate(interrupt_guard);
+        writeReport = new UInt8[len + RMI_WRITE_HEADER_SIZE];
+    }
+
     if (RMI_I2C_PAGE(rmiaddr) != page) {
         retval = rmi_set_page(RMI_I2C_PAGE(rmiaddr));
         if (retval < 0)
             goto exit;
     }
 
-    memcpy(writeReport+8, buf, len);
+    memcpy(writeReport, header, sizeof(header));
+    memcpy(writeReport + RMI_WRITE_HEADER_SIZE, buf, len);
 
-    if (device_nub->writeI2C(writeReport, len+8) != kIOReturnSuccess) {
+    ret = device_nub->writeI2C(writeReport, len + RMI_WRITE_HEADER_SIZE);
+    if (ret != kIOReturnSuccess) {
+        bus_stats.failure(ret);
         IOLogError("%s::%s failed to write request output report", getName(), name);
         retval = -1;
         goto exit;
     }
+    bus_stats.write(len);
     retval = 0;
 
 exit:
-    delete [] writeReport;
-    IOLockUnlock(page_mutex);
+    if (writeReport != output_scratch)
+        delete [] writeReport;
+    bus_stats.unlock(page_mutex);
     return retval;
 }
 
+// Runs on the work loop, the I/O paths only bump counters
+void RMII2C::publishStats(OSObject* owner, IOTimerEventSource* timer) {
+    RMIAssertCanAllocate(interrupt_guard);
+    OSDictionary *stats = bus_stats.copyStats();
+    if (stats == nullptr)
+        return;
+
+    setProperty(RMITransportStatsKey, stats);
+    OSSafeReleaseNULL(stats);
+}
+
+// Returns kIOReturnSuccess if any function had data
+IOReturn RMII2C::notifyBus() {
+    IOReturn ret;
+
+    if (!ready || !bus)
+        return kIOReturnNotReady;
+
+    interrupt_guard.enter();
+    if (reportMode == RMI_MODE_ATTN_REPORTS)
+        ret = rmi_handle_attn_report();
+    else
+        ret = messageClient(kIOMessageVoodooI2CHostNotify, bus);
+    bus_stats.arm();
+    interrupt_guard.exit();
+    return ret;
+}
+
 // We are in the workloop (not interrupt context), it's OK to use IOLog, messageClient, etc
 void RMII2C::interruptOccured(OSObject *owner, IOInterruptEventSource *src, int intCount) {
-    if (!ready || !bus)
+    if (notifyBus() == kIOReturnSuccess && burst_timer)
+        startBurst();
+}
+
+/*
+ * Once an interrupt brought data, poll at burst_interval until nothing was
+ * reported for burst_duration. Reports during tracking then skip the
+ * interrupt latency, and the pad goes back to interrupts once quiet.
+ */
+void RMII2C::startBurst() {
+    AbsoluteTime timestamp;
+
+    clock_get_uptime(&timestamp);
+    absolutetime_to_nanoseconds(timestamp, &burst_deadline);
+    burst_deadline += (UInt64) burst_duration * kMillisecondScale;
+
+    if (!burst_active) {
+        burst_active = true;
+        burst_timer->setTimeoutMS(burst_interval);
+    }
+}
+
+void RMII2C::burstPoll(OSObject* owner, IOTimerEventSource* timer) {
+    AbsoluteTime timestamp;
+    UInt64 now;
+    IOReturn ret = notifyBus();
+
+    if (ret == kIOReturnNotReady) {
+        burst_active = false;
         return;
+    }
+
+    clock_get_uptime(&timestamp);
+    absolutetime_to_nanoseconds(timestamp, &now);
 
-    messageClient(reportMode == RMI_MODE_ATTN_REPORTS ? kIOMessageVoodooI2CLegacyHostNotify : kIOMessageVoodooI2CHostNotify, bus);
+    if (ret == kIOReturnSuccess)
+        burst_deadline = now + (UInt64) burst_duration * kMillisecondScale;
+
+    if (now < burst_deadline)
+        burst_timer->setTimeoutMS(burst_interval);
+    else
+        burst_active = false;
 }
 
+/*
+ * In attention mode the device pushes an input report with the IRQ status and
+ * the data of every function that has an IRQ pending, so a single read of the
+ * input register replaces reading F01 and each function's data registers.
+ *
+ * Report layout: length (2 bytes, including itself), report ID, IRQ status, packed data
+ */
+IOReturn RMII2C::rmi_handle_attn_report() {
+    RmiAttention attention;
+    IOReturn ret;
+    UInt16 size;
+
+    bus_stats.lock(page_mutex);
+    ret = device_nub->readI2C(attn_report, attn_report_size);
+    if (ret == kIOReturnSuccess)
+        bus_stats.read(attn_report_size);
+    else
+        bus_stats.failure(ret);
+    bus_stats.unlock(page_mutex);
+
+    if (ret != kIOReturnSuccess) {
+        IOLogError("%s::%s failed to read attention report", getName(), name);
+        return ret;
+    }
+
+    size = attn_report[0] | (attn_report[1] << 8);
+
+    // Zero length means no report is pending (e.g. after a reset)
+    if (size == 0)
+        return kIOReturnNoInterrupt;
+
+    if (size < 4 || size > attn_report_size) {
+        IOLogError("%s::%s invalid input report size %d", getName(), name, size);
+        return kIOReturnUnderrun;
+    }
+
+    switch (attn_report[2]) {
+        case RMI_ATTN_REPORT_ID:
+            attention.irqStatus = attn_report[3];
+            attention.data = &attn_report[4];
+            attention.size = size - 4;
+            return messageClient(kIOMessageVoodooI2CLegacyHostNotify, bus, &attention);
+        case HID_GENERIC_MOUSE:
+        case HID_GENERIC_POINTER:
+            // Device fell back to mouse emulation
+            IOLogError("%s::%s Unexpected mouse report, resetting", getName(), name);
+            if (reset() < 0)
+                IOLogError("%s::%s Failed to reset trackpad", getName(), name);
+            return kIOReturnNoInterrupt;
+        default:
+            IOLogDebug("%s::%s Ignoring input report %d", getName(), name, attn_report[2]);
+            return kIOReturnNoInterrupt;
+    }
+}
+
+/*
+ * Without an interrupt the pad is polled, at the busy interval while functions
+ * report data and at the idle interval once nothing was reported for a while.
+ */
 void RMII2C::simulateInterrupt(OSObject* owner, IOTimerEventSource* timer) {
-    interruptOccured(owner, NULL, 0);
-    interrupt_simulator->setTimeoutMS(INTERRUPT_SIMULATOR_TIMEOUT);
+    AbsoluteTime timestamp;
+    UInt64 now;
+    IOReturn ret = notifyBus();
+
+    clock_get_uptime(&timestamp);
+    absolutetime_to_nanoseconds(timestamp, &now);
+
+    // Time since the last poll counts towards the interval it was polled at
+    if (poll_interval == INTERRUPT_SIMULATOR_TIMEOUT_BUSY)
+        poll_busy_time += now - poll_last_tick;
+    poll_last_tick = now;
+    poll_count++;
+
+    if (ret == kIOReturnSuccess) {
+        poll_last_active = now;
+        poll_interval = INTERRUPT_SIMULATOR_TIMEOUT_BUSY;
+    } else if (now - poll_last_active > INTERRUPT_SIMULATOR_IDLE_DELAY * kMillisecondScale) {
+        poll_interval = INTERRUPT_SIMULATOR_TIMEOUT_IDLE;
+    }
+
+    if (now - poll_stats_start >= INTERRUPT_SIMULATOR_STATS_INTERVAL * kMillisecondScale)
+        publishPollingStats(now);
+
+    interrupt_simulator->setTimeoutMS(poll_interval);
+}
+
+void RMII2C::resetPolling() {
+    AbsoluteTime timestamp;
+    UInt64 now;
+
+    clock_get_uptime(&timestamp);
+    absolutetime_to_nanoseconds(timestamp, &now);
+
+    poll_interval = INTERRUPT_SIMULATOR_TIMEOUT_BUSY;
+    poll_last_active = poll_last_tick = poll_stats_start = now;
+    poll_busy_time = 0;
+    poll_count = 0;
+}
+
+void RMII2C::publishPollingStats(UInt64 now) {
+    OSDictionary *stats = OSDictionary::withCapacity(3);
+    OSNumber *value;
+    UInt64 elapsed = now - poll_stats_start;
+
+    if (stats) {
+        setPropertyNumber(stats, "Interval (ms)", poll_interval, 32);
+        // Polls per second over the last window
+        setPropertyNumber(stats, "Rate", (UInt64) poll_count * kSecondScale / elapsed, 32);
+        // Percent of the last window spent at the busy interval
+        setPropertyNumber(stats, "Duty Cycle", poll_busy_time * 100 / elapsed, 32);
+        setProperty("Polling", stats);
+        OSSafeReleaseNULL(stats);
+    }
+
+    poll_stats_start = now;
+    poll_busy_time = 0;
+    poll_count = 0;
 }
 
 IOReturn RMII2C::setPowerStateGated() {
@@ -448,7 +824,8 @@ IOReturn RMII2C::setPowerState(unsigned long newPowerState, IOService *whatDevic
 
 void RMII2C::startInterrupt() {
     if (interrupt_simulator) {
-        interrupt_simulator->setTimeoutMS(200);
+        resetPolling();
+        interrupt_simulator->setTimeoutMS(INTERRUPT_SIMULATOR_INTERVAL);
         interrupt_simulator->enable();
     } else if (interrupt_source) {
         interrupt_source->enable();
@@ -458,6 +835,10 @@ void RMII2C::startInterrupt() {
 
 void RMII2C::stopInterrupt() {
     ready = false;
+    if (burst_timer) {
+        burst_timer->cancelTimeout();
+        burst_active = false;
+    }
     if (interrupt_simulator) {
         interrupt_simulator->disable();
     } else if (interrupt_source) {
@@ -14,6 +14,8 @@
 #define RMISMBus_h
 
 #include "RMITransport.hpp"
+#include "RMITransportStats.hpp"
+#include "RMIAllocGuard.h"
 #include "VoodooI2CDeviceNub.hpp"
 #include <IOKit/IOTimerEventSource.h>
 
@@ -29,6 +31,13 @@
 #define RMI_PAGE_SELECT_REGISTER    0xff
 #define RMI_I2C_PAGE(addr) (((addr) >> 8) & 0xff)
 
+#define RMI_READ_REPORT_SIZE        10
+#define RMI_READ_HEADER_SIZE        4
+#define RMI_WRITE_HEADER_SIZE       8
+
+// fallback when HID descriptor has no max input/output length
+#define RMI_I2C_DEFAULT_MAX_LENGTH  256
+
 // fallback when HID descriptor is not available
 #define RMI_HID_DESC_REGISTER       0x20
 #define RMI_HID_COMMAND_REGISTER    0x22
@@ -39,9 +48,12 @@
 #define HID_GENERIC_MOUSE           0x02
 
 #define INTERRUPT_SIMULATOR_INTERVAL 200
-#define INTERRUPT_SIMULATOR_TIMEOUT 5
 #define INTERRUPT_SIMULATOR_TIMEOUT_BUSY 2
 #define INTERRUPT_SIMULATOR_TIMEOUT_IDLE 50
+// Time without any IRQ before the poller drops to the idle interval (ms)
+#define INTERRUPT_SIMULATOR_IDLE_DELAY 1000
+// How often polling rate and duty cycle are published (ms)
+#define INTERRUPT_SIMULATOR_STATS_INTERVAL 1000
 
 #define I2C_DSM_HIDG "3cdff6f7-4267-4555-ad05-b30a3d8938de"
 #define I2C_DSM_REVISION 1
@@ -70,6 +82,14 @@ typedef struct __attribute__((__packed__)) {
     UInt32 reserved;
 } i2c_hid_desc;
 
+/* Read with its output report built ahead of time */
+typedef struct {
+    UInt16 rmiaddr;
+    size_t len;
+    UInt8 refs; /* 0 if the slot is free */
+    UInt8 writeReport[RMI_READ_REPORT_SIZE];
+} rmi_i2c_prepared_read;
+
 class RMII2C : public RMITransport {
     OSDeclareDefaultStructors(RMII2C);
     typedef IOService super;
@@ -82,9 +102,14 @@ public:
     void stop(IOService *provider) APPLE_KEXT_OVERRIDE;
     IOReturn setPowerState(unsigned long powerState, IOService *whatDevice) APPLE_KEXT_OVERRIDE;
     bool handleOpen(IOService *forClient, IOOptionBits options, void *arg) APPLE_KEXT_OVERRIDE;
+    void free() APPLE_KEXT_OVERRIDE;
 
     int reset() APPLE_KEXT_OVERRIDE;
     int readBlock(UInt16 rmiaddr, UInt8 *databuff, size_t len) APPLE_KEXT_OVERRIDE;
+    int readBlocks(const RmiReadRange *ranges, size_t count) APPLE_KEXT_OVERRIDE;
+    int prepareRead(UInt16 rmiaddr, size_t len) APPLE_KEXT_OVERRIDE;
+    int readPrepared(int handle, UInt8 *databuff, size_t len) APPLE_KEXT_OVERRIDE;
+    void releaseRead(int handle) APPLE_KEXT_OVERRIDE;
     int blockWrite(UInt16 rmiaddr, UInt8 *buf, size_t len) APPLE_KEXT_OVERRIDE;
     virtual OSDictionary *createConfig() APPLE_KEXT_OVERRIDE;
 
@@ -98,13 +123,53 @@ private:
 
     IOLock *page_mutex {nullptr};
 
+    RMITransportStats bus_stats {};
+    IOTimerEventSource* stats_timer {nullptr};
+    void publishStats(OSObject* owner, IOTimerEventSource* timer);
+
+    rmi_i2c_prepared_read prepared_reads[RMI_PREPARED_READS_MAX];
+    int prepared_count {0};
+
+    // Buffers for input/output reports, only used while holding page_mutex
+    UInt8 *input_scratch {nullptr};
+    size_t input_scratch_size {0};
+    UInt8 *output_scratch {nullptr};
+    size_t output_scratch_size {0};
+    // Report buffers are preallocated, nothing in notifyBus should hit the allocator
+    RMIAllocGuard interrupt_guard {};
+
+    // Attention reports are only read from the work loop, and stay untouched
+    // by register reads made while functions handle them
+    UInt8 *attn_report {nullptr};
+    size_t attn_report_size {0};
+
     IOWorkLoop* work_loop;
     IOCommandGate* command_gate;
     IOTimerEventSource* interrupt_simulator;
     IOInterruptEventSource* interrupt_source;
 
+    // Adaptive polling, all times in ns of uptime
+    UInt32 poll_interval {INTERRUPT_SIMULATOR_TIMEOUT_BUSY};
+    UInt64 poll_last_active {0};
+    UInt64 poll_last_tick {0};
+    UInt64 poll_stats_start {0};
+    UInt64 poll_busy_time {0};
+    UInt32 poll_count {0};
+
+    // Burst polling after an interrupt
+    IOTimerEventSource* burst_timer {nullptr};
+    UInt32 burst_duration {0};
+    UInt32 burst_interval {RMI_BURST_POLL_INTERVAL_DEFAULT};
+    UInt64 burst_deadline {0};
+    bool burst_active {false};
+
+    IOReturn notifyBus();
     void interruptOccured(OSObject* owner, IOInterruptEventSource* src, int intCount);
     void simulateInterrupt(OSObject* owner, IOTimerEventSource* timer);
+    void resetPolling();
+    void publishPollingStats(UInt64 now);
+    void startBurst();
+    void burstPoll(OSObject* owner, IOTimerEventSource* timer);
     IOReturn setPowerStateGated();
 
     UInt16 wHIDDescRegister {RMI_HID_DESC_REGISTER};
@@ -115,6 +180,9 @@ private:
 
     int rmi_set_page(UInt8 page);
     int rmi_set_mode(UInt8 mode);
+    size_t rmi_read_report_init(UInt8 *writeReport, UInt16 rmiaddr, size_t len);
+    int rmi_read_report(const UInt8 *writeReport, UInt16 rmiaddr, UInt8 *databuff, size_t len);
+    IOReturn rmi_handle_attn_report();
 
     void releaseResources();
 
@@ -23,6 +23,34 @@
 #define RMIBusIdentifier "Synaptics RMI4 Device"
 #define RMIBusSupported "RMI4 Supported"
 
+// Keep polling for a while after an interrupt (ms), 0 leaves the transport interrupt only
+#define RMIBurstPollDuration "Burst Poll Duration"
+#define RMIBurstPollInterval "Burst Poll Interval"
+#define RMI_BURST_POLL_INTERVAL_DEFAULT 2
+
+#define RMI_READ_RANGES_MAX 8
+#define RMI_READ_MERGE_MAX  256
+#define RMI_PREPARED_READS_MAX 8
+
+/*
+ * A single register range for readBlocks
+ */
+struct RmiReadRange {
+    UInt16 addr;
+    UInt8 *buf;
+    size_t len;
+};
+
+/*
+ * Data pushed by the device along with an interrupt (HID attention report).
+ * Each function with a pending IRQ takes its packed data off the front, in IRQ order.
+ */
+struct RmiAttention {
+    UInt32 irqStatus;
+    const UInt8 *data;
+    size_t size;
+};
+
 /*
  * read/write/reset APIs can be used before opening. Opening/Closing is needed to recieve interrupts
  */
@@ -35,6 +63,47 @@ public:
     // rmi_block_write
     virtual int blockWrite(UInt16 rmiaddr, UInt8 *buf, size_t len) { return -1; };
     
+    /*
+     * Read several ranges at once. Transports should override this to merge
+     * neighbouring ranges into as few bus transactions as possible. Merged
+     * runs don't use prepared reads, so this is for ranges read together
+     * that aren't prepared, not for the IRQ status and data reads done on
+     * every interrupt. Those depend on the IRQ status just read, and on
+     * known parts the registers next to it are F03's clear on read PS/2
+     * buffers, so they can't be read ahead.
+     */
+    virtual int readBlocks(const RmiReadRange *ranges, size_t count) {
+        for (size_t i = 0; i < count; i++) {
+            int retval = readBlock(ranges[i].addr, ranges[i].buf, ranges[i].len);
+            if (retval < 0)
+                return retval;
+        }
+        
+        return 0;
+    };
+    
+    // Hint that a range is read on every interrupt. Pins are counted,
+    // every successful pinRead needs an unpinRead of the same range
+    virtual int pinRead(UInt16 rmiaddr, size_t len) { return 0; };
+    virtual void unpinRead(UInt16 rmiaddr, size_t len) {};
+    
+    /*
+     * Prepared reads let a transport do its setup for a read once rather than on
+     * every interrupt. prepareRead returns a handle (or negative if the transport
+     * can't prepare the read), preparing the same range again returns the same handle.
+     * Handles stay valid across resets, and are counted like pins: every handle
+     * returned must be given back with releaseRead once it's no longer read.
+     * readPrepared reads at least the first len bytes of the range, and may fill
+     * databuff up to the prepared length, so it must be big enough for all of it.
+     */
+    virtual int prepareRead(UInt16 rmiaddr, size_t len) { return -1; };
+    virtual int readPrepared(int handle, UInt8 *databuff, size_t len) { return -1; };
+    virtual void releaseRead(int handle) {};
+
+    // Bytes readPrepared moves per transaction when reading only part of a
+    // prepared range, 0 if a shorter readPrepared costs as much as a new read
+    virtual size_t getPreparedReadBlockSize() { return 0; };
+
     virtual int reset() { return 0; };
     
     virtual OSDictionary *createConfig() { return nullptr; };
@@ -62,6 +131,69 @@ public:
     
 protected:
     IOService *bus {nullptr};
+    
+    /*
+     * Sort ranges by address, then read each run of adjacent or overlapping
+     * ranges with a single readBlock. Gaps are never read as reading data
+     * registers can have side effects. A run never crosses a page and is
+     * never longer than maxLen.
+     */
+    int readBlocksMerged(const RmiReadRange *ranges, size_t count, size_t maxLen) {
+        UInt8 order[RMI_READ_RANGES_MAX];
+        UInt8 bounce[RMI_READ_MERGE_MAX];
+        size_t i, j;
+        int retval;
+        
+        if (count > RMI_READ_RANGES_MAX)
+            return RMITransport::readBlocks(ranges, count);
+        
+        if (maxLen > sizeof(bounce))
+            maxLen = sizeof(bounce);
+        
+        for (i = 0; i < count; i++) {
+            for (j = i; j > 0 && ranges[order[j - 1]].addr > ranges[i].addr; j--)
+                order[j] = order[j - 1];
+            order[j] = i;
+        }
+        
+        for (i = 0; i < count; i = j) {
+            const RmiReadRange &first = ranges[order[i]];
+            size_t start = first.addr;
+            size_t end = start + first.len;
+            
+            for (j = i + 1; j < count; j++) {
+                const RmiReadRange &next = ranges[order[j]];
+                size_t nextEnd = next.addr + next.len;
+                if (nextEnd < end)
+                    nextEnd = end;
+                
+                if (next.addr > end ||
+                    ((nextEnd - 1) >> 8) != (start >> 8) ||
+                    nextEnd - start > maxLen)
+                    break;
+                
+                end = nextEnd;
+            }
+            
+            if (j == i + 1) {
+                retval = readBlock(first.addr, first.buf, first.len);
+                if (retval < 0)
+                    return retval;
+                continue;
+            }
+            
+            retval = readBlock(start, bounce, end - start);
+            if (retval < 0)
+                return retval;
+            
+            for (size_t k = i; k < j; k++) {
+                const RmiReadRange &range = ranges[order[k]];
+                memcpy(range.buf, bounce + (range.addr - start), range.len);
+            }
+        }
+        
+        return 0;
+    }
 };
 
 #endif // RMITransport_H
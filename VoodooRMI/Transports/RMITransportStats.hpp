@@ -0,0 +1,185 @@
+/* SPDX-License-Identifier: GPL-2.0-only
+ * RMI4 Transport Utilization Counters
+ *
+ * Copyright (c) 2023 Avery Black
+ */
+
+#ifndef RMITransportStats_hpp
+#define RMITransportStats_hpp
+
+#include <IOKit/IOLib.h>
+#include <IOKit/IOTimerEventSource.h>
+#include <libkern/c++/OSDictionary.h>
+#include <libkern/c++/OSNumber.h>
+#include "RMIConfiguration.hpp"
+
+#define RMI_TRANSPORT_STATS_INTERVAL    1000 /* ms */
+#define RMI_TRANSPORT_STATS_ERROR_CODES 8
+
+#define RMITransportStatsKey "Bus Stats"
+
+/*
+ * Counters for everything a transport sends over the bus. Counters are
+ * bumped with relaxed atomics as some paths (resets, power changes) don't
+ * take page_mutex. Lock hold time is only tracked through lock/unlock,
+ * which must be paired.
+ *
+ * Nothing is published from the I/O path. The transport's timer calls
+ * copyStats every RMI_TRANSPORT_STATS_INTERVAL while the bus is busy, and
+ * arm() starts it again after the bus went quiet.
+ */
+class RMITransportStats {
+public:
+    inline void read(size_t bytes) {
+        __atomic_fetch_add(&transactions, 1, __ATOMIC_RELAXED);
+        __atomic_fetch_add(&bytesRead, bytes, __ATOMIC_RELAXED);
+    }
+    inline void write(size_t bytes) {
+        __atomic_fetch_add(&transactions, 1, __ATOMIC_RELAXED);
+        __atomic_fetch_add(&bytesWritten, bytes, __ATOMIC_RELAXED);
+    }
+    inline void pageSelect() { __atomic_fetch_add(&pageSelects, 1, __ATOMIC_RELAXED); }
+    inline void mappingWrite() { __atomic_fetch_add(&mappingWrites, 1, __ATOMIC_RELAXED); }
+    inline void retry() { __atomic_fetch_add(&retries, 1, __ATOMIC_RELAXED); }
+
+    // Codes past the first RMI_TRANSPORT_STATS_ERROR_CODES seen are counted as "Other"
+    void failure(int code) {
+        int i;
+
+        for (i = 0; i < RMI_TRANSPORT_STATS_ERROR_CODES; i++) {
+            int expected = 0;
+
+            if (__atomic_load_n(&errorCodes[i], __ATOMIC_RELAXED) == code ||
+                __atomic_compare_exchange_n(&errorCodes[i], &expected, code, false,
+                                            __ATOMIC_RELAXED, __ATOMIC_RELAXED))
+                break;
+
+            if (expected == code)
+                break;
+        }
+
+        __atomic_fetch_add(&errorCounts[i], 1, __ATOMIC_RELAXED);
+    }
+
+    inline void lock(IOLock *mutex) {
+        IOLockLock(mutex);
+        clock_get_uptime(&lockTime);
+    }
+    inline void unlock(IOLock *mutex) {
+        AbsoluteTime now;
+
+        clock_get_uptime(&now);
+        __atomic_fetch_add(&lockHeld, now - lockTime, __ATOMIC_RELAXED);
+        if (now - lockTime > lockHeldMax)
+            __atomic_store_n(&lockHeldMax, now - lockTime, __ATOMIC_RELAXED);
+        IOLockUnlock(mutex);
+    }
+
+    inline void setTimer(IOTimerEventSource *timer) {
+        this->timer = timer;
+        clock_get_uptime(&lastPublish);
+    }
+
+    // Only takes the timer once it stopped, so it's cheap enough for interrupts
+    inline void arm() {
+        if (timer != nullptr && !__atomic_exchange_n(&armed, true, __ATOMIC_RELAXED))
+            timer->setTimeoutMS(RMI_TRANSPORT_STATS_INTERVAL);
+    }
+
+    /*
+     * For the timer only. New dictionary with rates since the last one, or
+     * nullptr if the bus stayed quiet since that was published. Keeps the
+     * timer going until a quiet interval has been published.
+     */
+    OSDictionary *copyStats() {
+        AbsoluteTime now;
+        UInt64 elapsed, total, count, held, heldMax;
+        char code[16];
+        OSDictionary *stats, *errors;
+        OSNumber *value;
+
+        __atomic_store_n(&armed, false, __ATOMIC_RELAXED);
+        total = __atomic_load_n(&transactions, __ATOMIC_RELAXED);
+        if (total == lastTransactions && idle)
+            return nullptr;
+
+        clock_get_uptime(&now);
+        absolutetime_to_nanoseconds(now - lastPublish, &elapsed);
+        if (elapsed == 0)
+            return nullptr;
+
+        stats = OSDictionary::withCapacity(9);
+        errors = OSDictionary::withCapacity(RMI_TRANSPORT_STATS_ERROR_CODES + 1);
+        if (stats == nullptr || errors == nullptr) {
+            OSSafeReleaseNULL(stats);
+            OSSafeReleaseNULL(errors);
+            return nullptr;
+        }
+
+        absolutetime_to_nanoseconds(__atomic_load_n(&lockHeld, __ATOMIC_RELAXED), &held);
+        absolutetime_to_nanoseconds(__atomic_load_n(&lockHeldMax, __ATOMIC_RELAXED), &heldMax);
+
+        // Rates are over the time since the last publish
+        setPropertyNumber(stats, "Transactions/s", (total - lastTransactions) * kSecondScale / elapsed, 32);
+        setPropertyNumber(stats, "Lock Held (%)", (held - lastLockHeld) * 100 / elapsed, 32);
+        setPropertyNumber(stats, "Transactions", total, 64);
+        setPropertyNumber(stats, "Bytes Read", __atomic_load_n(&bytesRead, __ATOMIC_RELAXED), 64);
+        setPropertyNumber(stats, "Bytes Written", __atomic_load_n(&bytesWritten, __ATOMIC_RELAXED), 64);
+        setPropertyNumber(stats, "Page Selects", __atomic_load_n(&pageSelects, __ATOMIC_RELAXED), 64);
+        setPropertyNumber(stats, "Mapping Table Writes", __atomic_load_n(&mappingWrites, __ATOMIC_RELAXED), 64);
+        setPropertyNumber(stats, "Retries", __atomic_load_n(&retries, __ATOMIC_RELAXED), 64);
+        setPropertyNumber(stats, "Lock Held Max (us)", heldMax / 1000, 64);
+
+        for (int i = 0; i <= RMI_TRANSPORT_STATS_ERROR_CODES; i++) {
+            count = __atomic_load_n(&errorCounts[i], __ATOMIC_RELAXED);
+            if (!count)
+                continue;
+
+            if (i < RMI_TRANSPORT_STATS_ERROR_CODES)
+                snprintf(code, sizeof(code), "%d", __atomic_load_n(&errorCodes[i], __ATOMIC_RELAXED));
+            else
+                snprintf(code, sizeof(code), "Other");
+            setPropertyNumber(errors, code, count, 64);
+        }
+
+        stats->setObject("Failures", errors);
+        OSSafeReleaseNULL(errors);
+
+        idle = total == lastTransactions;
+        lastPublish = now;
+        lastTransactions = total;
+        lastLockHeld = held;
+        
+        if (!idle)
+            arm();
+        return stats;
+    }
+
+private:
+    UInt64 transactions {0};
+    UInt64 bytesRead {0};
+    UInt64 bytesWritten {0};
+    UInt64 pageSelects {0};
+    UInt64 mappingWrites {0};
+    UInt64 retries {0};
+
+    // Failure codes are never 0, so 0 marks a free slot
+    int errorCodes[RMI_TRANSPORT_STATS_ERROR_CODES] {};
+    UInt64 errorCounts[RMI_TRANSPORT_STATS_ERROR_CODES + 1] {};
+
+    // Only written while holding the lock
+    AbsoluteTime lockTime {0};
+    AbsoluteTime lockHeld {0};
+    AbsoluteTime lockHeldMax {0};
+
+    IOTimerEventSource *timer {nullptr};
+    bool armed {false};
+
+    // Only touched by the timer
+    AbsoluteTime lastPublish {0};
+    UInt64 lastTransactions {0};
+    UInt64 lastLockHeld {0};
+    bool idle {false};
+};
+
+#endif /* RMITransportStats_hpp */
@@ -22,6 +22,7 @@ bool RMISMBus::init(OSDictionary *dictionary)
     page_mutex = IOLockAlloc();
     mapping_table_mutex = IOLockAlloc();
     memset(mapping_table, 0, sizeof(mapping_table));
+    memset(mapping_state, 0, sizeof(mapping_state));
     return super::init(dictionary);
 }
 
@@ -54,6 +55,39 @@ bool RMISMBus::start(IOService *provider)
     if (!rmiStart()) {
         return false;
     }
+    
+    OSNumber *duration = OSDynamicCast(OSNumber, getProperty(RMIBurstPollDuration));
+    OSNumber *interval = OSDynamicCast(OSNumber, getProperty(RMIBurstPollInterval));
+    if (duration)
+        burst_duration = duration->unsigned32BitValue();
+    if (interval && interval->unsigned32BitValue())
+        burst_interval = interval->unsigned32BitValue();
+    
+    // Host notify comes from the SMBus controller's work loop, poll on the same one
+    work_loop = getWorkLoop();
+    if (burst_duration && work_loop) {
+        // Host notify can come from any thread, burst state is only touched behind the gate
+        command_gate = IOCommandGate::commandGate(this);
+        if (command_gate && work_loop->addEventSource(command_gate) != kIOReturnSuccess)
+            OSSafeReleaseNULL(command_gate);
+        
+        burst_timer = IOTimerEventSource::timerEventSource(this, OSMemberFunctionCast(IOTimerEventSource::Action, this, &RMISMBus::burstPoll));
+        if (!command_gate || !burst_timer || work_loop->addEventSource(burst_timer) != kIOReturnSuccess) {
+            IOLogInfo("Could not add burst timer, using host notify only");
+            OSSafeReleaseNULL(burst_timer);
+        }
+    }
+    setProperty("Interrupt mode", burst_timer ? "Host Notify + Burst" : "Host Notify");
+    
+    if (work_loop) {
+        stats_timer = IOTimerEventSource::timerEventSource(this, OSMemberFunctionCast(IOTimerEventSource::Action, this, &RMISMBus::publishStats));
+        if (!stats_timer || work_loop->addEventSource(stats_timer) != kIOReturnSuccess) {
+            IOLogInfo("Could not add stats timer, not publishing bus stats");
+            OSSafeReleaseNULL(stats_timer);
+        }
+        bus_stats.setTimer(stats_timer);
+        bus_stats.arm();
+    }
  
     IOService *ps2 = OSDynamicCast(IOService, device_nub->getProperty("PS/2 Parent"));
     if (ps2) {
@@ -74,6 +108,8 @@ bool RMISMBus::rmiStart()
     int retval = 0, attempts = 0;
     
     do {
+        if (attempts)
+            bus_stats.retry();
         retval = rmi_smb_get_version();
         IOSleep(500);
     } while (retval < 0 && attempts++ < 5);
@@ -95,6 +131,24 @@ bool RMISMBus::rmiStart()
 
 void RMISMBus::stop(IOService *provider)
 {
+    if (burst_timer) {
+        command_gate->runAction(OSMemberFunctionCast(IOCommandGate::Action, this, &RMISMBus::stopBurst));
+        work_loop->removeEventSource(burst_timer);
+        OSSafeReleaseNULL(burst_timer);
+    }
+    
+    if (command_gate) {
+        work_loop->removeEventSource(command_gate);
+        OSSafeReleaseNULL(command_gate);
+    }
+    
+    if (stats_timer) {
+        bus_stats.setTimer(nullptr);
+        stats_timer->cancelTimeout();
+        work_loop->removeEventSource(stats_timer);
+        OSSafeReleaseNULL(stats_timer);
+    }
+    
     PMstop();
     super::stop(provider);
 }
@@ -115,17 +169,22 @@ int RMISMBus::rmi_smb_get_version()
     /* Check for SMBus new version device by reading version byte. */
     retval = device_nub->readByteData(SMB_PROTOCOL_VERSION_ADDRESS);
     if (retval < 0) {
+        bus_stats.failure(retval);
         return retval;
     }
     
+    bus_stats.read(1);
+    
     return retval + 1;
 }
 
 int RMISMBus::reset()
 {
-    /* Discard mapping table */
+    /* Discard mapping table, pinned entries are remapped on their next read */
     IOLockLock(mapping_table_mutex);
     memset(mapping_table, 0, sizeof(mapping_table));
+    for (int i = 0; i < RMI_SMB2_MAP_SIZE; i++)
+        mapping_state[i].lastUsed = 0;
     IOLockUnlock(mapping_table_mutex);
 
     // Full reset can only be done in PS2
@@ -133,12 +192,75 @@ int RMISMBus::reset()
     return rmi_smb_get_version();
 }
 
+static inline bool rmi_smb_entry_empty(const struct mapping_table_entry *entry)
+{
+    return entry->readcount == 0 && !(entry->flags & RMI_SMB2_MAP_FLAGS_WE);
+}
+
+static inline bool rmi_smb_entry_matches(const struct mapping_table_entry *entry,
+                                         UInt16 rmiaddr, int bytecount, bool isread)
+{
+    if (OSSwapLittleToHostInt16(entry->rmiaddr) != rmiaddr)
+        return false;
+    
+    if (isread)
+        return entry->readcount == bytecount;
+    
+    return entry->flags & RMI_SMB2_MAP_FLAGS_WE;
+}
+
+UInt8 RMISMBus::rmi_smb_find_pinned(UInt16 rmiaddr, int bytecount)
+{
+    for (UInt8 i = 0; i < RMI_SMB2_MAP_SIZE; i++) {
+        if (mapping_state[i].pinCount &&
+            mapping_state[i].pinAddr == rmiaddr &&
+            mapping_state[i].pinCount == bytecount)
+            return i;
+    }
+    
+    return RMI_SMB2_MAP_SIZE;
+}
+
+/*
+ * Pick the entry to map a new read/write into. Pinned reads always use their
+ * own entry. Anything else takes an empty entry, otherwise the least recently
+ * used entry which isn't pinned.
+ */
+UInt8 RMISMBus::rmi_smb_find_entry(UInt16 rmiaddr, int bytecount, bool isread)
+{
+    UInt8 victim = RMI_SMB2_MAP_SIZE;
+    
+    if (isread && (victim = rmi_smb_find_pinned(rmiaddr, bytecount)) != RMI_SMB2_MAP_SIZE)
+        return victim;
+    
+    for (UInt8 i = 0; i < RMI_SMB2_MAP_SIZE; i++) {
+        struct mapping_table_state *state = &mapping_state[i];
+        
+        if (state->pinCount)
+            continue;
+        
+        if (rmi_smb_entry_empty(&mapping_table[i])) {
+            if (victim == RMI_SMB2_MAP_SIZE || !rmi_smb_entry_empty(&mapping_table[victim]))
+                victim = i;
+        } else if (victim == RMI_SMB2_MAP_SIZE ||
+                   (!rmi_smb_entry_empty(&mapping_table[victim]) &&
+                    state->lastUsed < mapping_state[victim].lastUsed)) {
+            victim = i;
+        }
+    }
+    
+    // There are always at least RMI_SMB2_MAP_MIN_UNPINNED entries to pick from
+    return victim;
+}
+
 /*
  * The function to get command code for smbus operations and keeps
- * records to the driver mapping table
+ * records to the driver mapping table. Prepared reads pass the entry
+ * they expect to be in as a hint.
  */
 int RMISMBus::rmi_smb_get_command_code(UInt16 rmiaddr, int bytecount,
-                                       bool isread, UInt8 *commandcode)
+                                       bool isread, UInt8 *commandcode,
+                                       UInt8 hint)
 {
     struct mapping_table_entry new_map;
     UInt8 i;
@@ -146,23 +268,22 @@ int RMISMBus::rmi_smb_get_command_code(UInt16 rmiaddr, int bytecount,
     
     IOLockLock(mapping_table_mutex);
     
+    if (hint < RMI_SMB2_MAP_SIZE &&
+        rmi_smb_entry_matches(&mapping_table[hint], rmiaddr, bytecount, isread)) {
+        i = hint;
+        goto hit;
+    }
+    
     for (i = 0; i < RMI_SMB2_MAP_SIZE; i++) {
-        struct mapping_table_entry *entry = &mapping_table[i];
-        
-        if (OSSwapLittleToHostInt16(entry->rmiaddr) == rmiaddr) {
-            if (isread) {
-                if (entry->readcount == bytecount)
-                    goto exit;
-            } else {
-                if (entry->flags & RMI_SMB2_MAP_FLAGS_WE) {
-                    goto exit;
-                }
-            }
-        }
+        if (rmi_smb_entry_matches(&mapping_table[i], rmiaddr, bytecount, isread))
+            goto hit;
     }
     
-    i = table_index;
-    table_index = (i + 1) % RMI_SMB2_MAP_SIZE;
+    i = rmi_smb_find_entry(rmiaddr, bytecount, isread);
+    
+    map_misses++;
+    if (!rmi_smb_entry_empty(&mapping_table[i]))
+        map_evictions++;
     
     /* constructs mapping table data entry. 4 bytes each entry */
     memset(&new_map, 0, sizeof(new_map));
@@ -171,19 +292,28 @@ int RMISMBus::rmi_smb_get_command_code(UInt16 rmiaddr, int bytecount,
     new_map.flags = !isread ? RMI_SMB2_MAP_FLAGS_WE : 0;
     retval = device_nub->writeBlockData(i + 0x80,
                                          sizeof(new_map), reinterpret_cast<UInt8*>(&new_map));
+    bus_stats.mappingWrite();
     if (retval < 0) {
+        bus_stats.failure(retval);
         IOLogError("smb_get_command_code: Failed to write mapping table data");
         /*
          * if not written to device mapping table
          * clear the driver mapping table records
          */
         memset(&new_map, 0, sizeof(new_map));
+    } else {
+        bus_stats.write(sizeof(new_map));
     }
     
     /* save to the driver level mapping table */
     mapping_table[i] = new_map;
+    goto exit;
+    
+hit:
+    map_hits++;
     
 exit:
+    mapping_state[i].lastUsed = ++lru_clock;
     IOLockUnlock(mapping_table_mutex);
     
     if (retval < 0)
@@ -193,12 +323,263 @@ exit:
     return 0;
 }
 
+/*
+ * Reserve an entry for a read done on every interrupt so it never gets
+ * evicted by other reads/writes. Pinning an entry again only counts
+ * another reference. Must hold mapping_table_mutex
+ */
+int RMISMBus::rmi_smb_pin_entry(UInt16 rmiaddr, int bytecount)
+{
+    UInt8 i = rmi_smb_find_pinned(rmiaddr, bytecount);
+    
+    if (i != RMI_SMB2_MAP_SIZE) {
+        mapping_state[i].pinRefs++;
+        return 0;
+    }
+    
+    if (map_pinned >= RMI_SMB2_MAP_SIZE - RMI_SMB2_MAP_MIN_UNPINNED)
+        return -1;
+    
+    // Pin in place if this read is already mapped
+    for (i = 0; i < RMI_SMB2_MAP_SIZE; i++) {
+        struct mapping_table_entry *entry = &mapping_table[i];
+        
+        if (!mapping_state[i].pinCount &&
+            OSSwapLittleToHostInt16(entry->rmiaddr) == rmiaddr &&
+            entry->readcount == bytecount)
+            break;
+    }
+    
+    // Otherwise take an entry, it will be mapped on first read
+    if (i == RMI_SMB2_MAP_SIZE) {
+        i = rmi_smb_find_entry(rmiaddr, bytecount, true);
+        memset(&mapping_table[i], 0, sizeof(mapping_table[i]));
+    }
+    
+    mapping_state[i].pinAddr = rmiaddr;
+    mapping_state[i].pinCount = bytecount;
+    mapping_state[i].pinRefs = 1;
+    map_pinned++;
+    return 0;
+}
+
+/*
+ * Drop a reference taken by rmi_smb_pin_entry. The last one leaves the entry
+ * mapped, but lets it be evicted again. Must hold mapping_table_mutex
+ */
+void RMISMBus::rmi_smb_unpin_entry(UInt16 rmiaddr, int bytecount)
+{
+    UInt8 i = rmi_smb_find_pinned(rmiaddr, bytecount);
+    
+    if (i == RMI_SMB2_MAP_SIZE || --mapping_state[i].pinRefs)
+        return;
+    
+    mapping_state[i].pinAddr = 0;
+    mapping_state[i].pinCount = 0;
+    map_pinned--;
+}
+
+int RMISMBus::pinRead(UInt16 rmiaddr, size_t len)
+{
+    int retval = 0;
+    size_t offset;
+    
+    IOLockLock(mapping_table_mutex);
+    
+    /* Pin each 32 byte chunk that readBlock will use */
+    for (offset = 0; offset < len; offset += SMB_MAX_COUNT) {
+        retval = rmi_smb_pin_entry(rmiaddr + offset, min((int)(len - offset), SMB_MAX_COUNT));
+        if (retval < 0)
+            break;
+    }
+    
+    // Don't hold on to part of a read, it would only shrink the unpinned pool
+    if (retval < 0) {
+        while (offset > 0) {
+            offset -= SMB_MAX_COUNT;
+            rmi_smb_unpin_entry(rmiaddr + offset, min((int)(len - offset), SMB_MAX_COUNT));
+        }
+    }
+    
+    IOLockUnlock(mapping_table_mutex);
+    
+    if (retval < 0) {
+        IOLogInfo("Mapping table full, not pinning read at 0x%x", rmiaddr);
+    }
+    
+    return retval;
+}
+
+void RMISMBus::unpinRead(UInt16 rmiaddr, size_t len)
+{
+    IOLockLock(mapping_table_mutex);
+    for (size_t offset = 0; offset < len; offset += SMB_MAX_COUNT)
+        rmi_smb_unpin_entry(rmiaddr + offset, min((int)(len - offset), SMB_MAX_COUNT));
+    IOLockUnlock(mapping_table_mutex);
+}
+
+int RMISMBus::prepareRead(UInt16 rmiaddr, size_t len)
+{
+    struct rmi_smb_prepared_read *read;
+    int handle;
+    
+    bus_stats.lock(page_mutex);
+    
+    for (handle = 0; handle < prepared_count; handle++) {
+        read = &prepared_reads[handle];
+        if (read->refs && read->rmiaddr == rmiaddr && read->len == len) {
+            read->refs++;
+            goto exit;
+        }
+    }
+    
+    // Take a released slot before growing the table
+    for (handle = 0; handle < prepared_count; handle++) {
+        if (!prepared_reads[handle].refs)
+            break;
+    }
+    
+    // Command codes can only be cached if every chunk keeps its entry
+    if (len == 0 || handle >= RMI_PREPARED_READS_MAX ||
+        pinRead(rmiaddr, len) < 0) {
+        handle = -1;
+        goto exit;
+    }
+    
+    read = &prepared_reads[handle];
+    read->rmiaddr = rmiaddr;
+    read->len = len;
+    read->refs = 1;
+    read->chunks = 0;
+    
+    IOLockLock(mapping_table_mutex);
+    for (size_t offset = 0; offset < len; offset += SMB_MAX_COUNT) {
+        int block_len = min((int)(len - offset), SMB_MAX_COUNT);
+        read->commandcodes[read->chunks++] = rmi_smb_find_pinned(rmiaddr + offset, block_len);
+    }
+    IOLockUnlock(mapping_table_mutex);
+    
+    if (handle == prepared_count)
+        prepared_count++;
+    
+exit:
+    bus_stats.unlock(page_mutex);
+    return handle;
+}
+
+void RMISMBus::releaseRead(int handle)
+{
+    struct rmi_smb_prepared_read *read;
+    
+    if (handle < 0 || handle >= prepared_count)
+        return;
+    
+    bus_stats.lock(page_mutex);
+    read = &prepared_reads[handle];
+    if (read->refs && !--read->refs)
+        unpinRead(read->rmiaddr, read->len);
+    bus_stats.unlock(page_mutex);
+}
+
+int RMISMBus::readPrepared(int handle, UInt8 *databuff, size_t len)
+{
+    const struct rmi_smb_prepared_read *read;
+    UInt8 commandcode;
+    UInt16 rmiaddr;
+    int cur_len;
+    int retval = 0;
+    
+    if (handle < 0 || handle >= prepared_count)
+        return -1;
+    
+    read = &prepared_reads[handle];
+    rmiaddr = read->rmiaddr;
+    cur_len = (int)read->len;
+    
+    bus_stats.lock(page_mutex);
+    if (!read->refs) {
+        retval = -1;
+        goto exit;
+    }
+    
+    // Whole chunks only, a shorter read would need its own mapping entry
+    for (UInt8 i = 0; i < read->chunks && (size_t) i * SMB_MAX_COUNT < len; i++) {
+        int block_len = min(cur_len, SMB_MAX_COUNT);
+        
+        memset(databuff, 0, block_len);
+        // Only goes to the device if the entry was discarded by a reset
+        retval = rmi_smb_get_command_code(rmiaddr, block_len, true,
+                                          &commandcode, read->commandcodes[i]);
+        if (retval < 0)
+            goto exit;
+        
+        retval = device_nub->readBlockData(commandcode, databuff);
+        if (retval < 0) {
+            bus_stats.failure(retval);
+            goto exit;
+        }
+        
+        bus_stats.read(block_len);
+        cur_len -= SMB_MAX_COUNT;
+        databuff += SMB_MAX_COUNT;
+        rmiaddr += SMB_MAX_COUNT;
+    }
+    
+    retval = 0;
+    
+exit:
+    bus_stats.unlock(page_mutex);
+    return retval;
+}
+
+void RMISMBus::publishMappingStats()
+{
+    UInt64 hits, misses, evictions;
+    UInt8 pinned;
+    OSNumber *value;
+    OSDictionary *stats;
+    
+    RMIAssertCanAllocate(interrupt_guard);
+    stats = OSDictionary::withCapacity(4);
+    if (stats == nullptr)
+        return;
+    
+    IOLockLock(mapping_table_mutex);
+    hits = map_hits;
+    misses = map_misses;
+    evictions = map_evictions;
+    pinned = map_pinned;
+    IOLockUnlock(mapping_table_mutex);
+    
+    setPropertyNumber(stats, "Hits", hits, 64);
+    setPropertyNumber(stats, "Misses", misses, 64);
+    setPropertyNumber(stats, "Evictions", evictions, 64);
+    setPropertyNumber(stats, "Pinned", pinned, 8);
+    setProperty("Mapping Table", stats);
+    OSSafeReleaseNULL(stats);
+}
+
+// Runs on the work loop, the I/O paths only bump counters
+void RMISMBus::publishStats(OSObject *owner, IOTimerEventSource *timer)
+{
+    RMIAssertCanAllocate(interrupt_guard);
+    OSDictionary *stats = bus_stats.copyStats();
+    if (stats == nullptr)
+        return;
+    
+    setProperty(RMITransportStatsKey, stats);
+    OSSafeReleaseNULL(stats);
+    
+    // Mapping table only changes with bus traffic
+    publishMappingStats();
+}
+
 int RMISMBus::readBlock(UInt16 rmiaddr, UInt8 *databuff, size_t len) {
     int retval;
     UInt8 commandcode;
     int cur_len = (int)len;
     
-    IOLockLock(page_mutex);
+    bus_stats.lock(page_mutex);
     memset(databuff, 0, len);
     
     while (cur_len > 0) {
@@ -212,8 +593,12 @@ int RMISMBus::readBlock(UInt16 rmiaddr, UInt8 *databuff, size_t len) {
         
         retval = device_nub->readBlockData(commandcode, databuff);
         
-        if (retval < 0)
+        if (retval < 0) {
+            bus_stats.failure(retval);
             goto exit;
+        }
+        
+        bus_stats.read(block_len);
         
         /* prepare to read next block of bytes */
         cur_len -= SMB_MAX_COUNT;
@@ -224,17 +609,26 @@ int RMISMBus::readBlock(UInt16 rmiaddr, UInt8 *databuff, size_t len) {
     retval = 0;
     
 exit:
-    IOLockUnlock(page_mutex);
+    bus_stats.unlock(page_mutex);
     return retval;
 }
 
+int RMISMBus::readBlocks(const RmiReadRange *ranges, size_t count)
+{
+    /*
+     * Every 32 byte chunk is its own transaction, and merged runs never
+     * need more chunks than the ranges would on their own
+     */
+    return readBlocksMerged(ranges, count, RMI_READ_MERGE_MAX);
+}
+
 int RMISMBus::blockWrite(UInt16 rmiaddr, UInt8 *buf, size_t len)
 {
     int retval = 0;
     UInt8 commandcode;
     int cur_len = (int)len;
     
-    IOLockLock(page_mutex);
+    bus_stats.lock(page_mutex);
     
     while (cur_len > 0) {
         /*
@@ -251,15 +645,19 @@ int RMISMBus::blockWrite(UInt16 rmiaddr, UInt8 *buf, size_t len)
         retval = device_nub->writeBlockData(commandcode,
                                             block_len, buf);
         
-        if (retval < 0)
+        if (retval < 0) {
+            bus_stats.failure(retval);
             goto exit;
+        }
+        
+        bus_stats.write(block_len);
         
         cur_len -= SMB_MAX_COUNT;
         buf += SMB_MAX_COUNT;
     }
     
 exit:
-    IOLockUnlock(page_mutex);
+    bus_stats.unlock(page_mutex);
     return retval;
 }
 
@@ -267,18 +665,79 @@ IOReturn RMISMBus::message(UInt32 type, IOService *provider, void *argument) {
     if (!bus) return kIOReturnError;
     
     switch (type) {
-        case kIOMessageVoodooSMBusHostNotify:
-            return messageClient(kIOMessageVoodooSMBusHostNotify, bus);
+        case kIOMessageVoodooSMBusHostNotify: {
+            interrupt_guard.enter();
+            IOReturn ret = messageClient(kIOMessageVoodooSMBusHostNotify, bus);
+            interrupt_guard.exit();
+            
+            if (ret == kIOReturnSuccess && burst_timer)
+                command_gate->runAction(OSMemberFunctionCast(IOCommandGate::Action, this, &RMISMBus::startBurst));
+            bus_stats.arm();
+            return ret;
+        }
         default:
             return IOService::message(type, provider, argument);
     }
 };
 
+/*
+ * After a host notify with data, keep polling every burst_interval until
+ * nothing was reported for burst_duration, then go back to host notify only.
+ * Both run behind command_gate, serialized with burstPoll on the work loop.
+ */
+IOReturn RMISMBus::startBurst() {
+    AbsoluteTime timestamp;
+    
+    clock_get_uptime(&timestamp);
+    absolutetime_to_nanoseconds(timestamp, &burst_deadline);
+    burst_deadline += (UInt64) burst_duration * kMillisecondScale;
+    
+    if (!burst_active) {
+        burst_active = true;
+        burst_timer->setTimeoutMS(burst_interval);
+    }
+    
+    return kIOReturnSuccess;
+}
+
+IOReturn RMISMBus::stopBurst() {
+    burst_timer->cancelTimeout();
+    burst_active = false;
+    return kIOReturnSuccess;
+}
+
+void RMISMBus::burstPoll(OSObject *owner, IOTimerEventSource *timer) {
+    AbsoluteTime timestamp;
+    UInt64 now;
+    
+    if (!bus) {
+        burst_active = false;
+        return;
+    }
+    
+    interrupt_guard.enter();
+    IOReturn ret = messageClient(kIOMessageVoodooSMBusHostNotify, bus);
+    interrupt_guard.exit();
+    
+    clock_get_uptime(&timestamp);
+    absolutetime_to_nanoseconds(timestamp, &now);
+    
+    if (ret == kIOReturnSuccess)
+        burst_deadline = now + (UInt64) burst_duration * kMillisecondScale;
+    
+    if (now < burst_deadline)
+        burst_timer->setTimeoutMS(burst_interval);
+    else
+        burst_active = false;
+}
+
 IOReturn RMISMBus::setPowerState(unsigned long whichState, IOService* whatDevice) {
     if (whatDevice != this)
         return kIOPMAckImplied;
     
     if (whichState == RMI_POWER_OFF) {
+        if (burst_timer)
+            command_gate->runAction(OSMemberFunctionCast(IOCommandGate::Action, this, &RMISMBus::stopBurst));
         messageClient(kIOMessageRMI4Sleep, bus);
     } else {
         // Put trackpad in SMBus mode again
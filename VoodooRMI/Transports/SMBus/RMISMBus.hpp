@@ -11,13 +11,18 @@
 #define RMISMBus_h
 
 #include "RMITransport.hpp"
+#include "RMITransportStats.hpp"
+#include "RMIAllocGuard.h"
 #include "VoodooSMBusDeviceNub.hpp"
+#include <IOKit/IOCommandGate.h>
+#include <IOKit/IOTimerEventSource.h>
 
 #define I2C_CLIENT_HOST_NOTIFY          0x40    /* We want to use I2C host notify */
 #define SMB_PROTOCOL_VERSION_ADDRESS    0xfd
 #define SMB_MAX_COUNT                   32
 #define RMI_SMB2_MAP_SIZE               8 /* 8 entry of 4 bytes each */
 #define RMI_SMB2_MAP_FLAGS_WE           0x01
+#define RMI_SMB2_MAP_MIN_UNPINNED       2 /* entries always left for other reads/writes */
 
 struct mapping_table_entry {
     UInt16 rmiaddr;
@@ -25,6 +30,23 @@ struct mapping_table_entry {
     UInt8 flags;
 };
 
+/* Read with its mapping table entries picked ahead of time */
+struct rmi_smb_prepared_read {
+    UInt16 rmiaddr;
+    size_t len;
+    UInt8 refs; /* 0 if the slot is free */
+    UInt8 chunks;
+    UInt8 commandcodes[RMI_SMB2_MAP_SIZE];
+};
+
+/* Driver side bookkeeping for a mapping table entry */
+struct mapping_table_state {
+    UInt32 lastUsed;
+    UInt16 pinAddr;
+    UInt8 pinCount; /* 0 if the entry is not pinned */
+    UInt8 pinRefs;
+};
+
 class RMISMBus : public RMITransport {
     OSDeclareDefaultStructors(RMISMBus);
     
@@ -39,7 +61,14 @@ public:
     void free() override;
     
     int readBlock(UInt16 rmiaddr, UInt8 *databuff, size_t len) override;
+    int readBlocks(const RmiReadRange *ranges, size_t count) override;
     int blockWrite(UInt16 rmiaddr, UInt8 *buf, size_t len) override;
+    int pinRead(UInt16 rmiaddr, size_t len) override;
+    void unpinRead(UInt16 rmiaddr, size_t len) override;
+    int prepareRead(UInt16 rmiaddr, size_t len) override;
+    int readPrepared(int handle, UInt8 *databuff, size_t len) override;
+    void releaseRead(int handle) override;
+    size_t getPreparedReadBlockSize() override { return SMB_MAX_COUNT; };
     
     int reset() override;
     virtual OSDictionary *createConfig() APPLE_KEXT_OVERRIDE;
@@ -49,12 +78,45 @@ private:
     IOLock *mapping_table_mutex;
     
     struct mapping_table_entry mapping_table[RMI_SMB2_MAP_SIZE];
-    UInt8 table_index {0};
+    struct mapping_table_state mapping_state[RMI_SMB2_MAP_SIZE];
+    UInt32 lru_clock {0};
+    
+    // Mapping table statistics, published by the stats timer
+    UInt64 map_hits {0};
+    UInt64 map_misses {0};
+    UInt64 map_evictions {0};
+    UInt8 map_pinned {0};
+    
+    RMITransportStats bus_stats {};
+    IOTimerEventSource *stats_timer {nullptr};
+    RMIAllocGuard interrupt_guard {};
+    void publishStats(OSObject *owner, IOTimerEventSource *timer);
+    
+    struct rmi_smb_prepared_read prepared_reads[RMI_PREPARED_READS_MAX];
+    int prepared_count {0};
+    
+    // Burst polling after a host notify, runs on the provider's work loop
+    IOWorkLoop *work_loop {nullptr};
+    IOCommandGate *command_gate {nullptr};
+    IOTimerEventSource *burst_timer {nullptr};
+    UInt32 burst_duration {0};
+    UInt32 burst_interval {RMI_BURST_POLL_INTERVAL_DEFAULT};
+    UInt64 burst_deadline {0};
+    bool burst_active {false};
     
     bool rmiStart();
+    IOReturn startBurst();
+    IOReturn stopBurst();
+    void burstPoll(OSObject *owner, IOTimerEventSource *timer);
     int rmi_smb_get_version();
     int rmi_smb_get_command_code(UInt16 rmiaddr, int bytecount,
-                                 bool isread, UInt8 *commandcode);
+                                 bool isread, UInt8 *commandcode,
+                                 UInt8 hint = RMI_SMB2_MAP_SIZE);
+    UInt8 rmi_smb_find_entry(UInt16 rmiaddr, int bytecount, bool isread);
+    UInt8 rmi_smb_find_pinned(UInt16 rmiaddr, int bytecount);
+    int rmi_smb_pin_entry(UInt16 rmiaddr, int bytecount);
+    void rmi_smb_unpin_entry(UInt16 rmiaddr, int bytecount);
+    void publishMappingStats();
 };
 
 #endif /* RMISMBus_h */
@@ -0,0 +1,58 @@
+/* SPDX-License-Identifier: GPL-2.0-only
+ * RMI4 Allocation Guard
+ *
+ * Copyright (c) 2023 Avery Black
+ */
+
+#ifndef RMIAllocGuard_h
+#define RMIAllocGuard_h
+
+#include <IOKit/IOLib.h>
+#include <kern/thread.h>
+#include "RMILogging.h"
+
+/*
+ * Marks a section that must not allocate, like handling an interrupt.
+ * Only tracked in DEBUG builds, where RMIAssertCanAllocate panics on the
+ * thread inside the section. It belongs in anything that allocates and
+ * could be reached from there. Host builds also abort on any IOMalloc,
+ * OSObject allocation or setProperty inside a section. Sections nest,
+ * and are only entered and left on the thread that owns them.
+ */
+class RMIAllocGuard {
+public:
+#ifdef DEBUG
+    inline void enter() {
+        if (depth++ == 0)
+            __atomic_store_n(&owner, current_thread(), __ATOMIC_RELAXED);
+#ifdef RMI_HOST_SHIM
+        gHostNoAllocDepth++;
+#endif
+    }
+
+    inline void exit() {
+        if (--depth == 0)
+            __atomic_store_n(&owner, nullptr, __ATOMIC_RELAXED);
+#ifdef RMI_HOST_SHIM
+        gHostNoAllocDepth--;
+#endif
+    }
+
+    // Other threads never see themselves as the owner, so they can check too
+    inline bool isHeld() const {
+        return __atomic_load_n(&owner, __ATOMIC_RELAXED) == current_thread();
+    }
+
+private:
+    thread_t owner {nullptr};
+    UInt32 depth {0};
+#else
+    inline void enter() {}
+    inline void exit() {}
+    inline bool isHeld() const { return false; }
+#endif
+};
+
+#define RMIAssertCanAllocate(guard) RMIAssert(!(guard).isHeld())
+
+#endif /* RMIAllocGuard_h */
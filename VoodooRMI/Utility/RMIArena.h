@@ -0,0 +1,94 @@
+/* SPDX-License-Identifier: GPL-2.0-only
+ * RMI4 Function Memory Arena
+ *
+ * Copyright (c) 2023 Avery Black
+ */
+
+#ifndef RMIArena_h
+#define RMIArena_h
+
+#include <IOKit/IOLib.h>
+
+#define RMI_ARENA_CHUNK_SIZE    512
+#define RMI_ARENA_ALIGN         sizeof(UInt64)
+
+/*
+ * Bump allocator for memory a function keeps for its whole life, like
+ * register descriptors and data packets. Allocations are zeroed and come
+ * out of chunks of RMI_ARENA_CHUNK_SIZE (bigger ones get their own), and
+ * are only given back all at once by release(). Not locked, so only
+ * allocate while attaching.
+ */
+class RMIArena {
+public:
+    void *alloc(size_t size) {
+        Chunk *chunk;
+        void *ptr;
+
+        size = (size + RMI_ARENA_ALIGN - 1) & ~(RMI_ARENA_ALIGN - 1);
+        if (head == nullptr || head->used + size > head->size) {
+            chunk = newChunk(size > RMI_ARENA_CHUNK_SIZE ? size : RMI_ARENA_CHUNK_SIZE);
+            if (chunk == nullptr)
+                return nullptr;
+
+            // Keep filling the current chunk if this one is only for a big allocation
+            if (head != nullptr && size > RMI_ARENA_CHUNK_SIZE) {
+                chunk->next = head->next;
+                head->next = chunk;
+            } else {
+                chunk->next = head;
+                head = chunk;
+            }
+        } else {
+            chunk = head;
+        }
+
+        ptr = reinterpret_cast<UInt8 *>(chunk + 1) + chunk->used;
+        chunk->used += size;
+        return ptr;
+    }
+
+    template <typename T>
+    inline T *alloc(size_t count) {
+        if (count > SIZE_MAX / sizeof(T))
+            return nullptr;
+
+        return reinterpret_cast<T *>(alloc(count * sizeof(T)));
+    }
+
+    void release() {
+        while (head != nullptr) {
+            Chunk *next = head->next;
+            IOFree(head, sizeof(Chunk) + head->size);
+            head = next;
+        }
+
+        reserved = 0;
+    }
+
+    // Bytes taken from the kernel, including chunk headers and unused space
+    inline size_t getReserved() const { return reserved; }
+
+private:
+    struct Chunk {
+        Chunk *next;
+        size_t size;
+        size_t used;
+    };
+
+    Chunk *head {nullptr};
+    size_t reserved {0};
+
+    Chunk *newChunk(size_t size) {
+        Chunk *chunk = reinterpret_cast<Chunk *>(IOMalloc(sizeof(Chunk) + size));
+        if (chunk == nullptr)
+            return nullptr;
+
+        bzero(chunk, sizeof(Chunk) + size);
+        chunk->size = size;
+        reserved += sizeof(Chunk) + size;
+        return chunk;
+    }
+};
+
+#endif /* RMIArena_h */
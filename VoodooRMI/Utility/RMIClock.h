@@ -0,0 +1,44 @@
+/* SPDX-License-Identifier: GPL-2.0-only
+ * RMI4 Clock Sources
+ *
+ * Copyright (c) 2023 Avery Black
+ */
+
+#ifndef RMIClock_h
+#define RMIClock_h
+
+#include <IOKit/IOLib.h>
+
+/*
+ * Where the bus gets timestamps from. Everything that ends up in an input
+ * report or feeds palm rejection reads time through this, so swapping the
+ * clock makes those decisions repeatable.
+ */
+class RMIClock {
+public:
+    virtual AbsoluteTime now() const {
+        AbsoluteTime time;
+        clock_get_uptime(&time);
+        return time;
+    }
+};
+
+/*
+ * Only moves when told to, for replays and benchmarks
+ */
+class RMIVirtualClock : public RMIClock {
+public:
+    AbsoluteTime now() const override { return time; }
+
+    inline void set(AbsoluteTime time) { this->time = time; }
+    inline void advance(UInt64 ns) {
+        AbsoluteTime delta;
+        nanoseconds_to_absolutetime(ns, &delta);
+        time += delta;
+    }
+
+private:
+    AbsoluteTime time {0};
+};
+
+#endif /* RMIClock_h */
@@ -12,8 +12,10 @@
 
 #ifdef DEBUG
 #define IOLogDebug(format, ...) do { IOLog("VRMI - Debug: " format "\n", ## __VA_ARGS__); } while(0)
+#define RMIAssert(cond) do { if (!(cond)) panic("VRMI - Assertion failed: %s (%s:%d)", #cond, __FILE__, __LINE__); } while(0)
 #else
 #define IOLogDebug(arg...)
+#define RMIAssert(cond)
 #endif // DEBUG
 
 #endif /* Logging_h */
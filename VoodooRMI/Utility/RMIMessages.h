@@ -22,6 +22,7 @@ enum {
     kHandleRMIClickpadSet = iokit_vendor_specific_msg(2046),
     kHandleRMITrackpoint = iokit_vendor_specific_msg(2047),
     kHandleRMITrackpointButton = iokit_vendor_specific_msg(2048),
+    kHandleRMIConfigurationChanged = iokit_vendor_specific_msg(2049),
 };
 
 
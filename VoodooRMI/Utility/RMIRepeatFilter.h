@@ -0,0 +1,61 @@
+/* SPDX-License-Identifier: GPL-2.0-only
+ * RMI4 Repeated Packet Filter
+ *
+ * Copyright (c) 2023 Avery Black
+ */
+
+#ifndef RMIRepeatFilter_h
+#define RMIRepeatFilter_h
+
+#include <IOKit/IOLib.h>
+
+/*
+ * Drops packets that are the same as the last one sent, though one still
+ * goes out every keep-alive so VoodooInput sees time moving. A keep-alive
+ * of 0 sends everything. The key should only hold what the receiver looks
+ * at (no timestamps), and be zeroed before it's filled in so padding
+ * compares equal. Only used from one sink, so nothing is locked. reset
+ * and the suppressed count are atomic, as those come from other threads.
+ */
+template <typename Key>
+class RMIRepeatFilter {
+public:
+    bool shouldSend(const Key &key, AbsoluteTime now, UInt64 keepAlive) {
+        if (keepAlive == 0 || !__atomic_load_n(&hasLast, __ATOMIC_RELAXED) ||
+            now - lastSent >= keepAlive ||
+            memcmp(&key, &last, sizeof(Key))) {
+            last = key;
+            lastSent = now;
+            __atomic_store_n(&hasLast, true, __ATOMIC_RELAXED);
+            return true;
+        }
+
+        __atomic_fetch_add(&suppressed, 1, __ATOMIC_RELAXED);
+        return false;
+    }
+
+    // Next packet always goes out, for when the receiver may have lost track
+    inline void reset() { __atomic_store_n(&hasLast, false, __ATOMIC_RELAXED); }
+
+    // For the publisher only, true if the count moved since it was last true
+    inline bool isPublishDue() {
+        UInt64 count = getSuppressed();
+
+        if (count == lastPublished)
+            return false;
+
+        lastPublished = count;
+        return true;
+    }
+
+    inline UInt64 getSuppressed() const { return __atomic_load_n(&suppressed, __ATOMIC_RELAXED); }
+
+private:
+    Key last {};
+    bool hasLast {false};
+    AbsoluteTime lastSent {0};
+    UInt64 suppressed {0};
+    UInt64 lastPublished {0};
+};
+
+#endif /* RMIRepeatFilter_h */